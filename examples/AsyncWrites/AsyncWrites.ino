@@ -0,0 +1,50 @@
+#include "ArduinoDb.h"
+
+// Stores a counter every 100 ms without blocking the loop, ESP32 only
+
+Async_Memory asyncDb("async");
+
+volatile uint32_t storedTicket = 0;
+uint32_t counter = 0;
+
+void onStored(uint32_t ticket, int8_t result) {
+  // Called from the writer task, only note the ticket here
+  storedTicket = ticket;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+  Serial.println("Serial ready");
+
+  if (asyncDb.begin(onStored)) {
+    Serial.println("Async SPIFFS Initialization successful");
+  } else {
+    Serial.println("Async SPIFFS Initialization failed");
+  }
+}
+
+void loop() {
+  unsigned long start = micros();
+  uint32_t ticket = asyncDb.insert("counter", String(counter));
+  unsigned long elapsed = micros() - start;
+
+  if (ticket == 0) {
+    Serial.println("Queue full, waiting for the writer task");
+    asyncDb.flush(1000);
+  } else {
+    counter++;
+  }
+
+  // The queued value is returned even if it is not stored yet
+  Serial.print("counter: ");
+  Serial.print(asyncDb.get("counter", "none"));
+  Serial.print(", insert took ");
+  Serial.print(elapsed);
+  Serial.print(" us, queued: ");
+  Serial.print(asyncDb.pending());
+  Serial.print(", last stored ticket: ");
+  Serial.println(storedTicket);
+
+  delay(100);
+}
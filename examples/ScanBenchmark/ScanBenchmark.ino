@@ -0,0 +1,114 @@
+#include "ArduinoDb.h"
+#include "ScanKernel.h"
+
+// Compares the word at a time scanning kernel against a byte at a time loop
+
+#define DATA_SIZE 4096
+#define ROUNDS 100
+
+char data[DATA_SIZE];
+
+void setup() {
+  Serial.begin(9600);
+  delay(2000);
+  Serial.println("Serial ready");
+
+  // Records of 40 bytes, similar to the stored data
+  for (int i = 0; i < DATA_SIZE; i++) {
+    data[i] = ((i % 40) == 39) ? '\n' : ('a' + (i % 26));
+  }
+
+  data[DATA_SIZE - 1] = '>';
+
+  benchmarkFind();
+  benchmarkMismatch();
+}
+
+void loop() {
+}
+
+
+
+int findByteLoop(const char* bytes, int length, char target)
+{
+  for (int i = 0; i < length; i++) {
+    if (bytes[i] == target) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+
+
+int mismatchLoop(const char* a, const char* b, int length)
+{
+  int i = 0;
+
+  while ((i < length) && (a[i] == b[i])) {
+    i++;
+  }
+
+  return i;
+}
+
+
+
+void printResult(const char* name, unsigned long elapsed)
+{
+  // Bytes per microsecond is the same as MB per second
+  float throughput = ((float)DATA_SIZE * ROUNDS) / (elapsed > 0 ? elapsed : 1);
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(elapsed);
+  Serial.print(" us, ");
+  Serial.print(throughput);
+  Serial.println(" MB/s");
+}
+
+
+
+void benchmarkFind()
+{
+  Serial.println();
+  Serial.println("********** Searching '>' in 4096 bytes **********");
+  volatile int found = 0;
+
+  unsigned long start = micros();
+  for (int i = 0; i < ROUNDS; i++) {
+    found += findByteLoop(data, DATA_SIZE, '>');
+  }
+  printResult("Byte loop", micros() - start);
+
+  start = micros();
+  for (int i = 0; i < ROUNDS; i++) {
+    found += dbFindByte(data, DATA_SIZE, '>');
+  }
+  printResult("Scan kernel", micros() - start);
+}
+
+
+
+void benchmarkMismatch()
+{
+  Serial.println();
+  Serial.println("********** Comparing 4096 equal bytes **********");
+  static char copy[DATA_SIZE];
+  volatile int matched = 0;
+
+  memcpy(copy, data, DATA_SIZE);
+
+  unsigned long start = micros();
+  for (int i = 0; i < ROUNDS; i++) {
+    matched += mismatchLoop(data, copy, DATA_SIZE);
+  }
+  printResult("Byte loop", micros() - start);
+
+  start = micros();
+  for (int i = 0; i < ROUNDS; i++) {
+    matched += dbMismatch(data, copy, DATA_SIZE);
+  }
+  printResult("Scan kernel", micros() - start);
+}
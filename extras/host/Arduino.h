@@ -0,0 +1,140 @@
+// Host stand-in of the Arduino core, enough of it to build the library and its tests with g++
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+typedef uint8_t byte;
+typedef bool boolean;
+
+class String {
+  public:
+    std::string s;
+    String() {}
+    String(const char* c) { if (c) s = c; }
+    String(const String& o) : s(o.s) {}
+    String(char c) { if (c) s = std::string(1, c); }
+    String(int v) { s = std::to_string(v); }
+    String(unsigned int v) { s = std::to_string(v); }
+    String(long v) { s = std::to_string(v); }
+    String(unsigned long v) { s = std::to_string(v); }
+    String(unsigned char v) { s = std::to_string(v); }
+    String(float v) { s = std::to_string(v); }
+    String(double v) { s = std::to_string(v); }
+    String(unsigned long v, int base) { char b[40]; snprintf(b, 40, base == 16 ? "%lx" : "%lu", v); s = b; }
+    String(unsigned int v, int base) { char b[40]; snprintf(b, 40, base == 16 ? "%x" : "%u", v); s = b; }
+    String& operator=(const String& o) { s = o.s; return *this; }
+    String& operator=(const char* c) { s = c ? c : ""; return *this; }
+    unsigned int length() const { return s.size(); }
+    const char* c_str() const { return s.c_str(); }
+    char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+    char& operator[](unsigned int i) { static char dummy; if (i < s.size()) return s[i]; dummy = 0; return dummy; }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+    void setCharAt(unsigned int i, char c) { if (i < s.size()) s[i] = c; }
+    bool equals(const String& o) const { return s == o.s; }
+    bool equals(const char* o) const { return s == o; }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator==(const char* o) const { return s == o; }
+    bool operator!=(const String& o) const { return s != o.s; }
+    bool operator!=(const char* o) const { return s != o; }
+    bool operator<(const String& o) const { return s < o.s; }
+    bool operator>(const String& o) const { return s > o.s; }
+    bool operator<=(const String& o) const { return s <= o.s; }
+    bool operator>=(const String& o) const { return s >= o.s; }
+    int compareTo(const String& o) const { int r = s.compare(o.s); return r < 0 ? -1 : (r > 0 ? 1 : 0); }
+    bool startsWith(const String& p) const { return s.compare(0, p.s.size(), p.s) == 0 && s.size() >= p.s.size(); }
+    bool endsWith(const String& p) const { return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0; }
+    int indexOf(char c) const { size_t p = s.find(c); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(char c, unsigned int from) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String& c) const { size_t p = s.find(c.s); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String& c, unsigned int from) const { size_t p = s.find(c.s, from); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(char c) const { size_t p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+    String substring(unsigned int a) const { String r; if (a < s.size()) r.s = s.substr(a); return r; }
+    String substring(unsigned int a, unsigned int b) const { String r; if (a > b) std::swap(a, b); if (a < s.size()) r.s = s.substr(a, std::min<size_t>(b, s.size()) - a); return r; }
+    bool reserve(unsigned int n) { s.reserve(n); return true; }
+    bool concat(const String& o) { s += o.s; return true; }
+    bool concat(const char* o) { s += o; return true; }
+    bool concat(const char* o, unsigned int n) { s.append(o, n); return true; }
+    bool concat(char c) { s += c; return true; }
+    bool concat(int v) { s += std::to_string(v); return true; }
+    bool concat(unsigned int v) { s += std::to_string(v); return true; }
+    bool concat(long v) { s += std::to_string(v); return true; }
+    bool concat(unsigned long v) { s += std::to_string(v); return true; }
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    String& operator+=(const char* o) { s += o; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    String& operator+=(int v) { s += std::to_string(v); return *this; }
+    String& operator+=(unsigned int v) { s += std::to_string(v); return *this; }
+    String& operator+=(long v) { s += std::to_string(v); return *this; }
+    String& operator+=(unsigned long v) { s += std::to_string(v); return *this; }
+    long toInt() const { return strtol(s.c_str(), 0, 10); }
+    void trim() { while (!s.empty() && isspace((unsigned char)s.back())) s.pop_back(); size_t i = 0; while (i < s.size() && isspace((unsigned char)s[i])) i++; s = s.substr(i); }
+    void remove(unsigned int i) { if (i < s.size()) s.erase(i); }
+    void remove(unsigned int i, unsigned int n) { if (i < s.size()) s.erase(i, n); }
+    void toCharArray(char* buf, unsigned int n) const { if (!n) return; size_t l = std::min<size_t>(n - 1, s.size()); memcpy(buf, s.data(), l); buf[l] = 0; }
+    void getBytes(unsigned char* buf, unsigned int n) const { toCharArray((char*)buf, n); }
+    const char* begin() const { return s.data(); }
+    const char* end() const { return s.data() + s.size(); }
+    bool isEmpty() const { return s.empty(); }
+};
+inline String operator+(const String& a, const String& b) { String r(a); r.s += b.s; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r.s += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r.s += b.s; return r; }
+inline String operator+(const String& a, char b) { String r(a); r.s += b; return r; }
+inline String operator+(const String& a, int b) { String r(a); r.s += std::to_string(b); return r; }
+inline String operator+(const String& a, unsigned int b) { String r(a); r.s += std::to_string(b); return r; }
+inline String operator+(const String& a, long b) { String r(a); r.s += std::to_string(b); return r; }
+inline String operator+(const String& a, unsigned long b) { String r(a); r.s += std::to_string(b); return r; }
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* b, size_t n) { size_t r = 0; for (size_t i = 0; i < n; i++) r += write(b[i]); return r; }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t write(const char* s, size_t n) { return write((const uint8_t*)s, n); }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return print(String(v)); }
+    size_t print(unsigned int v) { return print(String(v)); }
+    size_t print(long v) { return print(String(v)); }
+    size_t print(unsigned long v) { return print(String(v)); }
+    size_t print(double v) { return print(String(v)); }
+    size_t println() { return write('\n'); }
+    template <typename T> size_t println(const T& v) { size_t r = print(v); return r + println(); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    virtual void flush() {}
+};
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    size_t readBytes(char* b, size_t n) { size_t i = 0; for (; i < n; i++) { int c = read(); if (c < 0) break; b[i] = (char)c; } return i; }
+    size_t readBytes(uint8_t* b, size_t n) { return readBytes((char*)b, n); }
+    String readStringUntil(char t) { String r; int c; while ((c = read()) >= 0 && c != t) r += (char)c; return r; }
+    void setTimeout(unsigned long) {}
+};
+class HardwareSerial : public Stream {
+  public:
+    bool quiet = true;
+    void begin(long) {}
+    size_t write(uint8_t c) override { if (!quiet) putchar(c); return 1; }
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void yield();
+#endif
@@ -0,0 +1,174 @@
+/*
+    ArenaTest.cpp - Host test of the EEPROM database counting the heap
+                    allocations after begin, over a random workload
+    Built twice by run.sh, with DB_STATIC_ARENA where no allocation is allowed
+    and without it, the logs of both builds must be the same
+*/
+
+#include "Arduino.h"
+#include "EEPROM_Memory.h"
+#include <assert.h>
+#include <new>
+
+#define KEYS 120
+#define ROUNDS 3000
+
+static long _allocations = 0;
+static bool _counting = false;
+static uint32_t _now = 100000;
+
+
+
+
+void* operator new(size_t size)
+{
+	if (_counting)
+	{
+		_allocations++;
+	}
+
+	void* memory = malloc((size > 0) ? size : 1);
+
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+
+
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+
+
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+
+
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+
+
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+
+
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+
+
+
+static uint32_t _clock()
+{
+	return _now;
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+	assert(argc == 2);
+
+	FILE* log = fopen(argv[1], "w");
+	assert(log != NULL);
+
+	dbSetClock(_clock);
+
+	EEPROM_Memory db(2048);
+	assert(db.begin() == SUCCESS);
+	assert(db.format() == SUCCESS);
+
+	// Keys longer than the small string buffers of the cores, and some sharing long prefixes for front coding
+	String keys[KEYS];
+	String values[KEYS];
+
+	for (int i = 0 ; i < KEYS ; i++)
+	{
+		keys[i] = "sensor/kitchen/long-name-" + String(i % 37) + (((i % 3) != 0) ? "/temperature" : "/hum");
+		values[i] = "value-that-is-long-" + String(i * 7919);
+	}
+
+	char buffer[64];
+	const char* view;
+	size_t length;
+
+	srand(3);
+	_counting = true;
+
+	for (int round = 0 ; round < ROUNDS ; round++)
+	{
+		int key = rand() % KEYS;
+		int operation = rand() % 10;
+
+		if (operation < 5)
+		{
+			int8_t result = db.insert(keys[key], values[rand() % KEYS], ((rand() % 7) == 0) ? 3 : 0);
+			fprintf(log, "i %d %d\n", round, result);
+		}
+		else if (operation < 7)
+		{
+			fprintf(log, "r %d %d\n", round, db.remove(keys[key]));
+		}
+		else if (operation < 8)
+		{
+			int read = db.get(keys[key], buffer, sizeof(buffer));
+			fprintf(log, "g %d %d %s\n", round, read, (read >= 0) ? buffer : "");
+		}
+		else if (operation < 9)
+		{
+			bool exists = db.exists(keys[key]);
+			bool viewed = db.getView(keys[key], view, length);
+			fprintf(log, "e %d %d %d\n", round, exists, viewed ? (int)length : -1);
+		}
+		else
+		{
+			if ((rand() % 20) == 0)
+			{
+				fprintf(log, "o %d %d\n", round, db.optimize());
+			}
+			else
+			{
+				fprintf(log, "s %d %d\n", round, db.sweep(1 + (rand() % 16)));
+			}
+
+			_now++;
+		}
+	}
+
+	_counting = false;
+
+	fprintf(log, "%s\n", db.getAll().c_str());
+	fclose(log);
+
+#if defined(DB_STATIC_ARENA)
+	printf("ArenaTest: %ld allocations after begin, arena peak %u bytes\n", _allocations, (unsigned)dbArenaPeak());
+	assert(_allocations == 0);
+#else
+	printf("ArenaTest: %ld allocations after begin without the arena\n", _allocations);
+#endif
+
+	return 0;
+}
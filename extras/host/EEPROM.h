@@ -0,0 +1,28 @@
+// Host stand-in of the EEPROM library of the ESP8266 and ESP32 cores, a RAM buffer which commit copies to
+// the emulated flash
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+#include "Arduino.h"
+#include <vector>
+
+class EEPROMClass {
+  public:
+    std::vector<uint8_t> flash = std::vector<uint8_t>(4096, 0xFF);
+    std::vector<uint8_t> buffer;
+    long commits = 0;
+
+    void begin(size_t size) { buffer.assign(flash.begin(), flash.begin() + std::min<size_t>(size, flash.size())); }
+    uint8_t read(int address) { return ((address >= 0) && ((size_t)address < buffer.size())) ? buffer[address] : 0; }
+    void write(int address, uint8_t value) { if ((address >= 0) && ((size_t)address < buffer.size())) buffer[address] = value; }
+    bool commit() { commits++; std::copy(buffer.begin(), buffer.end(), flash.begin()); return true; }
+    bool end() { commit(); buffer.clear(); return true; }
+    size_t length() { return buffer.size(); }
+    uint8_t* getDataPtr() { return buffer.data(); }
+#if !defined(ESP32)
+    const uint8_t* getConstDataPtr() const { return buffer.data(); }
+#endif
+    template <typename T> T& get(int address, T& value) { memcpy(&value, &buffer[address], sizeof(T)); return value; }
+    template <typename T> const T& put(int address, const T& value) { memcpy(&buffer[address], &value, sizeof(T)); return value; }
+};
+inline EEPROMClass EEPROM;
+#endif
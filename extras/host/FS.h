@@ -0,0 +1,48 @@
+// Host stand-in of the file system of the ESP8266 core, files are kept in RAM. Only what the EEPROM
+// database links against (the spilled runs of BulkLoader) is provided
+#ifndef HOST_FS_H
+#define HOST_FS_H
+#include "Arduino.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+  public:
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t pos = 0;
+
+    explicit operator bool() const { return (bool)data; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* b, size_t n) override { if (!data) return 0; if ((pos + n) > data->size()) data->resize(pos + n); memcpy(data->data() + pos, b, n); pos += n; return n; }
+    using Print::write;
+    int available() override { return data ? (int)(data->size() - pos) : 0; }
+    int read() override { return (data && (pos < data->size())) ? (*data)[pos++] : -1; }
+    int peek() override { return (data && (pos < data->size())) ? (*data)[pos] : -1; }
+    bool seek(uint32_t p, SeekMode mode = SeekSet) { size_t n = (mode == SeekSet) ? p : ((mode == SeekCur) ? pos + p : size() + p); if (!data || (n > data->size())) return false; pos = n; return true; }
+    size_t position() const { return pos; }
+    size_t size() const { return data ? data->size() : 0; }
+    void close() { data.reset(); }
+};
+
+class FS {
+  public:
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+
+    bool begin() { return true; }
+    bool exists(const String& path) { return files.count(path.s) > 0; }
+    bool remove(const String& path) { return files.erase(path.s) > 0; }
+    bool rename(const String& from, const String& to) { auto it = files.find(from.s); if (it == files.end()) return false; files[to.s] = it->second; files.erase(from.s); return true; }
+    File open(const String& path, const char* mode)
+    {
+        File file;
+        if ((mode[0] == 'w') || ((mode[0] == 'a') && !exists(path))) files[path.s] = std::make_shared<std::vector<uint8_t>>();
+        auto it = files.find(path.s);
+        if (it != files.end()) { file.data = it->second; file.pos = (mode[0] == 'a') ? file.size() : 0; }
+        return file;
+    }
+};
+inline FS SPIFFS;
+#endif
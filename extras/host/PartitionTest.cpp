@@ -0,0 +1,149 @@
+/*
+    PartitionTest.cpp - Host test of Partition_Memory on the partition stand-in,
+                    switching between the two halves in optimize and begin
+    and recovering from resets during writes
+*/
+
+#include "Arduino.h"
+#include "Partition_Memory.h"
+#include <assert.h>
+
+#define HALF_SIZE (32 * 1024)
+
+static uint32_t _now = 1000;
+
+static uint32_t _clock()
+{
+	return _now;
+}
+
+
+
+
+// Half whose header has the greatest sequence number, as begin chooses it
+static int _activeHalf()
+{
+	int active = -1;
+	uint32_t best = 0;
+
+	for (int half = 0 ; half < 2 ; half++)
+	{
+		const uint8_t* header = hostFlash.map + (half * HALF_SIZE);
+		uint32_t sequence = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+
+		if ((memcmp(header, "ADBP", 4) == 0) && ((active == -1) || (sequence > best)))
+		{
+			active = half;
+			best = sequence;
+		}
+	}
+
+	return active;
+}
+
+
+
+
+static void _checkKeys(Partition_Memory& db, int count, const char* suffix)
+{
+	for (int i = 0 ; i < count ; i++)
+	{
+		assert(db.get("key" + String(i), "") == "value" + String(i) + suffix);
+	}
+}
+
+
+
+
+int main()
+{
+	dbSetClock(_clock);
+
+	Partition_Memory missing("none");
+	assert(missing.begin() == FAILURE);
+
+	// Empty partition is formatted into the first half
+	Partition_Memory* db = new Partition_Memory("db");
+	assert(db->begin() == SUCCESS);
+	assert(_activeHalf() == 0);
+
+	for (int i = 0 ; i < 50 ; i++)
+	{
+		assert(db->insert("key" + String(i), "value" + String(i)) == SUCCESS);
+	}
+
+	assert(db->insert("gone", "soon") == SUCCESS);
+	assert(db->remove("gone") == SUCCESS);
+	assert(db->insert("short", "lived", 5) == SUCCESS);
+	_now += 10;
+
+	// optimize copies the live records to the other half and makes it active
+	assert(db->optimize() == SUCCESS);
+	assert(_activeHalf() == 1);
+	_checkKeys(*db, 50, "");
+	assert(!db->exists("gone"));
+	assert(!db->exists("short"));
+
+	// Both halves hold a valid header now, begin chooses the newer one
+	delete db;
+	db = new Partition_Memory("db");
+	assert(db->begin() == SUCCESS);
+	_checkKeys(*db, 50, "");
+	assert(!db->exists("gone"));
+
+	// Inserts optimize when the half is full, switching back to the first half
+	int rounds = 0;
+
+	while (_activeHalf() == 1)
+	{
+		for (int i = 0 ; i < 50 ; i++)
+		{
+			assert(db->insert("key" + String(i), "value" + String(i) + "b") == SUCCESS);
+		}
+
+		rounds++;
+	}
+
+	assert(rounds > 1);
+	_checkKeys(*db, 50, "b");
+
+	// Reset while optimize copies the records, before the header of the new half is written
+	hostFlash.writeBudget = 100;
+	assert(db->optimize() == FAILURE);
+	hostFlash.writeBudget = -1;
+	assert(_activeHalf() == 0);
+
+	delete db;
+	db = new Partition_Memory("db");
+	assert(db->begin() == SUCCESS);
+	_checkKeys(*db, 50, "b");
+	assert(db->insert("after", "reset") == SUCCESS);
+	assert(db->get("after", "") == "reset");
+
+	// Reset in the middle of appending a record, begin drops it by moving the records to the other half
+	long erases = hostFlash.erases;
+	hostFlash.writeBudget = 6;
+	assert(db->insert("torn", "record") == FAILURE);
+	hostFlash.writeBudget = -1;
+
+	delete db;
+	db = new Partition_Memory("db");
+	assert(db->begin() == SUCCESS);
+	assert(hostFlash.erases == (erases + 1));
+	assert(_activeHalf() == 1);
+	assert(!db->exists("torn"));
+	_checkKeys(*db, 50, "b");
+	assert(db->get("after", "") == "reset");
+
+	assert(db->insert("torn", "record") == SUCCESS);
+	assert(db->get("torn", "") == "record");
+
+	// Records are appended only to erased bytes
+	assert(hostFlash.badWrites == 0);
+
+	delete db;
+
+	printf("PartitionTest: passed, %ld writes and %ld erases\n", hostFlash.writes, hostFlash.erases);
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+    ScanKernelTest.cpp - Host test of the word at a time scanning, checked
+                    against a byte at a time search on random data
+    Built twice by run.sh, with DB_SCAN_SWAR for the code used by the boards
+    and without it for the SSE2 or AVX2 code of host builds
+*/
+
+#include "Arduino.h"
+#include "ScanKernel.h"
+#include <assert.h>
+
+#define ROUNDS 200000
+#define MAX_LENGTH 200
+#define MAX_SHIFT 16
+
+static int _naiveFindRun(const char* data, int length, char target, int count)
+{
+	for (int i = 0 ; (i + count) <= length ; i++)
+	{
+		int run = 0;
+
+		while ((run < count) && (data[i + run] == target))
+		{
+			run++;
+		}
+
+		if (run == count)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+
+int main()
+{
+	char first[MAX_LENGTH + MAX_SHIFT];
+	char second[MAX_LENGTH + MAX_SHIFT];
+
+	srand(7);
+
+	for (int round = 0 ; round < ROUNDS ; round++)
+	{
+		// Unaligned starts and lengths, with few distinct bytes so that runs and matches are frequent
+		int length = rand() % MAX_LENGTH;
+		char* data = first + (rand() % MAX_SHIFT);
+		char* other = second + (rand() % MAX_SHIFT);
+
+		for (int i = 0 ; i < length ; i++)
+		{
+			data[i] = "ab\n>:"[rand() % (((round % 3) != 0) ? 5 : 2)];
+		}
+
+		char target = "\n>:"[rand() % 3];
+		int count = 1 + (rand() % 3);
+
+		assert(dbFindByte(data, length, target) == _naiveFindRun(data, length, target, 1));
+		assert(dbFindRun(data, length, target, count) == _naiveFindRun(data, length, target, count));
+
+		memcpy(other, data, length);
+
+		if ((length > 0) && ((rand() % 2) == 0))
+		{
+			other[rand() % length] ^= 1;
+		}
+
+		int mismatch = 0;
+
+		while ((mismatch < length) && (data[mismatch] == other[mismatch]))
+		{
+			mismatch++;
+		}
+
+		assert(dbMismatch(data, other, length) == mismatch);
+	}
+
+	printf("ScanKernelTest: %d rounds passed\n", ROUNDS);
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+// Host stand-in of the partition API of the ESP32 core, a single data partition backed by a file mapped
+// with mmap. Writes only clear bits like NOR flash, and can be cut off after a number of bytes to test
+// the recovery from a reset during a write
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "esp_spi_flash.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum { ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+// Set by the test before the first use of the partition
+struct HostFlash {
+    const char* path = "partition.bin";
+    uint32_t size = 64 * 1024;
+    long writeBudget = -1;      // bytes written before the simulated reset, -1 for no reset
+    long writes = 0;
+    long erases = 0;
+    long badWrites = 0;         // writes setting bits which were not erased
+    int fd = -1;
+    uint8_t* map = NULL;
+    esp_partition_t partition;
+};
+inline HostFlash hostFlash;
+
+inline bool hostFlashOpen() {
+    if (hostFlash.map != NULL) {
+        return true;
+    }
+    unlink(hostFlash.path);
+    hostFlash.fd = open(hostFlash.path, O_RDWR | O_CREAT, 0644);
+    if ((hostFlash.fd < 0) || (ftruncate(hostFlash.fd, hostFlash.size) != 0)) {
+        return false;
+    }
+    void* map = mmap(NULL, hostFlash.size, PROT_READ | PROT_WRITE, MAP_SHARED, hostFlash.fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    hostFlash.map = (uint8_t*)map;
+    memset(hostFlash.map, 0xFF, hostFlash.size);
+    hostFlash.partition.address = 0;
+    hostFlash.partition.size = hostFlash.size;
+    strcpy(hostFlash.partition.label, "db");
+    return true;
+}
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char* label) {
+    return (hostFlashOpen() && (strcmp(label, hostFlash.partition.label) == 0)) ? &hostFlash.partition : NULL;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)src;
+    if ((offset + size) > partition->size) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (hostFlash.writeBudget == 0) {
+            return ESP_FAIL;
+        }
+        if (hostFlash.writeBudget > 0) {
+            hostFlash.writeBudget--;
+        }
+        if ((hostFlash.map[offset + i] & bytes[i]) != bytes[i]) {
+            hostFlash.badWrites++;
+        }
+        hostFlash.map[offset + i] &= bytes[i];
+    }
+    hostFlash.writes++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (((offset % SPI_FLASH_SEC_SIZE) != 0) || ((size % SPI_FLASH_SEC_SIZE) != 0) || ((offset + size) > partition->size)) {
+        return ESP_FAIL;
+    }
+    if (hostFlash.writeBudget == 0) {
+        return ESP_FAIL;
+    }
+    memset(hostFlash.map + offset, 0xFF, size);
+    hostFlash.erases++;
+    return ESP_OK;
+}
+
+// Read only mapping of the same file, so the written bytes show up in it as through the flash cache
+inline esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size, spi_flash_mmap_memory_t,
+                                    const void** out, spi_flash_mmap_handle_t* handle) {
+    if ((offset + size) > partition->size) {
+        return ESP_FAIL;
+    }
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, hostFlash.fd, offset);
+    if (map == MAP_FAILED) {
+        return ESP_FAIL;
+    }
+    *out = map;
+    *handle = 1;
+    return ESP_OK;
+}
+#endif
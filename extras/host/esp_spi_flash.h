@@ -0,0 +1,8 @@
+// Host stand-in of the flash definitions of the ESP32 core used by Partition_Memory
+#ifndef HOST_ESP_SPI_FLASH_H
+#define HOST_ESP_SPI_FLASH_H
+#include <stdint.h>
+#define SPI_FLASH_SEC_SIZE 4096
+typedef enum { SPI_FLASH_MMAP_DATA, SPI_FLASH_MMAP_INST } spi_flash_mmap_memory_t;
+typedef uint32_t spi_flash_mmap_handle_t;
+#endif
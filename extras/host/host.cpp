@@ -0,0 +1,14 @@
+// Definitions of the host stand-in of the Arduino core
+#include "Arduino.h"
+#include <stdarg.h>
+#include <chrono>
+
+HardwareSerial Serial;
+
+static unsigned long _hostMillis = 0;
+
+unsigned long millis() { return _hostMillis += 1; }
+unsigned long micros() { return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+void delay(unsigned long ms) { _hostMillis += ms; }
+void yield() {}
+size_t Print::printf(const char* fmt, ...) { char b[512]; va_list a; va_start(a, fmt); int n = vsnprintf(b, sizeof b, fmt, a); va_end(a); return write((const uint8_t*)b, n); }
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Builds and runs the host tests of the library with g++, against the stand-ins of the Arduino core
+# in this folder. Run from anywhere: sh extras/host/run.sh
+set -e
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+SRC="$HOST/../../src"
+OUT="${TMPDIR:-/tmp}/arduinodb-host"
+CXX="${CXX:-g++} -std=gnu++17 -g -Wall -I$HOST -I$SRC"
+
+mkdir -p "$OUT"
+
+# Scanning a word at a time as on the boards, and with the vector instructions of the host
+$CXX -DDB_SCAN_SWAR "$HOST/ScanKernelTest.cpp" "$SRC/ScanKernel.cpp" -o "$OUT/ScanKernelSwar"
+"$OUT/ScanKernelSwar"
+$CXX "$HOST/ScanKernelTest.cpp" "$SRC/ScanKernel.cpp" -o "$OUT/ScanKernel"
+"$OUT/ScanKernel"
+
+# Raw flash partition of ESP32, on a file in the output folder standing in for the partition
+$CXX -DESP32 "$HOST/PartitionTest.cpp" "$HOST/host.cpp" "$SRC/Partition_Memory.cpp" "$SRC/DbUtils.cpp" \
+	"$SRC/Compression.cpp" "$SRC/KeyDirectory.cpp" "$SRC/ScanKernel.cpp" "$SRC/DbArena.cpp" -o "$OUT/PartitionTest"
+(cd "$OUT" && ./PartitionTest)
+
+# EEPROM database counting the heap allocations after begin, none are allowed with the static arena
+EEPROM_SRC="$HOST/ArenaTest.cpp $HOST/host.cpp $SRC/EEPROM_Memory.cpp $SRC/DbUtils.cpp $SRC/Compression.cpp \
+	$SRC/KeyDirectory.cpp $SRC/ScanKernel.cpp $SRC/DbArena.cpp $SRC/Backup.cpp $SRC/BulkLoader.cpp"
+$CXX -DESP8266 -DDB_STATIC_ARENA $EEPROM_SRC -o "$OUT/ArenaTest"
+$CXX -DESP8266 $EEPROM_SRC -o "$OUT/ArenaTestHeap"
+(cd "$OUT" && ./ArenaTest arena.log && ./ArenaTestHeap heap.log && cmp arena.log heap.log)
+
+echo "All host tests passed"
@@ -8,6 +8,18 @@
 #include "Arduino.h"
 #include "ArduinoDb.h"
 
+/**
+ * Scan callback adding the key value pair to the index being rebuilt, passed as context
+ */
+static bool _indexPair(const String& key, const String& value, void* context)
+{
+	((ValueIndex*)context)->put(key, value);
+	return true;
+}
+
+
+
+
 /**
  * Constructor of the class for SPIFFS memory
  */
@@ -32,17 +44,343 @@ ArduinoDb::ArduinoDb(int EEPROMSize)
 
 
 
+/**
+ * Constructor of the class for a namespace of SPIFFS memory
+ */
+ArduinoDb::ArduinoDb(const char* name)
+{
+	_mode = 1;
+	_SPIFFSMemory = SPIFFS_Memory(name);
+}
+
+
+
+
+/**
+ * Constructor of the class for a region of EEPROM memory
+ */
+ArduinoDb::ArduinoDb(int EEPROMSize, int EEPROMOffset)
+{
+	_mode = 0;
+	_EEPROMMemory = EEPROM_Memory(EEPROMSize, EEPROMOffset);
+}
+
+
+
+
+/**
+ * Constructor of the class for using EEPROM and SPIFFS memory together
+ */
+ArduinoDb::ArduinoDb(int EEPROMSize, const char* name)
+{
+	_mode = 2;
+	_TieredMemory = Tiered_Memory(EEPROMSize, name);
+}
+
+
+
+
+ArduinoDb::~ArduinoDb()
+{
+	abortTransaction();
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+bool ArduinoDb::_commit(DbWriteGuard& guard, bool changed)
+{
+	// Compactions, promotions of the tiered database and sweeps removing nothing are not writes of the application
+	if (changed)
+	{
+		_lastWriteMs = millis();
+	}
+
+	// Only the RAM mirror was written under the exclusive lock, readers can continue during the flash write
+	guard.downgrade();
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.commit();
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.commit();
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+void ArduinoDb::_prepareScan(DbWriteGuard& guard)
+{
+	bool built = FAILURE;
+
+	if (_mode == 0)
+	{
+		built = _EEPROMMemory.buildDirectory();
+	}
+	else if (_mode == 1)
+	{
+		built = _SPIFFSMemory.buildDirectory();
+	}
+	else if (_mode == 2)
+	{
+		built = _TieredMemory.buildDirectory();
+	}
+
+	// Otherwise the scan builds the directory itself, which needs the exclusive lock
+	if (built == SUCCESS)
+	{
+		guard.downgrade();
+	}
+}
+
+
+
+
+File ArduinoDb::_openSnapshot(int8_t slot)
+{
+	if (_mode == 1)
+	{
+		return _SPIFFSMemory.openSnapshot(slot);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.openSnapshot(slot);
+	}
+
+	return File();
+}
+
+
+
+
+void ArduinoDb::_unpinSnapshot(int8_t slot)
+{
+	if (_mode == 1)
+	{
+		_SPIFFSMemory.unpinSnapshot(slot);
+	}
+	else if (_mode == 2)
+	{
+		_TieredMemory.unpinSnapshot(slot);
+	}
+}
+
+
+
+
+bool ArduinoDb::_stage(const Key& key, const String& value, uint32_t ttlSeconds, bool removed)
+{
+	if (_txKeys == NULL)
+	{
+		return FAILURE;
+	}
+
+	int idx = 0;
+
+	while ((idx < _txCount) && !key.equals(_txKeys[idx]))
+	{
+		idx++;
+	}
+
+	if (idx == TRANSACTION_MAX_KEYS)
+	{
+		return FAILURE;
+	}
+
+	if (idx == _txCount)
+	{
+		_txCount++;
+	}
+
+	_txKeys[idx] = key.c_str();
+	_txValues[idx] = removed ? String("") : value;
+	_txTtls[idx] = ttlSeconds;
+	_txRemoved[idx] = removed;
+
+	return SUCCESS;
+}
+
+
+
+
+void ArduinoDb::_indexValue(const Key& key, const String& value, bool removed)
+{
+	if (!_valueIndex.covers(key))
+	{
+		return;
+	}
+
+	if (removed)
+	{
+		_valueIndex.erase(key);
+	}
+	else
+	{
+		_valueIndex.put(key, value);
+	}
+}
+
+
+
+
+void ArduinoDb::_buildValueIndex()
+{
+	_valueIndex.clear();
+
+	for (int i = 0 ; i < _valueIndex.prefixCount() ; i++)
+	{
+		if (_mode == 0)
+		{
+			_EEPROMMemory.scanPrefix(_valueIndex.prefixAt(i), _indexPair, &_valueIndex);
+		}
+		else if (_mode == 1)
+		{
+			_SPIFFSMemory.scanPrefix(_valueIndex.prefixAt(i), _indexPair, &_valueIndex);
+		}
+		else if (_mode == 2)
+		{
+			_TieredMemory.scanPrefix(_valueIndex.prefixAt(i), _indexPair, &_valueIndex);
+		}
+	}
+}
+
+
+
+
+bool ArduinoDb::_findByValue(const String& value, String& key)
+{
+	uint32_t hash = dbHash(value.c_str(), value.length());
+
+	for (int pos = _valueIndex.lowerBound(hash) ; (pos < _valueIndex.size()) && (_valueIndex.hashAt(pos) == hash) ; pos++)
+	{
+		const String& candidate = _valueIndex.keyAt(pos);
+		bool found = FAILURE;
+		String stored = "";
+
+		if (_mode == 0)
+		{
+			found = _EEPROMMemory.exists(candidate);
+			stored = found ? _EEPROMMemory.get(candidate, "") : "";
+		}
+		else if (_mode == 1)
+		{
+			found = _SPIFFSMemory.exists(candidate);
+			stored = found ? _SPIFFSMemory.get(candidate, "") : "";
+		}
+		else if (_mode == 2)
+		{
+			found = _TieredMemory.exists(candidate);
+			stored = found ? _TieredMemory.get(candidate, "") : "";
+		}
+
+		// Other values with the same hash, and keys expired since they were indexed, are skipped
+		if (found && stored.equals(value))
+		{
+			key = candidate;
+			return SUCCESS;
+		}
+	}
+
+	return FAILURE;
+}
+
+
+
+
+DbUsage ArduinoDb::_getUsage()
+{
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.getUsage();
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.getUsage();
+	}
+
+	return _TieredMemory.getUsage();
+}
+
+
+
+
+uint32_t ArduinoDb::_freeSpace()
+{
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.freeSpace();
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.freeSpace();
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.freeSpace();
+	}
+
+	return 0;
+}
+
+
+
+
 // ****************** PUBLIC METHODS **************************
 bool ArduinoDb::begin()
 {
+	if (!_lock.begin())
+	{
+		return FAILURE;
+	}
+
+	DbWriteGuard guard(_lock);
+	bool result = FAILURE;
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.begin();
+		result = _EEPROMMemory.begin();
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.begin();
+		result = _SPIFFSMemory.begin();
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.begin();
+	}
+
+	// Writing the changes of a transaction interrupted by a reset, before the data is used
+	bool replayed = SUCCESS;
+
+	if ((result == SUCCESS) && (_mode == 1))
+	{
+		replayed = (_SPIFFSMemory.replayJournal() == SUCCESS) ? SUCCESS : FAILURE;
+	}
+	else if ((result == SUCCESS) && (_mode == 2))
+	{
+		replayed = (_TieredMemory.replayJournal() == SUCCESS) ? SUCCESS : FAILURE;
+	}
+
+	if (result == SUCCESS)
+	{
+		_buildValueIndex();
 	}
+
+#if defined(THREAD_SAFE)
+	// EEPROM is committed by _commit, after the exclusive lock is downgraded
+	_EEPROMMemory.setDeferredCommit(true);
+	_TieredMemory.setDeferredCommit(true);
+#endif
+
+	// A journal which could not be replayed is set aside, the data can be used without its changes
+	return result && replayed;
 }
 
 
@@ -50,105 +388,843 @@ bool ArduinoDb::begin()
 
 bool ArduinoDb::format()
 {
+	DbWriteGuard guard(_lock);
+	bool result = FAILURE;
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.format();
+		result = _EEPROMMemory.format();
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.format();
+		result = _SPIFFSMemory.format();
 	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.format();
+	}
+
+	_valueIndex.clear();
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
 }
 
 
 
 
-int8_t ArduinoDb::optimize()
+bool ArduinoDb::clear()
 {
+	DbWriteGuard guard(_lock);
+	bool result = FAILURE;
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.optimize();
+		result = _EEPROMMemory.clear();
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.optimize();
+		result = _SPIFFSMemory.clear();
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.clear();
 	}
+
+	_valueIndex.clear();
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
 }
 
 
 
 
-String ArduinoDb::get(const String& key, const String& defaultValue)
-{	
+int8_t ArduinoDb::optimize()
+{
+	DbWriteGuard guard(_lock);
+	uint32_t freeBytes = _freeSpace();
+	int8_t result = FAILURE;
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.get(key, defaultValue);
+		result = _EEPROMMemory.optimize();
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.get(key, defaultValue);
+		result = _SPIFFSMemory.optimize();
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.optimize();
+	}
+
+	// Dropping the entries of the keys expired since they were indexed, none were if no space was freed
+	if (_freeSpace() != freeBytes)
+	{
+		_buildValueIndex();
 	}
+
+	return _commit(guard, false) ? result : FAILURE;
 }
 
 
 
 
-String ArduinoDb::getAll()
+void ArduinoDb::setCompression(uint16_t minSize)
 {
+	DbWriteGuard guard(_lock);
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.getAll();
+		_EEPROMMemory.setCompression(minSize);
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.getAll();
+		_SPIFFSMemory.setCompression(minSize);
+	}
+	else if (_mode == 2)
+	{
+		_TieredMemory.setCompression(minSize);
 	}
 }
 
 
 
 
-// TODO: Optimize/defrag memory before inserting data if memory is close to full
-int8_t ArduinoDb::insert(const String& key, const String& value)
+String ArduinoDb::get(const Key& key, const String& defaultValue)
 {
+	if (_mode == 2)
+	{
+		// Reads of the tiered database count the reads and may move the key to EEPROM
+		DbWriteGuard guard(_lock);
+		String value = _TieredMemory.get(key, defaultValue);
+		_commit(guard, false);
+
+		return value;
+	}
+
+	DbReadGuard guard(_lock);
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.insert(key, value);
+		return _EEPROMMemory.get(key, defaultValue);
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.insert(key, value);
+		return _SPIFFSMemory.get(key, defaultValue);
 	}
+
+	return defaultValue;
 }
 
 
 
 
-bool ArduinoDb::remove(const String& key)
+int ArduinoDb::get(const Key& key, char* buffer, size_t bufferSize)
 {
+	DbReadGuard guard(_lock);
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.remove(key);
+		return _EEPROMMemory.get(key, buffer, bufferSize);
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.remove(key);
+		return _SPIFFSMemory.get(key, buffer, bufferSize);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.get(key, buffer, bufferSize);
 	}
+
+	return -1;
 }
 
 
 
 
-bool ArduinoDb::exists(const String& key)
+bool ArduinoDb::getView(const Key& key, const char*& value, size_t& length)
 {
+	DbReadGuard guard(_lock);
+
 	if (_mode == 0)
 	{
-		return _EEPROMMemory.exists(key);
+		return _EEPROMMemory.getView(key, value, length);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.getView(key, value, length);
+	}
+
+	return FAILURE;
+}
+
+
+
+
+String ArduinoDb::getAll()
+{
+	DbReadGuard guard(_lock);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.getAll();
 	}
 	else if (_mode == 1)
 	{
-		return _SPIFFSMemory.exists(key);
+		return _SPIFFSMemory.getAll();
 	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.getAll();
+	}
+
+	return "";
+}
+
+
+
+
+int ArduinoDb::getMany(const String keys[], String values[], int count, const String& defaultValue)
+{
+	DbReadGuard guard(_lock);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.getMany(keys, values, count, defaultValue);
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.getMany(keys, values, count, defaultValue);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.getMany(keys, values, count, defaultValue);
+	}
+
+	return 0;
+}
+
+
+
+
+// TODO: Optimize/defrag memory before inserting data if memory is close to full
+int8_t ArduinoDb::insert(const Key& key, const String& value)
+{
+	DbWriteGuard guard(_lock);
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.insert(key, value);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.insert(key, value);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.insert(key, value);
+	}
+
+	if (result == SUCCESS)
+	{
+		_indexValue(key, value, false);
+	}
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+int8_t ArduinoDb::insert(const Key& key, const String& value, uint32_t ttlSeconds)
+{
+	DbWriteGuard guard(_lock);
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.insert(key, value, ttlSeconds);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.insert(key, value, ttlSeconds);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.insert(key, value, ttlSeconds);
+	}
+
+	if (result == SUCCESS)
+	{
+		_indexValue(key, value, false);
+	}
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+int8_t ArduinoDb::putMany(const String keys[], const String values[], int count)
+{
+	DbWriteGuard guard(_lock);
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.putMany(keys, values, count);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.putMany(keys, values, count);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.putMany(keys, values, count);
+	}
+
+	for (int i = 0 ; (result == SUCCESS) && (i < count) ; i++)
+	{
+		_indexValue(keys[i], values[i], false);
+	}
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+bool ArduinoDb::remove(const Key& key)
+{
+	if (_txKeys != NULL)
+	{
+		return _stage(key, "", 0, true);
+	}
+
+	DbWriteGuard guard(_lock);
+	bool result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.remove(key);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.remove(key);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.remove(key);
+	}
+
+	// The data of an expired key is removed as well, though the key is reported as not found
+	_indexValue(key, "", true);
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+bool ArduinoDb::exists(const Key& key)
+{
+	DbReadGuard guard(_lock);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.exists(key);
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.exists(key);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.exists(key);
+	}
+
+	return FAILURE;
+}
+
+
+
+
+bool ArduinoDb::indexValues(const String& prefix)
+{
+	DbWriteGuard guard(_lock);
+
+	if (!_valueIndex.addPrefix(prefix))
+	{
+		return FAILURE;
+	}
+
+	_buildValueIndex();
+
+	return SUCCESS;
+}
+
+
+
+
+bool ArduinoDb::findByValue(const String& value, String& key)
+{
+	if (_mode == 2)
+	{
+		// Reads of the tiered database count the reads and may move the key to EEPROM
+		DbWriteGuard guard(_lock);
+		bool found = _findByValue(value, key);
+		_commit(guard, false);
+
+		return found;
+	}
+
+	DbReadGuard guard(_lock);
+
+	return _findByValue(value, key);
+}
+
+
+
+
+int ArduinoDb::sweep(int maxRecords)
+{
+	DbWriteGuard guard(_lock);
+	int result = 0;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.sweep(maxRecords);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.sweep(maxRecords);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.sweep(maxRecords);
+	}
+
+	// Dropping the entries of the swept keys, the stores do not tell which keys they removed
+	if (result > 0)
+	{
+		_buildValueIndex();
+	}
+
+	_commit(guard, result > 0);
+
+	return result;
+}
+
+
+
+
+void ArduinoDb::setClock(DbClock clock)
+{
+	dbSetClock(clock);
+}
+
+
+
+
+DbLockStats ArduinoDb::getLockStats()
+{
+	return _lock.getStats();
+}
+
+
+
+
+void ArduinoDb::resetLockStats()
+{
+	_lock.resetStats();
+}
+
+
+
+
+int ArduinoDb::scanPrefix(const String& prefix, ScanCallback callback, void* context)
+{
+	// Only building the sorted directory of keys on first use needs the exclusive lock
+	DbWriteGuard guard(_lock);
+	_prepareScan(guard);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.scanPrefix(prefix, callback, context);
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.scanPrefix(prefix, callback, context);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.scanPrefix(prefix, callback, context);
+	}
+
+	return 0;
+}
+
+
+
+
+int ArduinoDb::scanRange(const String& low, const String& high, ScanCallback callback, void* context)
+{
+	// Only building the sorted directory of keys on first use needs the exclusive lock
+	DbWriteGuard guard(_lock);
+	_prepareScan(guard);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.scanRange(low, high, callback, context);
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.scanRange(low, high, callback, context);
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.scanRange(low, high, callback, context);
+	}
+
+	return 0;
+}
+
+
+
+
+int ArduinoDb::exportTo(Print& out)
+{
+	DbReadGuard guard(_lock);
+	BackupWriter writer(out);
+
+	if (_mode == 0)
+	{
+		_EEPROMMemory.exportTo(writer);
+	}
+	else if (_mode == 1)
+	{
+		_SPIFFSMemory.exportTo(writer);
+	}
+	else if (_mode == 2)
+	{
+		_TieredMemory.exportTo(writer);
+	}
+
+	return writer.finish() ? writer.count() : -1;
+}
+
+
+
+
+int8_t ArduinoDb::importFrom(Stream& in)
+{
+	DbWriteGuard guard(_lock);
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.importFrom(in);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.importFrom(in);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.importFrom(in);
+	}
+
+	if (result == SUCCESS)
+	{
+		_buildValueIndex();
+	}
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+int8_t ArduinoDb::load(BulkLoader& loader)
+{
+	DbWriteGuard guard(_lock);
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.load(loader);
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.load(loader);
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.load(loader);
+	}
+
+	if (result == SUCCESS)
+	{
+		_buildValueIndex();
+	}
+
+	return _commit(guard, result == SUCCESS) ? result : FAILURE;
+}
+
+
+
+
+bool ArduinoDb::snapshot(DbSnapshot& snapshot)
+{
+	snapshot.release();
+
+	DbReadGuard guard(_lock);
+	String hotData = "";
+	uint32_t size = 0;
+	int8_t slot = -1;
+
+	if (_mode == 0)
+	{
+		hotData = _EEPROMMemory.getAll();
+	}
+	else if (_mode == 1)
+	{
+		slot = _SPIFFSMemory.pinSnapshot(size);
+
+		if (slot == -1)
+		{
+			return FAILURE;
+		}
+	}
+	else if (_mode == 2)
+	{
+		slot = _TieredMemory.pinSnapshot(hotData, size);
+
+		if (slot == -1)
+		{
+			return FAILURE;
+		}
+	}
+
+	snapshot._db = this;
+	snapshot._isValid = true;
+	snapshot._hotData = hotData;
+	snapshot._slot = slot;
+	snapshot._size = size;
+	snapshot._time = dbNow();
+
+	return SUCCESS;
+}
+
+
+
+
+bool ArduinoDb::beginTransaction()
+{
+	if (_txKeys != NULL)
+	{
+		return FAILURE;
+	}
+
+	_txKeys = new String[TRANSACTION_MAX_KEYS];
+	_txValues = new String[TRANSACTION_MAX_KEYS];
+	_txTtls = new uint32_t[TRANSACTION_MAX_KEYS];
+	_txRemoved = new bool[TRANSACTION_MAX_KEYS];
+	_txCount = 0;
+
+	return SUCCESS;
+}
+
+
+
+
+int8_t ArduinoDb::put(const Key& key, const String& value)
+{
+	return put(key, value, 0);
+}
+
+
+
+
+int8_t ArduinoDb::put(const Key& key, const String& value, uint32_t ttlSeconds)
+{
+	if (_txKeys == NULL)
+	{
+		return insert(key, value, ttlSeconds);
+	}
+
+	return _stage(key, value, ttlSeconds, false) ? SUCCESS : FAILURE;
+}
+
+
+
+
+int8_t ArduinoDb::commitTransaction()
+{
+	if (_txKeys == NULL)
+	{
+		return FAILURE;
+	}
+
+	int8_t result = SUCCESS;
+
+	if (_txCount > 0)
+	{
+		DbWriteGuard guard(_lock);
+		result = FAILURE;
+
+		if (_mode == 0)
+		{
+			// EEPROM needs no journal, all the changes are written to the RAM mirror and committed together
+			result = _EEPROMMemory.putMany(_txKeys, _txValues, _txTtls, _txRemoved, _txCount);
+		}
+		else if (_mode == 1)
+		{
+			result = _SPIFFSMemory.commitTransaction(_txKeys, _txValues, _txTtls, _txRemoved, _txCount);
+		}
+		else if (_mode == 2)
+		{
+			result = _TieredMemory.commitTransaction(_txKeys, _txValues, _txTtls, _txRemoved, _txCount);
+		}
+
+		for (int i = 0 ; (result == SUCCESS) && (i < _txCount) ; i++)
+		{
+			_indexValue(_txKeys[i], _txValues[i], _txRemoved[i]);
+		}
+
+		result = _commit(guard, result == SUCCESS) ? result : FAILURE;
+	}
+
+	abortTransaction();
+
+	return result;
+}
+
+
+
+
+void ArduinoDb::abortTransaction()
+{
+	delete[] _txKeys;
+	delete[] _txValues;
+	delete[] _txTtls;
+	delete[] _txRemoved;
+
+	_txKeys = NULL;
+	_txValues = NULL;
+	_txTtls = NULL;
+	_txRemoved = NULL;
+	_txCount = 0;
+}
+
+
+
+
+DbUsage ArduinoDb::getUsage()
+{
+	DbReadGuard guard(_lock);
+
+	return _getUsage();
+}
+
+
+
+
+void ArduinoDb::setCompactionPolicy(const CompactionPolicy& policy)
+{
+	DbWriteGuard guard(_lock);
+
+	_policy = policy;
+}
+
+
+
+
+int ArduinoDb::maintain()
+{
+	// Writes of other tasks update the time of the last write and the policy under the lock
+	DbWriteGuard guard(_lock);
+
+	// Written recently, more writes are likely to follow
+	if ((millis() - _lastWriteMs) < _policy.idleMs)
+	{
+		return 0;
+	}
+
+	DbUsage usage = _getUsage();
+	uint32_t freeBytes = (usage.capacity > usage.usedBytes) ? (usage.capacity - usage.usedBytes) : 0;
+
+	bool mostlyDead = (usage.deadBytes >= _policy.minDeadBytes) && ((usage.deadBytes * 100) >= (usage.usedBytes * _policy.minDeadPercent));
+	bool lowSpace = (usage.deadBytes > 0) && ((freeBytes * 100) < (usage.capacity * _policy.minFreePercent));
+
+	if (!mostlyDead && !lowSpace)
+	{
+		return 0;
+	}
+
+	int8_t result = FAILURE;
+
+	if (_mode == 0)
+	{
+		result = _EEPROMMemory.optimize();
+	}
+	else if (_mode == 1)
+	{
+		result = _SPIFFSMemory.optimize();
+	}
+	else if (_mode == 2)
+	{
+		result = _TieredMemory.optimize();
+	}
+
+	uint32_t usedBytes = _getUsage().usedBytes;
+
+	// Dropping the entries of the keys expired since they were indexed, none were if no bytes were reclaimed
+	if (usedBytes != usage.usedBytes)
+	{
+		_buildValueIndex();
+	}
+
+	if (!_commit(guard, false) || (result == FAILURE))
+	{
+		return -1;
+	}
+
+	return (usedBytes < usage.usedBytes) ? (usage.usedBytes - usedBytes) : 0;
+}
+
+
+
+
+uint32_t ArduinoDb::capacity()
+{
+	DbReadGuard guard(_lock);
+
+	if (_mode == 0)
+	{
+		return _EEPROMMemory.capacity();
+	}
+	else if (_mode == 1)
+	{
+		return _SPIFFSMemory.capacity();
+	}
+	else if (_mode == 2)
+	{
+		return _TieredMemory.capacity();
+	}
+
+	return 0;
+}
+
+
+
+
+uint32_t ArduinoDb::freeSpace()
+{
+	DbReadGuard guard(_lock);
+
+	return _freeSpace();
 }
 
 // ***********************************************************
\ No newline at end of file
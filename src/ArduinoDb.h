@@ -11,13 +11,125 @@
 #include "Arduino.h"
 #include "SPIFFS_Memory.h"
 #include "EEPROM_Memory.h"
+#include "EEPROM_FixedMemory.h"
+#include "Tiered_Memory.h"
+#include "Async_Memory.h"
+#include "TimeSeries_Memory.h"
+#include "Segment_Memory.h"
+#include "Partition_Memory.h"
+#include "Snapshot.h"
+#include "DbKey.h"
+#include "ValueIndex.h"
+#include "DbLock.h"
 
 class ArduinoDb {
+    public:
+        /**
+         * Key passed to the methods of the database, built from a literal, a char pointer or a String (see DbKey.h).
+         * The length and hash of constexpr keys are found at compile time, so lookups of them cost no work for the key
+         */
+        typedef DbKey Key;
+
     private:
-        byte _mode;     // 0- EEPROM, and 1- SPIFFS
+        byte _mode;     // 0- EEPROM, 1- SPIFFS, and 2- EEPROM and SPIFFS tiered
 
         SPIFFS_Memory _SPIFFSMemory = SPIFFS_Memory();
 		EEPROM_Memory _EEPROMMemory = EEPROM_Memory(0);
+		Tiered_Memory _TieredMemory = Tiered_Memory();
+
+        // Shared lock for reads and exclusive lock for writes, only if THREAD_SAFE is defined
+        DbLock _lock;
+
+        // Changes staged by the open transaction, _txKeys is NULL if no transaction is open
+        String* _txKeys = NULL;
+        String* _txValues = NULL;
+        uint32_t* _txTtls = NULL;
+        bool* _txRemoved = NULL;
+        int _txCount = 0;
+
+        CompactionPolicy _policy = { COMPACT_DEAD_PERCENT, COMPACT_MIN_DEAD_BYTES, COMPACT_FREE_PERCENT, COMPACT_IDLE_MS };
+        unsigned long _lastWriteMs = 0;     // millis() of the last write, for finding idle time
+
+        // Keys of the indexed prefixes by the hash of their value, see indexValues
+        ValueIndex _valueIndex;
+
+        /**
+         * This will stage a change in the open transaction, replacing an earlier change of the same key
+         * @param key key of the change
+         * @param value value associated with the key, not used if removed
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @param removed true if the key is removed
+         * @return SUCCESS if staged
+         * @return FAILURE if no transaction is open or TRANSACTION_MAX_KEYS keys are already staged
+         */
+        bool _stage(const Key& key, const String& value, uint32_t ttlSeconds, bool removed);
+
+        /**
+         * This will update the value index after a successful write of a key, the lock must be held by the caller
+         * @param key key which was written
+         * @param value value associated with the key, not used if removed
+         * @param removed true if the key was removed
+         */
+        void _indexValue(const Key& key, const String& value, bool removed);
+
+        /**
+         * This will fill the value index from the stored keys of the indexed prefixes, the lock must be held by the caller
+         * @param null
+         */
+        void _buildValueIndex();
+
+        /**
+         * This will find the key holding value using the value index, the lock must be held by the caller
+         * @param value value to search for
+         * @param key String to hold the key
+         * @return SUCCESS if found
+         * @return FAILURE otherwise
+         */
+        bool _findByValue(const String& value, String& key);
+
+        /**
+         * This will count the live and dead bytes of the memory, the lock must be held by the caller
+         * @param null
+         * @return usage of the memory
+         */
+        DbUsage _getUsage();
+
+        /**
+         * This will return the bytes that can still be written, the lock must be held by the caller
+         * @param null
+         * @return free space (in bytes)
+         */
+        uint32_t _freeSpace();
+
+        /**
+         * This will downgrade the exclusive lock of the write to shared and commit the deferred EEPROM writes
+         * @param guard exclusive lock held by the write
+         * @param changed true if the write changed the stored keys, so maintain waits for the next idle time
+         * @return SUCCESS if committed or nothing to commit
+         * @return FAILURE otherwise
+         */
+        bool _commit(DbWriteGuard& guard, bool changed);
+
+        /**
+         * This will build the sorted directory of keys of the memory, so that scans can run under the shared lock
+         * @param guard exclusive lock held by the scan, downgraded to shared if the directory is built
+         */
+        void _prepareScan(DbWriteGuard& guard);
+
+        /**
+         * This will open the file of a version of SPIFFS memory kept for a snapshot
+         * @param slot slot of the version
+         * @return handle of the file, false if the version was lost
+         */
+        File _openSnapshot(int8_t slot);
+
+        /**
+         * This will release a version of SPIFFS memory kept for a snapshot
+         * @param slot slot of the version
+         */
+        void _unpinSnapshot(int8_t slot);
+
+        friend class DbSnapshot;
 
 
     public:
@@ -35,10 +147,37 @@ class ArduinoDb {
          */
         ArduinoDb(int EEPROMSize);
 
+        /**
+         * Constructor for initializing class object for using a separate namespace of SPIFFS memory
+         * @param name name of the namespace, data is stored in file /<name>.txt (max 26 characters)
+         * @return null
+         */
+        ArduinoDb(const char* name);
+
+        /**
+         * Constructor for initializing class object for using a separate region of EEPROM memory
+         * @param EEPROMSize size of the region you want to use for Database storage(in bytes)
+         * @param EEPROMOffset index of the first byte of the region, regions of objects must not overlap
+         * @return null
+         */
+        ArduinoDb(int EEPROMSize, int EEPROMOffset);
+
+        /**
+         * Constructor for initializing class object for using EEPROM and SPIFFS memory together.
+         * Small and frequently read keys are kept in EEPROM, large or rarely read keys in SPIFFS
+         * @param EEPROMSize size of EEPROM memory used for the frequently read keys (in bytes), starting at the first byte
+         * @param name name of the SPIFFS namespace used for the rest of the keys, data is stored in file /<name>.txt
+         * @return null
+         */
+        ArduinoDb(int EEPROMSize, const char* name);
+
+        ~ArduinoDb();
+
         /**
          * This method will handle the initialization of the library
          * Note- Must be called within setup only once
-         * @return FAILURE is initialization fails
+         * @return FAILURE is initialization fails, or the changes of a transaction interrupted by a reset could not
+         * be written again. Its journal is moved to /<name>.jfl then, the data can be used without the changes
          * @return SUCCESS is initialization successful
          */
         bool begin();
@@ -50,6 +189,13 @@ class ArduinoDb {
          */
         bool format();
 
+        /**
+         * This method will remove all the data of this database only, other namespaces are not touched
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
         /**
          * Call this method to optimize the database forcefully
          * @param null
@@ -58,6 +204,13 @@ class ArduinoDb {
          */
         int8_t optimize();
 
+        /**
+         * This method will enable transparent compression of values for the following inserts.
+         * Values which do not get smaller are stored as it is, existing values are read either way
+         * @param minSize values of at least this length (in bytes) are compressed, 0 to disable
+         */
+        void setCompression(uint16_t minSize);
+
         /**
          * This method will return the value associated with key
          * @param key key for which value is required
@@ -65,7 +218,30 @@ class ArduinoDb {
          * @return value associated with key if found
          * @return defaultValue otherwise
          */
-        String get(const String& key, const String& defaultValue);
+        String get(const Key& key, const String& defaultValue);
+
+        /**
+         * This method will copy the value associated with key into buffer, decompressing it on the fly
+         * without building the whole value in memory. Values longer than the buffer are truncated
+         * @param key key for which value is required
+         * @param buffer buffer to hold the value, always null terminated
+         * @param bufferSize size of buffer (in bytes)
+         * @return length of the value copied into buffer
+         * @return -1 if key not found
+         */
+        int get(const Key& key, char* buffer, size_t bufferSize);
+
+        /**
+         * This method will return the value associated with key without copying it, only for values
+         * stored in EEPROM memory. The value points directly into the RAM mirror of EEPROM memory,
+         * it is not null terminated and is valid only until the next insert, remove, optimize or format
+         * @param key key for which value is required
+         * @param value to hold the pointer to the first byte of the value
+         * @param length to hold the number of bytes of the value
+         * @return SUCCESS if key found
+         * @return FAILURE if key not found, stored compressed or stored in SPIFFS memory
+         */
+        bool getView(const Key& key, const char*& value, size_t& length);
 
         /**
          * This method will return all the stored key value pairs
@@ -74,6 +250,16 @@ class ArduinoDb {
          */
         String getAll();
 
+        /**
+         * This method will return the values associated with multiple keys using a single scan of the database
+         * @param keys array of keys for which values are required
+         * @param values array to hold the values, must have space for count values
+         * @param count number of keys
+         * @param defaultValue default value to store for keys not found
+         * @return number of keys found
+         */
+        int getMany(const String keys[], String values[], int count, const String& defaultValue);
+
         /**
          * This method will insert the data into the database
          * @param key unique key for the value
@@ -81,15 +267,38 @@ class ArduinoDb {
          * @return SUCCESS if value inserted successfully
          * @return FAILURE is value insertion failed
          */
-        int8_t insert(const String& key, const String& value);
+        int8_t insert(const Key& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time.
+         * Expired keys are not returned by get/exists and are dropped by optimize and sweep
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const Key& key, const String& value, uint32_t ttlSeconds);
 
         /**
-         * This method will remove the key and associated value from db
+         * This method will insert multiple key value pairs using a single scan of the database and a single commit
+         * @param keys array of unique keys, for repeated keys the last value is kept
+         * @param values array of values associated with the keys
+         * @param count number of key value pairs
+         * @return SUCCESS if values inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t putMany(const String keys[], const String values[], int count);
+
+        /**
+         * This method will remove the key and associated value from db, or stage the removal in the open transaction
          * @param key key to be removed
          * @return FAILURE if fails or key not found
-         * @return SUCCESS if key removed successfully
+         * @return SUCCESS if key removed (or the removal staged) successfully
          */
-        bool remove(const String& key);
+        bool remove(const Key& key);
 
         /**
          * This method will tell weather the key exists or not in the database
@@ -97,7 +306,209 @@ class ArduinoDb {
          * @return SUCCESS if key found
          * @return FAILURE is key not found
          */
-        bool exists(const String& key);
+        bool exists(const Key& key);
+
+        /**
+         * This method will keep an index of the values of the keys starting with prefix in RAM, so that findByValue
+         * finds them without scanning the database. The index is built from the stored keys when declared (and
+         * by begin), kept up to date by insert, put and remove, and rebuilt when the database is compacted.
+         * Every indexed key takes RAM for the key and 4 bytes for the hash of its value
+         * @param prefix prefix of the keys to index, "" for all the keys of the database
+         * @return SUCCESS if the prefix is indexed
+         * @return FAILURE if VALUE_INDEX_MAX_PREFIXES prefixes are already indexed
+         */
+        bool indexValues(const String& prefix);
+
+        /**
+         * This method will find the key holding value among the keys of the indexed prefixes (see indexValues),
+         * looking up the hash of the value in the index and checking the stored value of the matching keys only
+         * @param value value to search for
+         * @param key String to hold the key, the smallest key if more keys hold the value
+         * @return SUCCESS if a key was found
+         * @return FAILURE if no indexed key holds the value
+         */
+        bool findByValue(const String& value, String& key);
+
+        /**
+         * This method will remove the expired keys, checking at most maxRecords records per call.
+         * Call it periodically (e.g. from loop), every call continues from where the previous one stopped
+         * @param maxRecords maximum number of records to check
+         * @return number of expired keys removed
+         */
+        int sweep(int maxRecords);
+
+        /**
+         * This method will set the clock used for expiring keys, shared by all the databases.
+         * By default time() is used, which needs the system time to be set (e.g. using configTime)
+         * @param clock function returning the current time in seconds
+         */
+        static void setClock(DbClock clock);
+
+        /**
+         * This method will return the hold and wait times of the lock of this database, collected only if
+         * THREAD_SAFE is defined. Writes to EEPROM hold the exclusive lock only until the flash commit
+         * @param null
+         * @return lock stats (in microseconds)
+         */
+        DbLockStats getLockStats();
+
+        /**
+         * This method will reset the hold and wait times of the lock of this database
+         * @param null
+         */
+        void resetLockStats();
+
+        /**
+         * This method will call callback for every key starting with prefix, in sorted order of keys
+         * Note- The callback must not modify the database, nor use it at all if THREAD_SAFE is defined
+         * @param prefix prefix of the keys to visit
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanPrefix(const String& prefix, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will call callback for every key from low (inclusive) to high (exclusive), in sorted order of keys
+         * Note- The callback must not modify the database, nor use it at all if THREAD_SAFE is defined
+         * @param low the first key of the range
+         * @param high the end of the range, this key is not visited
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanRange(const String& low, const String& high, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will write all the live key value pairs to out as a compact binary backup with a CRC,
+         * one record at a time, so it works for databases larger than the free RAM. Values are written
+         * uncompressed and with their expiry time, the backup can be loaded into any kind of database
+         * @param out where the backup is written (File, Serial, network client...)
+         * @return number of key value pairs written
+         * @return -1 if the backup could not be written
+         */
+        int exportTo(Print& out);
+
+        /**
+         * This method will replace all the data of this database with a backup written by exportTo, using a single
+         * sequential write and a single commit instead of an insert per key. The whole backup is checked before
+         * the data is replaced, so the data is not touched if the backup is corrupted or does not fit
+         * @param in where the backup is read from
+         * @return SUCCESS if the backup was loaded
+         * @return FAILURE if the backup is incomplete or corrupted
+         * @return MEM_FULL if the records do not fit in the memory
+         */
+        int8_t importFrom(Stream& in);
+
+        /**
+         * This method will replace all the data of this database with the pairs collected by a bulk loader.
+         * Records are written sorted in a single sequential write with a single commit, and the key directory
+         * is built while writing, so loading takes time linear in the size of the data instead of an insert
+         * (and a scan) per key. The data is not touched if the pairs do not fit
+         * @param loader loader holding the pairs
+         * @return SUCCESS if the pairs were loaded
+         * @return FAILURE if the pairs of the loader could not be read
+         * @return MEM_FULL if the pairs do not fit in the memory
+         */
+        int8_t load(BulkLoader& loader);
+
+        /**
+         * This method will take a consistent read only view of the data, which does not change while the database
+         * is written or optimized (see Snapshot.h). Only the EEPROM records are copied, the SPIFFS file is kept as
+         * it is and moved aside only if it is modified in place while the snapshot is open
+         * @param snapshot snapshot to fill, the data it held before is released
+         * @return SUCCESS if the snapshot was taken
+         * @return FAILURE if SNAPSHOT_MAX_VERSIONS versions of the SPIFFS file are already kept for other snapshots
+         */
+        bool snapshot(DbSnapshot& snapshot);
+
+        /**
+         * This method will open a transaction, the following put and remove calls are staged in RAM and written
+         * together by commitTransaction, so that either all or none of them are kept after a reset (see commitTransaction for EEPROM).
+         * Reads do not see the staged changes until they are committed
+         * Note- Only a single task should put and remove while a transaction is open
+         * @param null
+         * @return SUCCESS if the transaction was opened
+         * @return FAILURE if a transaction is already open
+         */
+        bool beginTransaction();
+
+        /**
+         * This method will stage the data in the open transaction, or insert it if no transaction is open
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return SUCCESS if value staged (or inserted) successfully
+         * @return FAILURE if TRANSACTION_MAX_KEYS keys are already staged or insertion failed
+         */
+        int8_t put(const Key& key, const String& value);
+
+        /**
+         * This method will stage the data in the open transaction, or insert it if no transaction is open,
+         * the data expires after the given time counted from the commit
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value staged (or inserted) successfully
+         * @return FAILURE if TRANSACTION_MAX_KEYS keys are already staged or insertion failed
+         */
+        int8_t put(const Key& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will write all the changes of the open transaction with a single commit and close it.
+         * SPIFFS changes are written to a redo journal first, which is replayed by begin if a reset interrupts the
+         * commit. EEPROM changes are written with a single commit of the RAM mirror, which is either done or not on
+         * ESP32. On ESP8266 the commit erases the flash sector before writing it, a reset in between loses the whole region
+         * @param null
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if no transaction is open or writing failed
+         * @return MEM_FULL if space for the values is not available, no change is written then
+         */
+        int8_t commitTransaction();
+
+        /**
+         * This method will drop the changes of the open transaction and close it
+         * @param null
+         */
+        void abortTransaction();
+
+        /**
+         * This method will return the bytes used by live records and by removed or expired records (dead bytes),
+         * counted with a single scan of the database
+         * @param null
+         * @return usage of the database, added together for both the tiers of a tiered database
+         */
+        DbUsage getUsage();
+
+        /**
+         * This method will set the thresholds used by maintain for compacting the database
+         * @param policy thresholds on the dead ratio, free space and idle time
+         */
+        void setCompactionPolicy(const CompactionPolicy& policy);
+
+        /**
+         * This method will compact the database if it has been idle (no writes) for the idle time of the compaction
+         * policy and either enough of the used bytes are dead or free space is low. Call it periodically (e.g. from loop),
+         * so that compaction is done while the device is idle and writes rarely have to compact first
+         * @param null
+         * @return number of bytes reclaimed, 0 if the database was not compacted
+         * @return -1 if the compaction failed
+         */
+        int maintain();
+
+        /**
+         * This method will return the bytes usable for records. For SPIFFS it is found from the size of the file system
+         * (FSInfo), leaving SPIFFS_RESERVE_PERCENT of it free and the space used by other files, and halving the rest
+         * @param null
+         * @return capacity (in bytes), added together for both the tiers of a tiered database
+         */
+        uint32_t capacity();
+
+        /**
+         * This method will return the bytes that can still be written before the database has to be compacted
+         * @param null
+         * @return free space (in bytes), added together for both the tiers of a tiered database
+         */
+        uint32_t freeSpace();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,434 @@
+/*
+    Async_Memory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers using SPIFFS memory with asynchronous writes
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Async_Memory.h"
+
+#if defined(ESP32)
+
+// Constructors
+
+Async_Memory::Async_Memory()
+{
+	_head = 0;
+	_tail = 0;
+	_nextTicket = 0;
+	_doneTicket = 0;
+	_callback = NULL;
+	_writer = NULL;
+	_engineLock = NULL;
+}
+
+
+
+
+Async_Memory::Async_Memory(const char* name) : _engine(name)
+{
+	_head = 0;
+	_tail = 0;
+	_nextTicket = 0;
+	_doneTicket = 0;
+	_callback = NULL;
+	_writer = NULL;
+	_engineLock = NULL;
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void Async_Memory::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[Async]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+void Async_Memory::_lock()
+{
+	// The lock is created by begin, before that there is no writer task to exclude
+	if (_engineLock != NULL)
+	{
+		xSemaphoreTake(_engineLock, portMAX_DELAY);
+	}
+}
+
+
+
+
+void Async_Memory::_unlock()
+{
+	if (_engineLock != NULL)
+	{
+		xSemaphoreGive(_engineLock);
+	}
+}
+
+
+
+
+uint32_t Async_Memory::_enqueue(uint8_t op, const String& key, const String& value, uint32_t ttlSeconds)
+{
+	if (_writer == NULL)
+	{
+		_print("Writer task not started");
+		return 0;
+	}
+
+	uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+	if ((_head - tail) >= ASYNC_QUEUE_SIZE)
+	{
+		_print("Write queue full");
+		return 0;
+	}
+
+	// Ticket 0 is kept for a failed enqueue
+	_nextTicket++;
+
+	if (_nextTicket == 0)
+	{
+		_nextTicket++;
+	}
+
+	// The slot is not read by the writer task until the head is moved past it
+	AsyncWrite& slot = _queue[_head % ASYNC_QUEUE_SIZE];
+	slot.op = op;
+	slot.ticket = _nextTicket;
+	slot.ttlSeconds = ttlSeconds;
+	slot.key = key;
+	slot.value = value;
+
+	__atomic_store_n(&_head, _head + 1, __ATOMIC_RELEASE);
+	xTaskNotifyGive(_writer);
+
+	return _nextTicket;
+}
+
+
+
+
+const AsyncWrite* Async_Memory::_pendingOf(const String& key)
+{
+	uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+	// Newest write first, slots are only replaced by this task so they stay valid even if stored meanwhile
+	for (uint32_t i = _head ; i != tail ; i--)
+	{
+		const AsyncWrite& slot = _queue[(i - 1) % ASYNC_QUEUE_SIZE];
+
+		if (slot.key == key)
+		{
+			return &slot;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+
+int Async_Memory::_applyBatch(uint32_t head)
+{
+	uint32_t tail = _tail;
+	const AsyncWrite& first = _queue[tail % ASYNC_QUEUE_SIZE];
+	int8_t result;
+	int count = 0;
+
+	_lock();
+
+	if ((first.op == ASYNC_INSERT) && (first.ttlSeconds == 0))
+	{
+		// Consecutive inserts without expiry are stored with a single write of the file
+		String keys[ASYNC_BATCH_SIZE];
+		String values[ASYNC_BATCH_SIZE];
+
+		while (((tail + count) != head) && (count < ASYNC_BATCH_SIZE))
+		{
+			const AsyncWrite& write = _queue[(tail + count) % ASYNC_QUEUE_SIZE];
+
+			if ((write.op != ASYNC_INSERT) || (write.ttlSeconds != 0))
+			{
+				break;
+			}
+
+			keys[count] = write.key;
+			values[count] = write.value;
+			count++;
+		}
+
+		result = _engine.putMany(keys, values, count);
+	}
+	else if (first.op == ASYNC_INSERT)
+	{
+		result = _engine.insert(first.key, first.value, first.ttlSeconds);
+		count = 1;
+	}
+	else
+	{
+		result = _engine.remove(first.key);
+		count = 1;
+	}
+
+	_unlock();
+
+	_print("Stored " + String(count) + " queued writes");
+
+	__atomic_store_n(&_doneTicket, _queue[(tail + count - 1) % ASYNC_QUEUE_SIZE].ticket, __ATOMIC_RELEASE);
+
+	// Slots are released only after the callbacks, as the caller may replace them right after
+	if (_callback != NULL)
+	{
+		for (int i = 0 ; i < count ; i++)
+		{
+			_callback(_queue[(tail + i) % ASYNC_QUEUE_SIZE].ticket, result);
+		}
+	}
+
+	__atomic_store_n(&_tail, tail + count, __ATOMIC_RELEASE);
+
+	return count;
+}
+
+
+
+
+void Async_Memory::_writerTask(void* instance)
+{
+	Async_Memory* db = (Async_Memory*)instance;
+
+	while (true)
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		uint32_t head = __atomic_load_n(&db->_head, __ATOMIC_ACQUIRE);
+
+		while (db->_tail != head)
+		{
+			db->_applyBatch(head);
+			head = __atomic_load_n(&db->_head, __ATOMIC_ACQUIRE);
+		}
+	}
+}
+
+
+
+
+// ****************** PUBLIC METHODS *************************
+
+bool Async_Memory::begin(WriteCallback callback)
+{
+	if (_writer != NULL)
+	{
+		return SUCCESS;
+	}
+
+	if (!_engine.begin())
+	{
+		return FAILURE;
+	}
+
+	_callback = callback;
+	_engineLock = xSemaphoreCreateMutex();
+
+	if (_engineLock == NULL)
+	{
+		_print("Lock creation failed");
+		return FAILURE;
+	}
+
+#if defined(CONFIG_FREERTOS_UNICORE) || (portNUM_PROCESSORS < 2)
+	// Single core chips (ESP32-S2, ESP32-C3), the task is not pinned
+	BaseType_t core = tskNO_AFFINITY;
+#else
+	// Writing on the core not used by the caller, so the caller is never blocked by the file system
+	BaseType_t core = (xPortGetCoreID() == 0) ? 1 : 0;
+#endif
+
+	if (xTaskCreatePinnedToCore(_writerTask, "ArduinoDb", ASYNC_TASK_STACK, this, ASYNC_TASK_PRIORITY, &_writer, core) != pdPASS)
+	{
+		_print("Writer task creation failed");
+		_writer = NULL;
+		return FAILURE;
+	}
+
+#ifdef DEBUG
+	_print("Writer task started on core " + String(core));
+#endif
+
+	return SUCCESS;
+}
+
+
+
+
+bool Async_Memory::flush(uint32_t timeoutMs)
+{
+	unsigned long start = millis();
+
+	while (__atomic_load_n(&_tail, __ATOMIC_ACQUIRE) != _head)
+	{
+		if ((millis() - start) >= timeoutMs)
+		{
+			return FAILURE;
+		}
+
+		delay(1);
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+bool Async_Memory::isDone(uint32_t ticket)
+{
+	uint32_t done = __atomic_load_n(&_doneTicket, __ATOMIC_ACQUIRE);
+
+	// Comparing the distance, so the tickets can wrap around
+	return (ticket != 0) && ((int32_t)(done - ticket) >= 0);
+}
+
+
+
+
+int Async_Memory::pending()
+{
+	return _head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+}
+
+
+
+
+bool Async_Memory::format()
+{
+	flush(UINT32_MAX);
+
+	_lock();
+	bool result = _engine.format();
+	_unlock();
+
+	return result;
+}
+
+
+
+
+bool Async_Memory::clear()
+{
+	flush(UINT32_MAX);
+
+	_lock();
+	bool result = _engine.clear();
+	_unlock();
+
+	return result;
+}
+
+
+
+
+int8_t Async_Memory::optimize()
+{
+	flush(UINT32_MAX);
+
+	_lock();
+	int8_t result = _engine.optimize();
+	_unlock();
+
+	return result;
+}
+
+
+
+
+String Async_Memory::get(const String& key, const String& defaultValue)
+{
+	const AsyncWrite* write = _pendingOf(key);
+
+	if (write != NULL)
+	{
+		if (write->op == ASYNC_REMOVE)
+		{
+			return defaultValue;
+		}
+
+		return write->value;
+	}
+
+	_lock();
+	String value = _engine.get(key, defaultValue);
+	_unlock();
+
+	return value;
+}
+
+
+
+
+String Async_Memory::getAll()
+{
+	flush(UINT32_MAX);
+
+	_lock();
+	String data = _engine.getAll();
+	_unlock();
+
+	return data;
+}
+
+
+
+
+uint32_t Async_Memory::insert(const String& key, const String& value)
+{
+	return _enqueue(ASYNC_INSERT, key, value, 0);
+}
+
+
+
+
+uint32_t Async_Memory::insert(const String& key, const String& value, uint32_t ttlSeconds)
+{
+	return _enqueue(ASYNC_INSERT, key, value, ttlSeconds);
+}
+
+
+
+
+uint32_t Async_Memory::remove(const String& key)
+{
+	return _enqueue(ASYNC_REMOVE, key, "", 0);
+}
+
+
+
+
+bool Async_Memory::exists(const String& key)
+{
+	const AsyncWrite* write = _pendingOf(key);
+
+	if (write != NULL)
+	{
+		return write->op == ASYNC_INSERT;
+	}
+
+	_lock();
+	bool result = _engine.exists(key);
+	_unlock();
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,235 @@
+/*
+    Async_Memory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using SPIFFS memory with asynchronous writes
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Async_Memory_h
+#define Async_Memory_h
+
+#if defined(ESP32)
+
+#include "Arduino.h"
+#include "Config.h"
+#include "SPIFFS_Memory.h"
+
+// Operations of the queued writes
+#define ASYNC_INSERT 0
+#define ASYNC_REMOVE 1
+
+/**
+ * Function called from the writer task once a queued write is stored
+ * @param ticket ticket returned when the write was queued
+ * @param result SUCCESS, FAILURE or MEM_FULL, as returned by the synchronous insert or remove
+ */
+typedef void (*WriteCallback)(uint32_t ticket, int8_t result);
+
+/**
+ * A write waiting in the queue, only the writer task applies it and only the caller task replaces it
+ */
+struct AsyncWrite
+{
+    uint8_t op;
+    uint32_t ticket;
+    uint32_t ttlSeconds;
+    String key;
+    String value;
+};
+
+/**
+ * SPIFFS database whose insert and remove return as soon as the write is queued. A writer task pinned
+ * to the other core stores the queued writes, batching consecutive inserts into a single putMany.
+ * Reads check the queued writes first, so a get always returns the last value inserted.
+ * Note- insert, remove and get must be called from a single task (normally the loop task)
+ */
+class Async_Memory
+{
+    private:
+        SPIFFS_Memory _engine;
+
+        // Single producer single consumer ring, _head is written only by the caller and _tail only by the writer
+        AsyncWrite _queue[ASYNC_QUEUE_SIZE];
+        volatile uint32_t _head;
+        volatile uint32_t _tail;
+
+        uint32_t _nextTicket;
+        volatile uint32_t _doneTicket;
+
+        WriteCallback _callback;
+        TaskHandle_t _writer;
+        SemaphoreHandle_t _engineLock;
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will take the lock of the SPIFFS engine, shared with the writer task
+         */
+        void _lock();
+
+        /**
+         * This will release the lock of the SPIFFS engine
+         */
+        void _unlock();
+
+        /**
+         * This will queue a write and wake the writer task
+         * @param op ASYNC_INSERT or ASYNC_REMOVE
+         * @param key unique key for the value
+         * @param value value associated with the key, not used for remove
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return ticket of the write
+         * @return 0 if the queue is full
+         */
+        uint32_t _enqueue(uint8_t op, const String& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This will find the last queued write of the key, which is not stored yet
+         * @param key key to search for
+         * @return the queued write
+         * @return NULL if no write of the key is queued
+         */
+        const AsyncWrite* _pendingOf(const String& key);
+
+        /**
+         * This will store the queued writes from the tail of the queue, up to ASYNC_BATCH_SIZE inserts at once
+         * @param head index up to which writes are stored
+         * @return number of writes stored
+         */
+        int _applyBatch(uint32_t head);
+
+        /**
+         * Body of the writer task, storing the queued writes whenever woken up
+         * @param instance the Async_Memory object
+         */
+        static void _writerTask(void* instance);
+
+    public:
+        /**
+         * Constructor for initializing class object, using the default file of SPIFFS memory
+         * @param null
+         * @return null
+         */
+        Async_Memory();
+
+        /**
+         * Constructor for initializing class object for using a separate namespace of SPIFFS memory
+         * @param name name of the namespace, data is stored in file /<name>.txt (max 26 characters)
+         * @return null
+         */
+        Async_Memory(const char* name);
+
+        /**
+         * This method will initialize SPIFFS memory and start the writer task on the other core
+         * Note- Must be called within setup only once
+         * @param callback function called after every queued write is stored, NULL for none
+         * @return FAILURE is initialization fails
+         * @return SUCCESS is initialization successful
+         */
+        bool begin(WriteCallback callback);
+
+        /**
+         * This method will wait until all the queued writes are stored
+         * @param timeoutMs maximum time to wait (in milliseconds), UINT32_MAX to wait until stored
+         * @return SUCCESS if the queue is empty
+         * @return FAILURE if the timeout expired first
+         */
+        bool flush(uint32_t timeoutMs);
+
+        /**
+         * This method will tell weather the write of the ticket is stored or not
+         * @param ticket ticket returned by insert or remove
+         * @return SUCCESS if the write is stored
+         * @return FAILURE if the write is still queued
+         */
+        bool isDone(uint32_t ticket);
+
+        /**
+         * This method will return the number of queued writes which are not stored yet
+         * @param null
+         * @return number of queued writes
+         */
+        int pending();
+
+        /**
+         * This method will format the file system, after storing the queued writes
+         * @return FAILURE is format fails
+         * @return SUCCESS is format successful
+         */
+        bool format();
+
+        /**
+         * This method will remove all the data of this database, after storing the queued writes
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
+        /**
+         * Call this method to optimize the database forcefully, after storing the queued writes
+         * @param null
+         * @return SUCCESS, if optimization task successful and space is available for new data
+         * @return FAILURE, if optimization failed or space for new data is not available
+         */
+        int8_t optimize();
+
+        /**
+         * This method will return the value associated with key, including the queued writes
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const String& key, const String& defaultValue);
+
+        /**
+         * This method will return all the stored key value pairs, after storing the queued writes
+         * @param null
+         * @return String of all key value pairs
+         */
+        String getAll();
+
+        /**
+         * This method will queue the insert of the data, returning without waiting for it to be stored
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return ticket of the write, passed to the callback once stored
+         * @return 0 if the queue is full
+         */
+        uint32_t insert(const String& key, const String& value);
+
+        /**
+         * This method will queue the insert of the data which expires after the given time,
+         * returning without waiting for it to be stored
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return ticket of the write, passed to the callback once stored
+         * @return 0 if the queue is full
+         */
+        uint32_t insert(const String& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will queue the removal of the key, returning without waiting for it to be stored
+         * @param key key to be removed
+         * @return ticket of the write, passed to the callback once stored
+         * @return 0 if the queue is full
+         */
+        uint32_t remove(const String& key);
+
+        /**
+         * This method will tell weather the key exists or not in the database, including the queued writes
+         * @param key key to search for
+         * @return SUCCESS if key found
+         * @return FAILURE is key not found
+         */
+        bool exists(const String& key);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,300 @@
+/*
+    Backup.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Backup.h"
+
+// Longest key or value accepted from a backup, longer lengths can only come from a corrupted backup
+#define BACKUP_MAX_LENGTH MAX_SPIFFS_SIZE
+
+// Constructors
+
+BackupWriter::BackupWriter(Print& out) : _out(out)
+{
+	_crc = 0;
+	_count = 0;
+	_failed = false;
+
+	uint8_t version = BACKUP_VERSION;
+
+	_write((const uint8_t*)BACKUP_MAGIC, 4);
+	_write(&version, 1);
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void BackupWriter::_write(const uint8_t* data, size_t length)
+{
+	if ((length > 0) && (_out.write(data, length) != length))
+	{
+		_failed = true;
+	}
+
+	_crc = dbCrc32(_crc, data, length);
+}
+
+
+
+
+void BackupWriter::_writeVarint(uint32_t value)
+{
+	uint8_t buffer[5];
+	uint8_t length = 0;
+
+	while (value >= 0x80)
+	{
+		buffer[length++] = (uint8_t)(value | 0x80);
+		value = value >> 7;
+	}
+
+	buffer[length++] = (uint8_t)value;
+
+	_write(buffer, length);
+}
+
+
+
+
+void BackupWriter::_writeUint32(uint32_t value)
+{
+	uint8_t buffer[4];
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+
+	_write(buffer, 4);
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+void BackupWriter::add(const String& key, const String& value, uint32_t expiry)
+{
+	_writeVarint(key.length());
+	_write((const uint8_t*)key.c_str(), key.length());
+	_writeUint32(expiry);
+	_writeVarint(value.length());
+	_write((const uint8_t*)value.c_str(), value.length());
+
+	_count++;
+}
+
+
+
+
+bool BackupWriter::finish()
+{
+	_writeVarint(0);
+	_writeUint32(_count);
+
+	// The CRC covers everything before it
+	uint32_t crc = _crc;
+	_writeUint32(crc);
+
+	return _failed ? FAILURE : SUCCESS;
+}
+
+
+
+
+int BackupWriter::count()
+{
+	return _count;
+}
+
+
+
+
+// Constructors
+
+BackupReader::BackupReader(Stream& in) : _in(in)
+{
+	_crc = 0;
+	_count = 0;
+	_ended = false;
+	_valid = false;
+
+	uint8_t header[5];
+
+	if (!_read(header, 5) || (memcmp(header, BACKUP_MAGIC, 4) != 0) || (header[4] != BACKUP_VERSION))
+	{
+		_ended = true;
+	}
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+bool BackupReader::_read(uint8_t* data, size_t length)
+{
+	if ((length > 0) && (_in.readBytes(data, length) != length))
+	{
+		return false;
+	}
+
+	_crc = dbCrc32(_crc, data, length);
+
+	return true;
+}
+
+
+
+
+bool BackupReader::_readVarint(uint32_t& value)
+{
+	uint8_t current;
+	value = 0;
+
+	for (int i = 0 ; i < 5 ; i++)
+	{
+		if (!_read(&current, 1))
+		{
+			return false;
+		}
+
+		value = value | ((uint32_t)(current & 0x7F) << (7 * i));
+
+		if (!(current & 0x80))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+bool BackupReader::_readUint32(uint32_t& value, bool addToCrc)
+{
+	uint8_t buffer[4];
+
+	if (addToCrc)
+	{
+		if (!_read(buffer, 4))
+		{
+			return false;
+		}
+	}
+	else if (_in.readBytes(buffer, 4) != 4)
+	{
+		return false;
+	}
+
+	value = 0;
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		value = value | ((uint32_t)buffer[i] << (8 * i));
+	}
+
+	return true;
+}
+
+
+
+
+bool BackupReader::_readString(String& output, uint32_t length)
+{
+	uint8_t buffer[32];
+
+	output = "";
+
+	if (length > BACKUP_MAX_LENGTH)
+	{
+		return false;
+	}
+
+	output.reserve(length);
+
+	while (length > 0)
+	{
+		uint32_t chunk = (length < sizeof(buffer)) ? length : sizeof(buffer);
+
+		if (!_read(buffer, chunk))
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0 ; i < chunk ; i++)
+		{
+			output += (char)buffer[i];
+		}
+
+		length = length - chunk;
+	}
+
+	return true;
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+bool BackupReader::next(String& key, String& value, uint32_t& expiry)
+{
+	if (_ended)
+	{
+		return false;
+	}
+
+	uint32_t length;
+
+	if (!_readVarint(length))
+	{
+		_ended = true;
+		return false;
+	}
+
+	if (length == 0)
+	{
+		// End of the records, checking the count and the CRC of everything before the CRC
+		uint32_t count;
+		uint32_t expected = 0;
+		uint32_t crc;
+
+		_ended = true;
+
+		if (_readUint32(count, true))
+		{
+			expected = _crc;
+			_valid = _readUint32(crc, false) && (count == _count) && (crc == expected);
+		}
+
+		return false;
+	}
+
+	if (!_readString(key, length) || !_readUint32(expiry, true) ||
+		!_readVarint(length) || !_readString(value, length))
+	{
+		_ended = true;
+		return false;
+	}
+
+	_count++;
+
+	return true;
+}
+
+
+
+
+bool BackupReader::isValid()
+{
+	return _valid ? SUCCESS : FAILURE;
+}
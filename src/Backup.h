@@ -0,0 +1,154 @@
+/*
+    Backup.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Backup_h
+#define Backup_h
+
+#include "Arduino.h"
+#include "Config.h"
+#include "DbUtils.h"
+
+// Binary backup of the live records, all numbers are little endian:
+//   header  "ADBK", version byte
+//   record  key length (varint, not 0), key, expiry time (4 bytes, 0 for never), value length (varint), value
+//   end     0 (varint), number of records (4 bytes), CRC-32 of all the bytes before the CRC (4 bytes)
+// Values are stored uncompressed, so a backup can be loaded into any database
+#define BACKUP_MAGIC "ADBK"
+#define BACKUP_VERSION 1
+
+/**
+ * Writes a backup to a Print (File, Serial, network client...) one record at a time
+ */
+class BackupWriter
+{
+    private:
+        Print& _out;
+        uint32_t _crc;
+        uint32_t _count;
+        bool _failed;
+
+        /**
+         * This will write bytes, adding them to the CRC
+         * @param data bytes to write
+         * @param length number of bytes to write
+         */
+        void _write(const uint8_t* data, size_t length);
+
+        /**
+         * This will write a number as a varint
+         * @param value number to write
+         */
+        void _writeVarint(uint32_t value);
+
+        /**
+         * This will write a number as 4 bytes
+         * @param value number to write
+         */
+        void _writeUint32(uint32_t value);
+
+    public:
+        /**
+         * Constructor for writing a backup, writes the header
+         * @param out where the backup is written
+         */
+        BackupWriter(Print& out);
+
+        /**
+         * This will write a record
+         * @param key key of the record
+         * @param value value of the record, uncompressed
+         * @param expiry expiry time of the record (in seconds), 0 for never
+         */
+        void add(const String& key, const String& value, uint32_t expiry);
+
+        /**
+         * This will write the end of the backup, nothing must be added after that
+         * @param null
+         * @return SUCCESS if all the bytes were written
+         * @return FAILURE otherwise
+         */
+        bool finish();
+
+        /**
+         * This will return the number of records written
+         * @param null
+         * @return number of records
+         */
+        int count();
+};
+
+/**
+ * Reads a backup from a Stream one record at a time, the records must not be used until
+ * the end is read and isValid tells that the backup is complete and not corrupted
+ */
+class BackupReader
+{
+    private:
+        Stream& _in;
+        uint32_t _crc;
+        uint32_t _count;
+        bool _ended;
+        bool _valid;
+
+        /**
+         * This will read bytes, adding them to the CRC
+         * @param data buffer to hold the bytes
+         * @param length number of bytes to read
+         * @return true if all the bytes were read
+         */
+        bool _read(uint8_t* data, size_t length);
+
+        /**
+         * This will read a varint
+         * @param value to hold the number
+         * @return true if read
+         */
+        bool _readVarint(uint32_t& value);
+
+        /**
+         * This will read a number stored as 4 bytes
+         * @param value to hold the number
+         * @param addToCrc set to false for the CRC itself
+         * @return true if read
+         */
+        bool _readUint32(uint32_t& value, bool addToCrc);
+
+        /**
+         * This will read a String of the given length
+         * @param output String to hold the bytes
+         * @param length number of bytes to read
+         * @return true if read
+         */
+        bool _readString(String& output, uint32_t length);
+
+    public:
+        /**
+         * Constructor for reading a backup, reads and checks the header
+         * @param in where the backup is read from
+         */
+        BackupReader(Stream& in);
+
+        /**
+         * This will read the next record
+         * @param key to hold the key of the record
+         * @param value to hold the value of the record
+         * @param expiry to hold the expiry time of the record (in seconds), 0 for never
+         * @return true if a record was read
+         * @return false at the end of the backup or if it can not be read
+         */
+        bool next(String& key, String& value, uint32_t& expiry);
+
+        /**
+         * This will tell weather the whole backup was read and its record count and CRC match
+         * @param null
+         * @return SUCCESS if the backup is valid
+         * @return FAILURE otherwise
+         */
+        bool isValid();
+};
+
+#endif
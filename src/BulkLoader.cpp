@@ -0,0 +1,361 @@
+/*
+    BulkLoader.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "BulkLoader.h"
+
+#define BULK_MERGE_FILE "/bulk.tmp"
+
+// Constructors
+
+BulkLoader::BulkLoader()
+{
+	_count = 0;
+	_bytes = 0;
+	_runs = 0;
+	_bufferPos = 0;
+	_failed = false;
+
+	for (int i = 0 ; i < BULK_MAX_RUNS ; i++)
+	{
+		_readers[i] = NULL;
+		_hasHead[i] = false;
+	}
+}
+
+
+
+
+BulkLoader::~BulkLoader()
+{
+	clear();
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void BulkLoader::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[Bulk]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+String BulkLoader::_runName(int run)
+{
+	return String("/bulk") + String(run) + ".run";
+}
+
+
+
+
+bool BulkLoader::_spill()
+{
+	if (_runs == BULK_MAX_RUNS)
+	{
+		// Too many runs to merge at once, merging all of them and the buffer into a single run
+		_print("Merging " + String(_runs) + " runs");
+
+		if (!rewind())
+		{
+			return FAILURE;
+		}
+
+		File merged = SPIFFS.open(BULK_MERGE_FILE, "w");
+
+		if (!merged)
+		{
+			_closeRuns();
+			return FAILURE;
+		}
+
+		BackupWriter writer(merged);
+		String key;
+		String value;
+
+		while (next(key, value))
+		{
+			writer.add(key, value, 0);
+		}
+
+		bool written = writer.finish() && !_failed;
+
+		merged.close();
+		_closeRuns();
+
+		for (int i = 0 ; i < _runs ; i++)
+		{
+			SPIFFS.remove(_runName(i));
+		}
+
+		_runs = 0;
+
+		if (!written || !SPIFFS.rename(BULK_MERGE_FILE, _runName(0)))
+		{
+			SPIFFS.remove(BULK_MERGE_FILE);
+			return FAILURE;
+		}
+
+		_runs = 1;
+	}
+	else
+	{
+		_print("Spilling " + String(_count) + " pairs to run " + String(_runs));
+
+		File run = SPIFFS.open(_runName(_runs), "w");
+
+		if (!run)
+		{
+			return FAILURE;
+		}
+
+		// The buffer is already sorted, the run is written as it is
+		BackupWriter writer(run);
+
+		for (int i = 0 ; i < _count ; i++)
+		{
+			writer.add(_keys[i], _values[i], 0);
+		}
+
+		bool written = writer.finish();
+		run.close();
+
+		if (!written)
+		{
+			SPIFFS.remove(_runName(_runs));
+			return FAILURE;
+		}
+
+		_runs++;
+	}
+
+	for (int i = 0 ; i < _count ; i++)
+	{
+		_keys[i] = "";
+		_values[i] = "";
+	}
+
+	_count = 0;
+	_bytes = 0;
+
+	return SUCCESS;
+}
+
+
+
+
+void BulkLoader::_closeRuns()
+{
+	for (int i = 0 ; i < BULK_MAX_RUNS ; i++)
+	{
+		delete _readers[i];
+		_readers[i] = NULL;
+		_hasHead[i] = false;
+		_files[i].close();
+	}
+}
+
+
+
+
+const String* BulkLoader::_peek(int source)
+{
+	if (source == _runs)
+	{
+		return (_bufferPos < _count) ? &_keys[_bufferPos] : NULL;
+	}
+
+	return _hasHead[source] ? &_headKeys[source] : NULL;
+}
+
+
+
+
+void BulkLoader::_advance(int source)
+{
+	if (source == _runs)
+	{
+		_bufferPos++;
+		return;
+	}
+
+	uint32_t expiry;
+	_hasHead[source] = _readers[source]->next(_headKeys[source], _headValues[source], expiry);
+
+	if (!_hasHead[source] && !_readers[source]->isValid())
+	{
+		_print("Run " + String(source) + " corrupted");
+		_failed = true;
+	}
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+bool BulkLoader::add(const String& key, const String& value)
+{
+	// Binary search for the position of the key in the buffer
+	int low = 0;
+	int high = _count;
+
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+
+		if (_keys[mid].compareTo(key) < 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if ((low < _count) && _keys[low].equals(key))
+	{
+		_bytes = _bytes - _values[low].length() + value.length();
+		_values[low] = value;
+		return SUCCESS;
+	}
+
+	if ((_count > 0) && ((_count == BULK_BUFFER_PAIRS) || ((_bytes + key.length() + value.length()) > BULK_BUFFER_SIZE)))
+	{
+		if (!_spill())
+		{
+			_print("Spill failed");
+			_failed = true;
+			return FAILURE;
+		}
+
+		low = 0;
+	}
+
+	// Shifting the greater keys to keep the buffer sorted
+	for (int i = _count ; i > low ; i--)
+	{
+		_keys[i] = _keys[i - 1];
+		_values[i] = _values[i - 1];
+	}
+
+	_keys[low] = key;
+	_values[low] = value;
+	_count++;
+	_bytes = _bytes + key.length() + value.length();
+
+	return SUCCESS;
+}
+
+
+
+
+bool BulkLoader::rewind()
+{
+	_closeRuns();
+	_bufferPos = 0;
+
+	for (int i = 0 ; i < _runs ; i++)
+	{
+		_files[i] = SPIFFS.open(_runName(i), "r");
+
+		if (!_files[i])
+		{
+			_print("Run " + String(i) + " not found");
+			_closeRuns();
+			_failed = true;
+			return FAILURE;
+		}
+
+		_readers[i] = new BackupReader(_files[i]);
+		_advance(i);
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+bool BulkLoader::next(String& key, String& value)
+{
+	int best = -1;
+	const String* bestKey = NULL;
+
+	// Sources are ordered oldest first, so the newest value of a repeated key wins
+	for (int i = 0 ; i <= _runs ; i++)
+	{
+		const String* current = _peek(i);
+
+		if ((current != NULL) && ((bestKey == NULL) || (current->compareTo(*bestKey) <= 0)))
+		{
+			best = i;
+			bestKey = current;
+		}
+	}
+
+	if (best == -1)
+	{
+		return false;
+	}
+
+	key = *bestKey;
+	value = (best == _runs) ? _values[_bufferPos] : _headValues[best];
+
+	// Skipping the older values of the key
+	for (int i = 0 ; i <= _runs ; i++)
+	{
+		const String* current = _peek(i);
+
+		if ((current != NULL) && current->equals(key))
+		{
+			_advance(i);
+		}
+	}
+
+	return true;
+}
+
+
+
+
+bool BulkLoader::isValid()
+{
+	return _failed ? FAILURE : SUCCESS;
+}
+
+
+
+
+void BulkLoader::clear()
+{
+	_closeRuns();
+
+	for (int i = 0 ; i < _runs ; i++)
+	{
+		SPIFFS.remove(_runName(i));
+	}
+
+	for (int i = 0 ; i < _count ; i++)
+	{
+		_keys[i] = "";
+		_values[i] = "";
+	}
+
+	_runs = 0;
+	_count = 0;
+	_bytes = 0;
+	_bufferPos = 0;
+	_failed = false;
+}
@@ -0,0 +1,141 @@
+/*
+    BulkLoader.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef BulkLoader_h
+#define BulkLoader_h
+
+#include "Arduino.h"
+#include <FS.h>
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+#include "Config.h"
+#include "Backup.h"
+
+/**
+ * Collects key value pairs for loading a whole database at once. Pairs are kept sorted and without
+ * repeated keys in a buffer of BULK_BUFFER_PAIRS pairs, a full buffer is spilled to a sorted run in
+ * file /bulk<n>.run of SPIFFS memory. The database then reads all the pairs in sorted order, merging
+ * the runs and the buffer, and writes its records and key directory in a single pass.
+ * Note- Only one loader may have spilled runs at a time, as the run files are shared
+ */
+class BulkLoader
+{
+    private:
+        // Sorted buffer of the latest pairs
+        String _keys[BULK_BUFFER_PAIRS];
+        String _values[BULK_BUFFER_PAIRS];
+        int _count;
+        int _bytes;
+
+        // Sorted runs spilled to SPIFFS, oldest first, and the next pair of each while merging
+        int _runs;
+        File _files[BULK_MAX_RUNS];
+        BackupReader* _readers[BULK_MAX_RUNS];
+        String _headKeys[BULK_MAX_RUNS];
+        String _headValues[BULK_MAX_RUNS];
+        bool _hasHead[BULK_MAX_RUNS];
+        int _bufferPos;
+
+        bool _failed;
+
+        BulkLoader(const BulkLoader&);
+        BulkLoader& operator=(const BulkLoader&);
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will return the name of the file of a run
+         * @param run index of the run
+         * @return name of the file
+         */
+        String _runName(int run);
+
+        /**
+         * This will write the buffer to a new run, merging all the runs into one if BULK_MAX_RUNS are spilled
+         * @param null
+         * @return SUCCESS if written
+         * @return FAILURE otherwise
+         */
+        bool _spill();
+
+        /**
+         * This will close the runs opened for merging
+         * @param null
+         */
+        void _closeRuns();
+
+        /**
+         * This will return the next key of a source of the merge
+         * @param source index of the run, or _runs for the buffer
+         * @return next key, NULL if the source has no more pairs
+         */
+        const String* _peek(int source);
+
+        /**
+         * This will move a source of the merge to its next pair
+         * @param source index of the run, or _runs for the buffer
+         */
+        void _advance(int source);
+
+    public:
+        /**
+         * Constructor for initializing an empty loader
+         * @param null
+         * @return null
+         */
+        BulkLoader();
+
+        ~BulkLoader();
+
+        /**
+         * This will add a pair, for repeated keys the last value is kept. Requires SPIFFS memory to be
+         * initialized if more than BULK_BUFFER_PAIRS keys are added
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return SUCCESS if added
+         * @return FAILURE if the buffer could not be spilled to SPIFFS memory
+         */
+        bool add(const String& key, const String& value);
+
+        /**
+         * This will start reading the pairs in sorted order of keys, called by the database before next
+         * @param null
+         * @return SUCCESS if the runs could be opened
+         * @return FAILURE otherwise
+         */
+        bool rewind();
+
+        /**
+         * This will read the next pair in sorted order of keys
+         * @param key to hold the key
+         * @param value to hold the value
+         * @return true if a pair was read
+         * @return false if no more pairs are available
+         */
+        bool next(String& key, String& value);
+
+        /**
+         * This will tell weather all the pairs were stored and read without errors
+         * @param null
+         * @return SUCCESS if no error occurred
+         * @return FAILURE otherwise
+         */
+        bool isValid();
+
+        /**
+         * This will remove all the pairs and the files of the runs
+         * @param null
+         */
+        void clear();
+};
+
+#endif
@@ -0,0 +1,333 @@
+/*
+    Compression.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Config.h"
+#include "Compression.h"
+
+// Compressed bytes that can not be stored are written as ESCAPE_CHAR followed by byte ^ ESCAPE_MASK
+#define ESCAPE_CHAR 0x10
+#define ESCAPE_MASK 0x40
+
+#define HASH_SIZE 1024
+#define MAX_OFFSET 8192
+#define MAX_LITERALS 32
+#define MAX_MATCH 264
+
+// Decoder states
+#define STATE_CONTROL 0
+#define STATE_LITERAL 1
+#define STATE_LENGTH 2
+#define STATE_OFFSET 3
+
+// Hash table of the compressor, shared by all the calls instead of allocating 2 KB for every value
+static uint16_t _table[HASH_SIZE];
+
+#if defined(THREAD_SAFE)
+// Each database compresses under its own lock, the shared table needs one more
+static SemaphoreHandle_t _tableLock = xSemaphoreCreateMutex();
+#endif
+
+/**
+ * This will append a compressed byte to the output, escaping the bytes that can not be stored
+ */
+static void _emit(String& output, uint8_t value)
+{
+	if ((value == '\n') || (value == '\0') || (value == ESCAPE_CHAR))
+	{
+		output += (char)ESCAPE_CHAR;
+		output += (char)(value ^ ESCAPE_MASK);
+	}
+	else
+	{
+		output += (char)value;
+	}
+}
+
+
+
+
+/**
+ * This will append the pending literal bytes to the output
+ */
+static void _emitLiterals(String& output, const uint8_t* literals, int& count)
+{
+	if (count > 0)
+	{
+		_emit(output, count - 1);
+
+		for (int i = 0 ; i < count ; i++)
+		{
+			_emit(output, literals[i]);
+		}
+
+		count = 0;
+	}
+}
+
+
+
+
+String dbCompress(const String& value)
+{
+	const uint8_t* input = (const uint8_t*)value.c_str();
+	int length = value.length();
+
+	// Positions are stored in 16 bits
+	if (length >= 0xFFFF)
+	{
+		return value;
+	}
+
+#if defined(THREAD_SAFE)
+	xSemaphoreTake(_tableLock, portMAX_DELAY);
+#endif
+
+	for (int i = 0 ; i < HASH_SIZE ; i++)
+	{
+		_table[i] = 0xFFFF;
+	}
+
+	String output = "";
+	output.reserve(length);
+
+	uint8_t literals[MAX_LITERALS];
+	int literalCount = 0;
+	int i = 0;
+
+	while (i < length)
+	{
+		if ((i + 2) < length)
+		{
+			uint16_t hash = ((input[i] << 6) ^ (input[i + 1] << 3) ^ input[i + 2]) & (HASH_SIZE - 1);
+			uint16_t ref = _table[hash];
+			_table[hash] = i;
+
+			if ((ref != 0xFFFF) && ((i - ref) <= MAX_OFFSET) && (input[ref] == input[i]) && (input[ref + 1] == input[i + 1]) && (input[ref + 2] == input[i + 2]))
+			{
+				int maxMatch = ((length - i) < MAX_MATCH) ? (length - i) : MAX_MATCH;
+				int match = 3;
+
+				while ((match < maxMatch) && (input[ref + match] == input[i + match]))
+				{
+					match++;
+				}
+
+				_emitLiterals(output, literals, literalCount);
+
+				// Back reference, length and offset are stored minus 2 and 1
+				int len = match - 2;
+				int offset = i - ref - 1;
+
+				if (len < 7)
+				{
+					_emit(output, (len << 5) | (offset >> 8));
+				}
+				else
+				{
+					_emit(output, (7 << 5) | (offset >> 8));
+					_emit(output, len - 7);
+				}
+
+				_emit(output, offset & 0xFF);
+
+				i += match;
+				continue;
+			}
+		}
+
+		literals[literalCount++] = input[i++];
+
+		if (literalCount == MAX_LITERALS)
+		{
+			_emitLiterals(output, literals, literalCount);
+		}
+	}
+
+	_emitLiterals(output, literals, literalCount);
+
+#if defined(THREAD_SAFE)
+	xSemaphoreGive(_tableLock);
+#endif
+
+	return output;
+}
+
+
+
+
+String dbDecompress(const String& packed)
+{
+	String value = "";
+	ValueDecoder decoder(&value, true);
+
+	for (unsigned int i = 0 ; i < packed.length() ; i++)
+	{
+		decoder.feed(packed[i]);
+	}
+
+	return value;
+}
+
+
+
+
+/**
+ * Constructor of the decoder for a caller buffer
+ */
+ValueDecoder::ValueDecoder(char* buffer, size_t capacity, bool compressed)
+{
+	_buffer = buffer;
+	_capacity = capacity;
+	_string = NULL;
+	_length = 0;
+	_compressed = compressed;
+	_escaped = false;
+	_state = STATE_CONTROL;
+	_count = 0;
+	_offsetHigh = 0;
+}
+
+
+
+
+/**
+ * Constructor of the decoder for a String
+ */
+ValueDecoder::ValueDecoder(String* output, bool compressed)
+{
+	_buffer = NULL;
+	_capacity = 0;
+	_string = output;
+	_length = 0;
+	_compressed = compressed;
+	_escaped = false;
+	_state = STATE_CONTROL;
+	_count = 0;
+	_offsetHigh = 0;
+}
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void ValueDecoder::_put(char value)
+{
+	if (_string != NULL)
+	{
+		*_string += value;
+		_length++;
+	}
+	else if (_length < _capacity)
+	{
+		_buffer[_length] = value;
+		_length++;
+	}
+}
+
+
+
+
+char ValueDecoder::_at(size_t pos)
+{
+	if (_string != NULL)
+	{
+		return (*_string)[pos];
+	}
+
+	return _buffer[pos];
+}
+
+// ************************************************************
+
+
+
+// ****************** PUBLIC METHODS **************************
+void ValueDecoder::feed(char value)
+{
+	if (!_compressed)
+	{
+		_put(value);
+		return;
+	}
+
+	uint8_t current = (uint8_t)value;
+
+	if (_escaped)
+	{
+		current = current ^ ESCAPE_MASK;
+		_escaped = false;
+	}
+	else if (current == ESCAPE_CHAR)
+	{
+		_escaped = true;
+		return;
+	}
+
+	if (_state == STATE_CONTROL)
+	{
+		if (current < MAX_LITERALS)
+		{
+			_count = current + 1;
+			_state = STATE_LITERAL;
+		}
+		else
+		{
+			_count = current >> 5;
+			_offsetHigh = current & 0x1F;
+			_state = (_count == 7) ? STATE_LENGTH : STATE_OFFSET;
+		}
+	}
+	else if (_state == STATE_LITERAL)
+	{
+		_put((char)current);
+		_count--;
+
+		if (_count == 0)
+		{
+			_state = STATE_CONTROL;
+		}
+	}
+	else if (_state == STATE_LENGTH)
+	{
+		_count += current;
+		_state = STATE_OFFSET;
+	}
+	else
+	{
+		size_t offset = ((size_t)_offsetHigh << 8) + current + 1;
+
+		// Copying the referenced bytes, they may overlap the bytes being written
+		if (offset <= _length)
+		{
+			for (uint16_t i = 0 ; (i < (_count + 2)) && !isFull() ; i++)
+			{
+				_put(_at(_length - offset));
+			}
+		}
+
+		_state = STATE_CONTROL;
+	}
+}
+
+
+
+
+size_t ValueDecoder::length()
+{
+	return _length;
+}
+
+
+
+
+bool ValueDecoder::isFull()
+{
+	return (_string == NULL) && (_length >= _capacity);
+}
+
+// ************************************************************
@@ -0,0 +1,96 @@
+/*
+    Compression.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Compression_h
+#define Compression_h
+
+#include "Arduino.h"
+
+/**
+ * This will compress the value using LZF style compression. The output never contains
+ * new line or null characters, so it can be stored as the value of a record
+ * @param value value to compress
+ * @return compressed value, may be longer than value for values that do not compress
+ */
+String dbCompress(const String& value);
+
+/**
+ * This will decompress a value compressed using dbCompress
+ * @param packed compressed value
+ * @return original value
+ */
+String dbDecompress(const String& packed);
+
+/**
+ * Streaming decoder of stored values, fed one stored byte at a time.
+ * Writes the original value either to a caller buffer or to a String
+ */
+class ValueDecoder
+{
+    private:
+        char* _buffer;
+        size_t _capacity;
+        String* _string;
+        size_t _length;
+        bool _compressed;
+
+        bool _escaped;
+        uint8_t _state;
+        uint16_t _count;
+        uint8_t _offsetHigh;
+
+        /**
+         * This will append a byte to the output
+         * @param value byte to append
+         */
+        void _put(char value);
+
+        /**
+         * This will return a byte already written to the output
+         * @param pos position of the byte
+         * @return byte at the position
+         */
+        char _at(size_t pos);
+
+    public:
+        /**
+         * Constructor for decoding into a caller buffer
+         * @param buffer buffer to write the value to
+         * @param capacity number of bytes available in buffer, longer values are truncated
+         * @param compressed set to true if the stored value is compressed
+         */
+        ValueDecoder(char* buffer, size_t capacity, bool compressed);
+
+        /**
+         * Constructor for decoding into a String
+         * @param output String to append the value to
+         * @param compressed set to true if the stored value is compressed
+         */
+        ValueDecoder(String* output, bool compressed);
+
+        /**
+         * This will decode the next stored byte
+         * @param value stored byte
+         */
+        void feed(char value);
+
+        /**
+         * This will return the number of bytes of the value written so far
+         * @param null
+         * @return number of bytes written
+         */
+        size_t length();
+
+        /**
+         * This will tell weather the caller buffer is full
+         * @param null
+         * @return true if no more bytes can be written
+         */
+        bool isFull();
+};
+
+#endif
@@ -11,11 +11,76 @@
 // For viewing library logs
 // #define DEBUG
 
+// For using a database object from multiple FreeRTOS tasks (ESP32 only)
+// #define THREAD_SAFE
+
+// For an EEPROM database which takes no memory from the heap after begin (see DbArena.h)
+// #define DB_STATIC_ARENA
+
+// For host builds scanning a word at a time like the boards, instead of using SSE2 or AVX2 (see ScanKernel.h)
+// #define DB_SCAN_SWAR
+
 #define SUCCESS 1
 #define FAILURE 0
 #define MEM_FULL 2
 
 #define MAX_EEPROM_SIZE 4096
-#define MAX_SPIFFS_SIZE 10240
+#define MAX_SPIFFS_SIZE 10240       // largest Segment_Memory database with the copy written by its merge, and longest key or value read from a backup
+
+// SPIFFS capacity, a file grows up to the free space of the file system left by the other files
+#define SPIFFS_RESERVE_PERCENT 20   // part of the file system kept free for the garbage collection of SPIFFS
+#define SPIFFS_PAGE_SIZE 256        // page size used if the file system does not report it (ESP32)
+
+// Tiered storage, small and frequently read keys are kept in EEPROM and the rest in SPIFFS
+#define TIER_HOT_MAX_VALUE 32       // longer values are always stored in SPIFFS
+#define TIER_PROMOTE_HITS 3         // reads of a SPIFFS key after which it is moved to EEPROM
+#define TIER_TRACKED_KEYS 16        // number of keys whose reads are counted
+#define TIER_AGING_INTERVAL 64      // reads after which all the counts are halved
+#define TIER_COLD_FILTER_BYTES 64   // size of the filter of SPIFFS keys, lookups of keys not in it skip SPIFFS
+
+// Asynchronous SPIFFS writes (ESP32 only), see Async_Memory.h
+#define ASYNC_QUEUE_SIZE 16         // writes waiting for the writer task, must be a power of 2
+#define ASYNC_BATCH_SIZE 8          // inserts written together with a single putMany
+#define ASYNC_TASK_STACK 8192       // stack of the writer task (in bytes)
+#define ASYNC_TASK_PRIORITY 1       // priority of the writer task, same as the loop task
+
+// Time series ring buffer, see TimeSeries_Memory.h
+#define TS_MAX_VALUE 64             // longest reading (in bytes), at most 248
+
+// Raw flash partition (ESP32 only), see Partition_Memory.h
+#define PARTITION_WRITE_CHUNK 64    // bytes copied to RAM at a time while writing the partition
+
+// Sorted segment files, see Segment_Memory.h
+#define SEGMENT_LOG_SIZE 1024       // bytes of new records after which the log is merged into the segment
+#define SEGMENT_BLOCK_RECORDS 16    // records per block of the segment, a lookup reads a single block
+
+// Bulk loading, see BulkLoader.h
+#define BULK_BUFFER_PAIRS 32        // pairs sorted in RAM before they are spilled to SPIFFS
+#define BULK_BUFFER_SIZE 2048       // bytes of keys and values sorted in RAM before they are spilled
+#define BULK_MAX_RUNS 8             // sorted runs in SPIFFS, more are merged into one
+
+// Keys, see DbKey.h
+#define DB_KEY_INLINE_SIZE 23       // keys built from a String up to this length (in bytes) are copied into the key
+
+// Snapshots, see Snapshot.h
+#define SNAPSHOT_MAX_VERSIONS 2     // versions of the SPIFFS file kept for snapshots at the same time, at most 10
+
+// Transactions, see ArduinoDb::beginTransaction
+#define TRANSACTION_MAX_KEYS 16     // changes staged by a single transaction
+
+// Compaction policy used by ArduinoDb::maintain until setCompactionPolicy is called
+#define COMPACT_DEAD_PERCENT 30     // percent of the used bytes held by removed and expired records
+#define COMPACT_MIN_DEAD_BYTES 256  // smallest number of bytes worth a compaction
+#define COMPACT_FREE_PERCENT 10     // percent of the capacity below which free space counts as low
+#define COMPACT_IDLE_MS 2000        // time without writes after which the database counts as idle
+
+// Secondary index on values, see ArduinoDb::indexValues
+#define VALUE_INDEX_MAX_PREFIXES 4  // key prefixes whose values can be indexed by a single database
+
+// Static arena, if DB_STATIC_ARENA is defined
+#define DB_ARENA_SIZE 8192          // scratch memory for inserts and compaction (in bytes), about twice the EEPROM size used
+
+// Shared/exclusive lock of a database object, if THREAD_SAFE is defined
+#define THREAD_SAFE_READERS 8       // tasks reading at the same time, more readers wait for one to finish
 
 #endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+    DbArena.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "DbArena.h"
+
+#if defined(DB_STATIC_ARENA)
+
+// Every allocation starts at a multiple of the word size
+#define ARENA_ALIGN sizeof(void*)
+
+static char _arena[DB_ARENA_SIZE] __attribute__((aligned(8)));
+static size_t _used = 0;
+static size_t _peak = 0;
+
+
+
+
+void* dbArenaAlloc(size_t size)
+{
+	size_t start = (_used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if ((start > DB_ARENA_SIZE) || (size > (DB_ARENA_SIZE - start)))
+	{
+		return NULL;
+	}
+
+	_used = start + size;
+
+	if (_used > _peak)
+	{
+		_peak = _used;
+	}
+
+	return _arena + start;
+}
+
+
+
+
+size_t dbArenaMark()
+{
+	return _used;
+}
+
+
+
+
+void dbArenaRelease(size_t mark)
+{
+	if (mark < _used)
+	{
+		_used = mark;
+	}
+}
+
+
+
+
+size_t dbArenaPeak()
+{
+	return _peak;
+}
+
+
+
+
+DbArenaScope::DbArenaScope()
+{
+	_mark = dbArenaMark();
+}
+
+
+
+
+DbArenaScope::~DbArenaScope()
+{
+	dbArenaRelease(_mark);
+}
+
+#endif
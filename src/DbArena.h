@@ -0,0 +1,73 @@
+/*
+    DbArena.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef DbArena_h
+#define DbArena_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+#if defined(DB_STATIC_ARENA) && defined(THREAD_SAFE)
+#error "DB_STATIC_ARENA uses a single arena for all the databases, it can not be used with THREAD_SAFE"
+#endif
+
+#if defined(DB_STATIC_ARENA)
+
+/*
+ * Scratch memory taken from a static buffer of DB_ARENA_SIZE bytes instead of the heap, used by the
+ * EEPROM database if DB_STATIC_ARENA is defined. Memory is handed out in order and given back all at once
+ * by going back to an earlier mark, so nothing is fragmented however long the device runs
+ */
+
+/**
+ * This will take memory from the arena
+ * @param size number of bytes required
+ * @return pointer to the memory, aligned for any type
+ * @return NULL if the arena does not have size bytes left
+ */
+void* dbArenaAlloc(size_t size);
+
+/**
+ * This will return the current end of the used part of the arena
+ * @param null
+ * @return mark to pass to dbArenaRelease
+ */
+size_t dbArenaMark();
+
+/**
+ * This will give back all the memory taken since the mark
+ * @param mark mark returned by dbArenaMark
+ */
+void dbArenaRelease(size_t mark);
+
+/**
+ * This will return the most bytes of the arena used at the same time, for sizing DB_ARENA_SIZE
+ * @param null
+ * @return peak usage (in bytes)
+ */
+size_t dbArenaPeak();
+
+/**
+ * Gives back the memory taken from the arena during its lifetime when it goes out of scope
+ */
+class DbArenaScope
+{
+    private:
+        size_t _mark;
+
+        DbArenaScope(const DbArenaScope&);
+        DbArenaScope& operator=(const DbArenaScope&);
+
+    public:
+        DbArenaScope();
+
+        ~DbArenaScope();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+/*
+    DbKey.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef DbKey_h
+#define DbKey_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+/**
+ * Compile time length of a null terminated key
+ */
+constexpr uint16_t dbKeyLength(const char* key, uint16_t length = 0)
+{
+    return (key[length] == '\0') ? length : dbKeyLength(key, length + 1);
+}
+
+/**
+ * Compile time FNV-1a hash of a null terminated key, same as dbHash
+ */
+constexpr uint32_t dbKeyHash(const char* key, uint32_t hash = 2166136261UL)
+{
+    return (*key == '\0') ? hash : dbKeyHash(key + 1, (uint32_t)((hash ^ (uint8_t)*key) * 16777619UL));
+}
+
+/**
+ * Key passed to the database, along with its length and hash. Keys built from a literal or a
+ * char pointer refer to its bytes, for literals the length and hash are found at compile time:
+ *     constexpr DbKey KEY_MODE("mode");
+ * Keys built from a String of up to DB_KEY_INLINE_SIZE bytes are copied into the key itself, longer
+ * ones refer to the bytes of the String. A key referring to other bytes is valid only while they are,
+ * which is always true for keys built in the call (db.get("mode", "") or db.get(name, ""))
+ */
+class DbKey
+{
+    private:
+        const char* _external;                  // bytes of the key, NULL if stored inline
+        char _inline[DB_KEY_INLINE_SIZE + 1];
+        uint16_t _length;
+        uint32_t _hash;
+
+    public:
+        /**
+         * Constructor for a key held by a null terminated string, computed at compile time for literals
+         * @param key bytes of the key, NULL for an empty key
+         * @return null
+         */
+        constexpr DbKey(const char* key)
+            : _external((key == NULL) ? "" : key), _inline(), _length(dbKeyLength((key == NULL) ? "" : key)),
+              _hash(dbKeyHash((key == NULL) ? "" : key))
+        {
+        }
+
+        /**
+         * Constructor for a key held by a String
+         * @param key the key, copied if short enough
+         * @return null
+         */
+        DbKey(const String& key)
+            : _external(NULL), _inline(), _length(key.length()), _hash(2166136261UL)
+        {
+            const char* data = key.c_str();
+
+            if (_length <= DB_KEY_INLINE_SIZE)
+            {
+                memcpy(_inline, data, _length);
+            }
+            else
+            {
+                _external = data;
+            }
+
+            for (uint16_t i = 0 ; i < _length ; i++)
+            {
+                _hash = (_hash ^ (uint8_t)data[i]) * 16777619UL;
+            }
+        }
+
+        /**
+         * This will return the bytes of the key
+         * @param null
+         * @return null terminated bytes of the key
+         */
+        constexpr const char* c_str() const
+        {
+            return (_external != NULL) ? _external : _inline;
+        }
+
+        /**
+         * This will return the number of bytes of the key
+         * @param null
+         * @return length of the key
+         */
+        constexpr uint16_t length() const
+        {
+            return _length;
+        }
+
+        /**
+         * This will return the FNV-1a hash of the key, as returned by dbHash
+         * @param null
+         * @return 32 bit hash of the key
+         */
+        constexpr uint32_t hash() const
+        {
+            return _hash;
+        }
+
+        /**
+         * This will compare the key with the given bytes, the lengths are compared first
+         * @param data bytes to compare with
+         * @param length number of bytes
+         * @return true if equal
+         */
+        bool equals(const char* data, int length) const
+        {
+            return (length == _length) && (memcmp(data, c_str(), length) == 0);
+        }
+
+        /**
+         * This will compare the key with a String
+         * @param other String to compare with
+         * @return true if equal
+         */
+        bool equals(const String& other) const
+        {
+            return equals(other.c_str(), other.length());
+        }
+
+        /**
+         * This will compare two keys, keys with different hashes or lengths are told apart without comparing bytes
+         * @param other key to compare with
+         * @return true if equal
+         */
+        bool equals(const DbKey& other) const
+        {
+            return (other._hash == _hash) && equals(other.c_str(), other._length);
+        }
+};
+
+#endif
@@ -0,0 +1,333 @@
+/*
+    DbLock.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "DbLock.h"
+
+// Constructors
+
+DbLock::DbLock()
+{
+#if defined(THREAD_SAFE)
+	_gate = NULL;
+	_slots = NULL;
+	_statsLock = NULL;
+#endif
+
+	resetStats();
+}
+
+
+
+
+DbLock::~DbLock()
+{
+#if defined(THREAD_SAFE)
+	if (_gate != NULL)
+	{
+		vSemaphoreDelete(_gate);
+	}
+
+	if (_slots != NULL)
+	{
+		vSemaphoreDelete(_slots);
+	}
+
+	if (_statsLock != NULL)
+	{
+		vSemaphoreDelete(_statsLock);
+	}
+#endif
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void DbLock::_recordWait(uint32_t waitUs)
+{
+	if (waitUs > _stats.maxWaitUs)
+	{
+		_stats.maxWaitUs = waitUs;
+	}
+}
+
+
+
+
+// ****************** PUBLIC METHODS *************************
+
+bool DbLock::begin()
+{
+#if defined(THREAD_SAFE)
+	if (_gate != NULL)
+	{
+		return SUCCESS;
+	}
+
+	_gate = xSemaphoreCreateMutex();
+	_slots = xSemaphoreCreateCounting(THREAD_SAFE_READERS, THREAD_SAFE_READERS);
+	_statsLock = xSemaphoreCreateMutex();
+
+	if ((_gate == NULL) || (_slots == NULL) || (_statsLock == NULL))
+	{
+		return FAILURE;
+	}
+#endif
+
+	return SUCCESS;
+}
+
+
+
+
+uint32_t DbLock::lockShared()
+{
+#if defined(THREAD_SAFE)
+	// Not created before begin, there are no other tasks using the database yet
+	if (_gate == NULL)
+	{
+		return 0;
+	}
+
+	unsigned long start = micros();
+
+	xSemaphoreTake(_gate, portMAX_DELAY);
+	xSemaphoreTake(_slots, portMAX_DELAY);
+	xSemaphoreGive(_gate);
+
+	uint32_t waitUs = micros() - start;
+
+	xSemaphoreTake(_statsLock, portMAX_DELAY);
+	_recordWait(waitUs);
+	xSemaphoreGive(_statsLock);
+
+	return waitUs;
+#else
+	return 0;
+#endif
+}
+
+
+
+
+void DbLock::unlockShared(uint32_t holdUs)
+{
+#if defined(THREAD_SAFE)
+	if (_gate == NULL)
+	{
+		return;
+	}
+
+	xSemaphoreTake(_statsLock, portMAX_DELAY);
+
+	_stats.reads++;
+	_stats.totalReadHoldUs += holdUs;
+
+	if (holdUs > _stats.maxReadHoldUs)
+	{
+		_stats.maxReadHoldUs = holdUs;
+	}
+
+	xSemaphoreGive(_statsLock);
+
+	xSemaphoreGive(_slots);
+#endif
+}
+
+
+
+
+uint32_t DbLock::lock()
+{
+#if defined(THREAD_SAFE)
+	if (_gate == NULL)
+	{
+		return 0;
+	}
+
+	unsigned long start = micros();
+
+	// Holding the gate while collecting the units keeps new readers out
+	xSemaphoreTake(_gate, portMAX_DELAY);
+
+	for (int i = 0 ; i < THREAD_SAFE_READERS ; i++)
+	{
+		xSemaphoreTake(_slots, portMAX_DELAY);
+	}
+
+	xSemaphoreGive(_gate);
+
+	uint32_t waitUs = micros() - start;
+
+	xSemaphoreTake(_statsLock, portMAX_DELAY);
+	_recordWait(waitUs);
+	xSemaphoreGive(_statsLock);
+
+	return waitUs;
+#else
+	return 0;
+#endif
+}
+
+
+
+
+void DbLock::unlock(uint32_t holdUs)
+{
+#if defined(THREAD_SAFE)
+	if (_gate == NULL)
+	{
+		return;
+	}
+
+	xSemaphoreTake(_statsLock, portMAX_DELAY);
+
+	_stats.writes++;
+	_stats.totalWriteHoldUs += holdUs;
+
+	if (holdUs > _stats.maxWriteHoldUs)
+	{
+		_stats.maxWriteHoldUs = holdUs;
+	}
+
+	xSemaphoreGive(_statsLock);
+
+	for (int i = 0 ; i < THREAD_SAFE_READERS ; i++)
+	{
+		xSemaphoreGive(_slots);
+	}
+#endif
+}
+
+
+
+
+void DbLock::downgrade(uint32_t holdUs)
+{
+#if defined(THREAD_SAFE)
+	if (_gate == NULL)
+	{
+		return;
+	}
+
+	xSemaphoreTake(_statsLock, portMAX_DELAY);
+
+	_stats.writes++;
+	_stats.totalWriteHoldUs += holdUs;
+
+	if (holdUs > _stats.maxWriteHoldUs)
+	{
+		_stats.maxWriteHoldUs = holdUs;
+	}
+
+	xSemaphoreGive(_statsLock);
+
+	// Keeping a single unit, as a reader
+	for (int i = 1 ; i < THREAD_SAFE_READERS ; i++)
+	{
+		xSemaphoreGive(_slots);
+	}
+#endif
+}
+
+
+
+
+DbLockStats DbLock::getStats()
+{
+#if defined(THREAD_SAFE)
+	if (_statsLock != NULL)
+	{
+		xSemaphoreTake(_statsLock, portMAX_DELAY);
+		DbLockStats stats = _stats;
+		xSemaphoreGive(_statsLock);
+
+		return stats;
+	}
+#endif
+
+	return _stats;
+}
+
+
+
+
+void DbLock::resetStats()
+{
+#if defined(THREAD_SAFE)
+	// Called by the constructor before the lock is created
+	if (_statsLock != NULL)
+	{
+		xSemaphoreTake(_statsLock, portMAX_DELAY);
+		memset(&_stats, 0, sizeof(_stats));
+		xSemaphoreGive(_statsLock);
+
+		return;
+	}
+#endif
+
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+
+
+
+// ****************** GUARDS *************************
+
+DbReadGuard::DbReadGuard(DbLock& lock) : _lock(lock)
+{
+	_lock.lockShared();
+	_start = micros();
+}
+
+
+
+
+DbReadGuard::~DbReadGuard()
+{
+	_lock.unlockShared(micros() - _start);
+}
+
+
+
+
+DbWriteGuard::DbWriteGuard(DbLock& lock) : _lock(lock)
+{
+	_lock.lock();
+	_start = micros();
+	_downgraded = false;
+}
+
+
+
+
+DbWriteGuard::~DbWriteGuard()
+{
+	if (_downgraded)
+	{
+		_lock.unlockShared(micros() - _start);
+	}
+	else
+	{
+		_lock.unlock(micros() - _start);
+	}
+}
+
+
+
+
+void DbWriteGuard::downgrade()
+{
+	if (!_downgraded)
+	{
+		_lock.downgrade(micros() - _start);
+		_start = micros();
+		_downgraded = true;
+	}
+}
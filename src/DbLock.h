@@ -0,0 +1,162 @@
+/*
+    DbLock.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef DbLock_h
+#define DbLock_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+#if defined(THREAD_SAFE) && !defined(ESP32)
+#error "THREAD_SAFE needs FreeRTOS tasks, it is supported on ESP32 only"
+#endif
+
+/**
+ * Lock hold and wait times (in microseconds), collected only if THREAD_SAFE is defined
+ */
+struct DbLockStats
+{
+    uint32_t reads;             // number of shared holds
+    uint32_t writes;            // number of exclusive holds
+    uint32_t maxReadHoldUs;
+    uint32_t maxWriteHoldUs;
+    uint32_t totalReadHoldUs;
+    uint32_t totalWriteHoldUs;
+    uint32_t maxWaitUs;         // longest time a task waited for the lock, shared or exclusive
+};
+
+/**
+ * Shared/exclusive lock of a database object. Up to THREAD_SAFE_READERS readers hold it together, a writer
+ * holds it alone. Waiting writers block new readers, so writers are not starved by a stream of reads.
+ * Does nothing if THREAD_SAFE is not defined
+ */
+class DbLock
+{
+    private:
+#if defined(THREAD_SAFE)
+        SemaphoreHandle_t _gate;        // taken by every task before the lock, held by the waiting writer
+        SemaphoreHandle_t _slots;       // THREAD_SAFE_READERS units, a reader takes one and a writer all of them
+        SemaphoreHandle_t _statsLock;   // protects the stats updated by the readers
+#endif
+
+        DbLockStats _stats;
+
+        /**
+         * This will note the time a task waited for the lock
+         * @param waitUs time waited (in microseconds)
+         */
+        void _recordWait(uint32_t waitUs);
+
+        // The semaphores are owned by a single lock
+        DbLock(const DbLock&);
+        DbLock& operator=(const DbLock&);
+
+    public:
+        /**
+         * Constructor for initializing class object
+         * @param null
+         * @return null
+         */
+        DbLock();
+
+        /**
+         * Destructor deleting the semaphores of the lock, no task may hold or wait for the lock
+         * @param null
+         * @return null
+         */
+        ~DbLock();
+
+        /**
+         * This will create the semaphores of the lock, must be called before the lock is used
+         * @param null
+         * @return SUCCESS if the lock is ready
+         * @return FAILURE otherwise
+         */
+        bool begin();
+
+        /**
+         * This will wait for and take the shared (read) lock
+         * @param null
+         * @return time the task waited (in microseconds)
+         */
+        uint32_t lockShared();
+
+        /**
+         * This will release the shared (read) lock
+         * @param holdUs time the lock was held (in microseconds)
+         */
+        void unlockShared(uint32_t holdUs);
+
+        /**
+         * This will wait for and take the exclusive (write) lock
+         * @param null
+         * @return time the task waited (in microseconds)
+         */
+        uint32_t lock();
+
+        /**
+         * This will release the exclusive (write) lock
+         * @param holdUs time the lock was held (in microseconds)
+         */
+        void unlock(uint32_t holdUs);
+
+        /**
+         * This will turn the exclusive lock of the caller into a shared lock, letting other readers in
+         * while writers keep waiting. Release it with unlockShared after that
+         * @param holdUs time the exclusive lock was held (in microseconds)
+         */
+        void downgrade(uint32_t holdUs);
+
+        /**
+         * This will return the collected hold and wait times
+         * @param null
+         * @return copy of the stats
+         */
+        DbLockStats getStats();
+
+        /**
+         * This will reset the collected hold and wait times
+         * @param null
+         */
+        void resetStats();
+};
+
+/**
+ * Holds the shared lock until the end of the scope
+ */
+class DbReadGuard
+{
+    private:
+        DbLock& _lock;
+        unsigned long _start;
+
+    public:
+        DbReadGuard(DbLock& lock);
+        ~DbReadGuard();
+};
+
+/**
+ * Holds the exclusive lock until the end of the scope, or the shared lock after downgrade
+ */
+class DbWriteGuard
+{
+    private:
+        DbLock& _lock;
+        unsigned long _start;
+        bool _downgraded;
+
+    public:
+        DbWriteGuard(DbLock& lock);
+        ~DbWriteGuard();
+
+        /**
+         * This will keep only the shared lock for the rest of the scope
+         */
+        void downgrade();
+};
+
+#endif
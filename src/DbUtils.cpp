@@ -0,0 +1,535 @@
+/*
+    DbUtils.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "DbUtils.h"
+#include "Compression.h"
+#include "KeyDirectory.h"
+#include "ScanKernel.h"
+
+static uint32_t _defaultClock()
+{
+	return (uint32_t)time(NULL);
+}
+
+static DbClock _clock = _defaultClock;
+
+
+
+
+/**
+ * This will find the next record of data and decode its key
+ * @param data records as stored
+ * @param pos index to start from, moved after the record on return
+ * @param key key of the previous record, replaced by the key of this record
+ * @param sepIdx index of the '>' following the key
+ * @param endIdx index of the new line ending the record
+ * @return false if no more records are available
+ */
+static bool _nextRecord(const String& data, int& pos, String& key, int& sepIdx, int& endIdx)
+{
+	int length = data.length();
+
+	while (pos < length)
+	{
+		// Skipping the separators left between records
+		while ((pos < length) && ((data[pos] == '\n') || (data[pos] == '\0')))
+		{
+			pos++;
+		}
+
+		const char* raw = data.c_str();
+		endIdx = dbFindByte(raw + pos, length - pos, '\n');
+
+		if (endIdx == -1)
+		{
+			// Incomplete last record
+			return false;
+		}
+
+		int start = pos;
+		endIdx = endIdx + start;
+		sepIdx = dbFindByte(raw + start, endIdx - start, '>');
+		pos = endIdx + 1;
+
+		if (sepIdx == -1)
+		{
+			// Malformed record, no active flag present
+			continue;
+		}
+
+		sepIdx = sepIdx + start;
+
+		if ((data[start] == KEY_SHARED_MARKER) && ((start + 3) <= sepIdx))
+		{
+			int shared = (dbHexValue(data[start + 1]) << 4) | dbHexValue(data[start + 2]);
+			key = key.substring(0, shared) + data.substring(start + 3, sepIdx);
+		}
+		else
+		{
+			key = data.substring(start, sepIdx);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+
+
+
+void dbSetClock(DbClock clock)
+{
+	_clock = (clock != NULL) ? clock : _defaultClock;
+}
+
+
+
+
+uint32_t dbNow()
+{
+	return _clock();
+}
+
+
+
+
+void dbExpiryTimes(const uint32_t ttlSeconds[], uint32_t expiries[], int count)
+{
+	uint32_t now = dbNow();
+
+	for (int i = 0 ; i < count ; i++)
+	{
+		expiries[i] = ((ttlSeconds != NULL) && (ttlSeconds[i] > 0)) ? (now + ttlSeconds[i]) : 0;
+	}
+}
+
+
+
+
+uint8_t dbFlagBits(char flag)
+{
+	if ((flag < '0') || (flag > '9'))
+	{
+		return 0;
+	}
+
+	return (uint8_t)(flag - '0');
+}
+
+
+
+
+bool dbIsLive(const Record& record)
+{
+	uint8_t bits = dbFlagBits(record.flag);
+
+	if (!(bits & RECORD_ACTIVE))
+	{
+		return false;
+	}
+
+	return !(bits & RECORD_EXPIRES) || (record.expiry > dbNow());
+}
+
+
+
+
+bool dbIsLiveLine(const String& line)
+{
+	int indexOfSep = line.indexOf('>');
+
+	if (indexOfSep == -1)
+	{
+		return false;
+	}
+
+	Record record;
+	record.flag = line[indexOfSep + 1];
+	record.expiry = 0;
+
+	if (dbFlagBits(record.flag) & RECORD_EXPIRES)
+	{
+		for (int i = indexOfSep + 2 ; i < (indexOfSep + 10) ; i++)
+		{
+			record.expiry = (record.expiry << 4) | dbHexValue(line[i]);
+		}
+	}
+
+	return dbIsLive(record);
+}
+
+
+
+
+String dbEncodeRecord(const DbKey& key, const String& value, uint32_t ttlSeconds, uint16_t compressMinSize)
+{
+	return dbEncodeRecordAt(key, value, (ttlSeconds > 0) ? (dbNow() + ttlSeconds) : 0, compressMinSize);
+}
+
+
+
+
+String dbEncodeRecordAt(const DbKey& key, const String& value, uint32_t expiry, uint16_t compressMinSize)
+{
+	uint8_t bits = RECORD_ACTIVE;
+	String header = "";
+
+	if (expiry > 0)
+	{
+		bits |= RECORD_EXPIRES;
+		header = dbHex(expiry);
+	}
+
+	if ((compressMinSize > 0) && (value.length() >= compressMinSize))
+	{
+		String packed = dbCompress(value);
+
+		// Values which do not get smaller are stored as it is
+		if (packed.length() < value.length())
+		{
+			bits |= RECORD_COMPRESSED;
+			return String(key.c_str()) + ">" + String((char)('0' + bits)) + header + ":" + packed + "\n";
+		}
+	}
+
+	return String(key.c_str()) + ">" + String((char)('0' + bits)) + header + ":" + value + "\n";
+}
+
+
+
+
+int dbEncodeRecordTo(char* out, const DbKey& key, const String& value, uint32_t expiry)
+{
+	const char* digits = "0123456789abcdef";
+	uint8_t bits = RECORD_ACTIVE;
+	int length = key.length();
+
+	memcpy(out, key.c_str(), length);
+	out[length++] = '>';
+
+	if (expiry > 0)
+	{
+		bits |= RECORD_EXPIRES;
+		out[length++] = (char)('0' + bits);
+
+		for (int i = 7 ; i >= 0 ; i--)
+		{
+			out[length + i] = digits[expiry & 0x0F];
+			expiry = expiry >> 4;
+		}
+
+		length = length + 8;
+	}
+	else
+	{
+		out[length++] = (char)('0' + bits);
+	}
+
+	out[length++] = ':';
+	memcpy(out + length, value.c_str(), value.length());
+	length = length + value.length();
+	out[length++] = '\n';
+
+	return length;
+}
+
+
+
+
+String dbEncodeKey(const String& previousKey, const String& key)
+{
+	unsigned int shared = 0;
+
+	while ((shared < previousKey.length()) && (shared < key.length()) && (shared < 0xFF) && (previousKey[shared] == key[shared]))
+	{
+		shared++;
+	}
+
+	if (shared < KEY_MIN_SHARED)
+	{
+		return key;
+	}
+
+	return String((char)KEY_SHARED_MARKER) + dbHex(shared).substring(6) + key.substring(shared);
+}
+
+
+
+
+String dbCompactRecords(const String& data)
+{
+	KeyDirectory directory;
+	String key = "";
+	String newData = "";
+	bool sorted = true;
+	int pos = 0;
+	int sepIdx;
+	int endIdx;
+
+	// Collecting the live records sorted by key, the offsets point to their '>'
+	while (_nextRecord(data, pos, key, sepIdx, endIdx))
+	{
+		if (dbIsLiveLine(data.substring(sepIdx, endIdx)) && !directory.put(key, sepIdx))
+		{
+			sorted = false;
+			break;
+		}
+	}
+
+	newData.reserve(data.length());
+
+	if (sorted)
+	{
+		for (int i = 0 ; i < directory.size() ; i++)
+		{
+			const String& current = directory.keyAt(i);
+			int offset = directory.offsetAt(i);
+
+			if ((i % KEY_RESTART_INTERVAL) == 0)
+			{
+				newData += current;
+			}
+			else
+			{
+				newData += dbEncodeKey(directory.keyAt(i - 1), current);
+			}
+
+			newData += data.substring(offset, data.indexOf('\n', offset) + 1);
+		}
+
+		return newData;
+	}
+
+	// Not enough memory for sorting, keeping the file order with full keys
+	directory.clear();
+	key = "";
+	pos = 0;
+
+	while (_nextRecord(data, pos, key, sepIdx, endIdx))
+	{
+		if (dbIsLiveLine(data.substring(sepIdx, endIdx)))
+		{
+			newData += key + data.substring(sepIdx, endIdx + 1);
+		}
+	}
+
+	return newData;
+}
+
+
+
+
+String dbDecodeRecords(const String& data)
+{
+	String key = "";
+	String newData = "";
+	int pos = 0;
+	int sepIdx;
+	int endIdx;
+
+	newData.reserve(data.length());
+
+	while (_nextRecord(data, pos, key, sepIdx, endIdx))
+	{
+		String line = data.substring(sepIdx, endIdx);
+		int valueIdx = line.indexOf(':');
+
+		if (valueIdx == -1)
+		{
+			continue;
+		}
+
+		String value = line.substring(valueIdx + 1);
+
+		if (dbFlagBits(line[1]) & RECORD_COMPRESSED)
+		{
+			value = dbDecompress(value);
+		}
+
+		newData += key + (dbIsLiveLine(line) ? ">1:" : ">0:") + value + "\n";
+	}
+
+	return newData;
+}
+
+
+
+
+String dbHex(uint32_t value)
+{
+	const char* digits = "0123456789abcdef";
+	char hex[9];
+
+	for (int i = 7 ; i >= 0 ; i--)
+	{
+		hex[i] = digits[value & 0x0F];
+		value = value >> 4;
+	}
+
+	hex[8] = '\0';
+
+	return String(hex);
+}
+
+
+
+
+uint8_t dbHexValue(char digit)
+{
+	if ((digit >= '0') && (digit <= '9'))
+	{
+		return digit - '0';
+	}
+	else if ((digit >= 'a') && (digit <= 'f'))
+	{
+		return digit - 'a' + 10;
+	}
+	else if ((digit >= 'A') && (digit <= 'F'))
+	{
+		return digit - 'A' + 10;
+	}
+
+	return 0;
+}
+
+
+
+
+uint32_t dbHash(const char* data, size_t length)
+{
+	uint32_t hash = 2166136261UL;
+
+	for (size_t i = 0 ; i < length ; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 16777619UL;
+	}
+
+	return hash;
+}
+
+
+
+
+uint32_t dbCrc32(uint32_t crc, const uint8_t* data, size_t length)
+{
+	crc = ~crc;
+
+	// Bitwise, a table would take 1 KB of RAM for the rare backups
+	for (size_t i = 0 ; i < length ; i++)
+	{
+		crc ^= data[i];
+
+		for (int bit = 0 ; bit < 8 ; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+		}
+	}
+
+	return ~crc;
+}
+
+
+
+
+/**
+ * Constructor of the lookup table
+ */
+KeyLookup::KeyLookup(const String keys[], int count)
+{
+	_keys = keys;
+	_count = (count > 0) ? count : 0;
+	_hashes = new uint32_t[_count];
+	_order = new int[_count];
+
+	for (int i = 0 ; i < _count ; i++)
+	{
+		_hashes[i] = dbHash(keys[i].c_str(), keys[i].length());
+		_order[i] = i;
+	}
+
+	// Insertion sort by hash, keeping the original order for equal hashes
+	for (int i = 1 ; i < _count ; i++)
+	{
+		int current = _order[i];
+		int j = i - 1;
+
+		while ((j >= 0) && (_hashes[_order[j]] > _hashes[current]))
+		{
+			_order[j + 1] = _order[j];
+			j--;
+		}
+
+		_order[j + 1] = current;
+	}
+}
+
+
+
+
+KeyLookup::~KeyLookup()
+{
+	delete[] _hashes;
+	delete[] _order;
+}
+
+
+
+
+int KeyLookup::find(const String& key)
+{
+	uint32_t hash = dbHash(key.c_str(), key.length());
+	int low = 0;
+	int high = _count;
+
+	// Binary search for the first key with the same hash
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+
+		if (_hashes[_order[mid]] < hash)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	int keyIdx = -1;
+
+	for (int i = low ; (i < _count) && (_hashes[_order[i]] == hash) ; i++)
+	{
+		if (key.equals(_keys[_order[i]]))
+		{
+			keyIdx = _order[i];
+		}
+	}
+
+	return keyIdx;
+}
+
+
+
+
+int KeyLookup::distinctCount()
+{
+	int distinct = 0;
+
+	for (int i = 0 ; i < _count ; i++)
+	{
+		if (find(_keys[i]) == i)
+		{
+			distinct++;
+		}
+	}
+
+	return distinct;
+}
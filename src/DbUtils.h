@@ -0,0 +1,236 @@
+/*
+    DbUtils.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef DbUtils_h
+#define DbUtils_h
+
+#include "Arduino.h"
+#include "DbKey.h"
+
+// Bits of the flag stored after the key of a record, the flag is stored as '0' + bits
+// '0' is a removed record and '1' an active record
+#define RECORD_ACTIVE 0x01
+#define RECORD_EXPIRES 0x02     // flag is followed by the expiry time as 8 hex digits
+#define RECORD_COMPRESSED 0x04  // value is compressed using dbCompress
+#define RECORD_MAX_OVERHEAD 12  // bytes of a record besides its key and value: '>', flag, expiry, ':' and new line
+
+// Keys of records written in sorted blocks by compaction are front coded, a key sharing at least
+// KEY_MIN_SHARED bytes with the key of the previous record is stored as KEY_SHARED_MARKER,
+// the shared length as 2 hex digits and the rest of the key. Every KEY_RESTART_INTERVAL
+// records a full key is stored again
+#define KEY_SHARED_MARKER 0x1E
+#define KEY_MIN_SHARED 4
+#define KEY_RESTART_INTERVAL 16
+
+/**
+ * Details of a record read from the store, filled by the memory engines while scanning
+ */
+struct Record {
+    int offset;         // index of the first byte of the record
+    int flagOffset;     // index of the active flag following the key
+    String key;
+    char flag;
+    uint32_t expiry;    // expiry time in seconds, 0 if the record never expires
+};
+
+/**
+ * Bytes used by the records of a store, live records are active and not expired.
+ * Compaction reclaims the bytes of dead (removed and expired) records and the separators between records
+ */
+struct DbUsage {
+    uint32_t capacity;      // bytes usable for records
+    uint32_t usedBytes;     // bytes written, including separators
+    uint32_t liveBytes;     // bytes of the live records
+    uint32_t deadBytes;     // bytes of the removed and expired records
+};
+
+/**
+ * Thresholds for compacting a store before writes run out of space, see ArduinoDb::maintain
+ */
+struct CompactionPolicy {
+    uint8_t minDeadPercent;     // compact if at least this percent of the used bytes is dead
+    uint32_t minDeadBytes;      // and at least this many bytes would be reclaimed
+    uint8_t minFreePercent;     // compact if less than this percent of the capacity is free, whatever the dead ratio
+    uint32_t idleMs;            // only after no write for this long (in milliseconds)
+};
+
+/**
+ * Clock used for expiring records, returns the current time in seconds
+ */
+typedef uint32_t (*DbClock)();
+
+/**
+ * This will set the clock used for expiring records, by default time() is used
+ * which needs the system time to be set (e.g. using configTime) for expiry to survive restarts
+ * @param clock function returning the current time in seconds
+ */
+void dbSetClock(DbClock clock);
+
+/**
+ * This will return the current time of the clock used for expiring records
+ * @param null
+ * @return current time in seconds
+ */
+uint32_t dbNow();
+
+/**
+ * This will turn times after which keys expire into the times at which they expire, using a single reading of the clock
+ * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never)
+ * @param expiries array to hold the expiry times (0 for never)
+ * @param count number of keys
+ */
+void dbExpiryTimes(const uint32_t ttlSeconds[], uint32_t expiries[], int count);
+
+/**
+ * This will return the bits of the flag of a record
+ * @param flag flag stored after the key
+ * @return bits of the flag, 0 for removed or invalid flags
+ */
+uint8_t dbFlagBits(char flag);
+
+/**
+ * This will tell weather the record is active and not expired
+ * @param record record to check
+ * @return true if the record is live
+ */
+bool dbIsLive(const Record& record);
+
+/**
+ * This will tell weather a complete record line (without the new line) is active and not expired
+ * @param line record line as stored
+ * @return true if the record is live
+ */
+bool dbIsLiveLine(const String& line);
+
+/**
+ * This will build a record line as stored, including the new line
+ * @param key key of the record
+ * @param value value of the record
+ * @param ttlSeconds time after which the record expires (in seconds), 0 for never
+ * @param compressMinSize values of at least this length are stored compressed, 0 for never
+ * @return record line
+ */
+String dbEncodeRecord(const DbKey& key, const String& value, uint32_t ttlSeconds, uint16_t compressMinSize);
+
+/**
+ * This will build a record line as stored, including the new line, expiring at the given time
+ * @param key key of the record
+ * @param value value of the record
+ * @param expiry time at which the record expires (as returned by dbNow), 0 for never
+ * @param compressMinSize values of at least this length are stored compressed, 0 for never
+ * @return record line
+ */
+String dbEncodeRecordAt(const DbKey& key, const String& value, uint32_t expiry, uint16_t compressMinSize);
+
+/**
+ * This will write a record line as stored, including the new line, into a buffer. The value is not compressed
+ * @param out buffer to hold the record, must have space for key.length() + value.length() + RECORD_MAX_OVERHEAD bytes
+ * @param key key of the record
+ * @param value value of the record
+ * @param expiry time at which the record expires (as returned by dbNow), 0 for never
+ * @return number of bytes written
+ */
+int dbEncodeRecordTo(char* out, const DbKey& key, const String& value, uint32_t expiry);
+
+/**
+ * This will front code the key against the key of the previous record
+ * @param previousKey key of the previous record
+ * @param key key to encode
+ * @return key as stored, key itself if not enough bytes are shared
+ */
+String dbEncodeKey(const String& previousKey, const String& key);
+
+/**
+ * This will rebuild the records of a store for compaction, dropping removed and expired
+ * records and writing the rest sorted by key with front coded keys
+ * @param data records as stored
+ * @return compacted records
+ */
+String dbCompactRecords(const String& data);
+
+/**
+ * This will rewrite the records of a store the way they were inserted, as returned by getAll.
+ * Keys are written in full, values uncompressed and the flag is 1 for live and 0 for removed
+ * or expired records, without the expiry time
+ * @param data records as stored
+ * @return records as "key>flag:value" lines
+ */
+String dbDecodeRecords(const String& data);
+
+/**
+ * This will format the value as 8 hex digits, as stored in the record header
+ * @param value value to format
+ * @return 8 hex digits
+ */
+String dbHex(uint32_t value);
+
+/**
+ * This will return the value of a hex digit
+ * @param digit hex digit
+ * @return value of the digit, 0 for invalid digits
+ */
+uint8_t dbHexValue(char digit);
+
+/**
+ * This will return the FNV-1a hash of the given bytes
+ * @param data bytes to hash
+ * @param length number of bytes to hash
+ * @return 32 bit hash of the bytes
+ */
+uint32_t dbHash(const char* data, size_t length);
+
+/**
+ * This will update the CRC-32 (as used by zip) of a stream of bytes
+ * @param crc CRC of the bytes before, 0 for the first bytes
+ * @param data bytes to add
+ * @param length number of bytes to add
+ * @return CRC of all the bytes
+ */
+uint32_t dbCrc32(uint32_t crc, const uint8_t* data, size_t length);
+
+/**
+ * Lookup table over a list of requested keys, sorted by hash so that
+ * a single pass over the store can match every record against all the keys
+ */
+class KeyLookup
+{
+    private:
+        const String* _keys;
+        int _count;
+        uint32_t* _hashes;
+        int* _order;
+
+        KeyLookup(const KeyLookup&);
+        KeyLookup& operator=(const KeyLookup&);
+
+    public:
+        /**
+         * Constructor for building the lookup table
+         * @param keys array of requested keys, must outlive the lookup table
+         * @param count number of keys in the array
+         */
+        KeyLookup(const String keys[], int count);
+
+        ~KeyLookup();
+
+        /**
+         * This will return the position of key in the requested keys
+         * @param key the key to search for
+         * @return index of the last occurrence of key in the requested keys
+         * @return -1 if key was not requested
+         */
+        int find(const String& key);
+
+        /**
+         * This will return the number of distinct requested keys
+         * @param null
+         * @return number of distinct keys
+         */
+        int distinctCount();
+};
+
+#endif
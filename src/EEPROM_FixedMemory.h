@@ -0,0 +1,355 @@
+/*
+    EEPROM_FixedMemory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using fixed slots of EEPROM memory
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef EEPROM_FixedMemory_h
+#define EEPROM_FixedMemory_h
+
+#include "Arduino.h"
+#include <EEPROM.h>
+#include "Config.h"
+
+// Length stored in an empty slot
+#define EMPTY_SLOT 0xFFFF
+
+/**
+ * A key of the schema along with the maximum length of its value (in bytes)
+ */
+struct EEPROMSlot {
+    const char* key;
+    uint16_t width;
+};
+
+/**
+ * Compile time comparison of two keys
+ */
+constexpr bool eepromKeyEquals(const char* a, const char* b)
+{
+    return (*a == *b) && ((*a == '\0') || eepromKeyEquals(a + 1, b + 1));
+}
+
+/**
+ * Compile time search of the slot of a key in the schema
+ * @return index of the slot, -1 if the key is not in the schema
+ */
+template <size_t N>
+constexpr int eepromSlotIndex(const EEPROMSlot (&schema)[N], const char* key, size_t slot = 0)
+{
+    return (slot >= N) ? -1 : (eepromKeyEquals(schema[slot].key, key) ? (int)slot : eepromSlotIndex(schema, key, slot + 1));
+}
+
+/**
+ * Compile time offset of a slot, every slot stores 2 bytes of length followed by the value
+ * @return index of the first byte of the slot, for slot N the size of the whole schema
+ */
+template <size_t N>
+constexpr int eepromSlotOffset(const EEPROMSlot (&schema)[N], size_t slot)
+{
+    return (slot == 0) ? 0 : (eepromSlotOffset(schema, slot - 1) + 2 + schema[slot - 1].width);
+}
+
+/**
+ * Fails compilation for keys not present in the schema
+ */
+template <int SLOT>
+struct EEPROMSlotCheck {
+    static_assert(SLOT >= 0, "Key not found in the EEPROM schema");
+    static const int value = SLOT;
+};
+
+// Slot of a key resolved at compile time, the schema must be constexpr
+#define EEPROM_SLOT(schema, key) (EEPROMSlotCheck<eepromSlotIndex(schema, key)>::value)
+
+/**
+ * Database with a fixed set of keys known at compile time. Every key has a fixed slot
+ * in EEPROM memory, so get/insert directly access the slot without any scanning or optimization
+ */
+template <size_t N>
+class EEPROM_FixedMemory
+{
+    private:
+        const EEPROMSlot* _schema;
+        uint16_t _offsets[N + 1];
+        uint16_t _EEPROM_OFFSET;
+        bool _isInitiated;
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg)
+        {
+#ifdef DEBUG
+            Serial.print("*ArduinoDb[EEPROM_FIXED]* ");
+            Serial.println(msg);
+#endif
+        }
+
+        /**
+         * This will return the length of the value stored in the slot
+         * @param slot index of the slot
+         * @return length of the value, EMPTY_SLOT if no value is stored
+         */
+        uint16_t _length(int slot)
+        {
+            int idx = _EEPROM_OFFSET + _offsets[slot];
+
+            return (uint16_t)EEPROM.read(idx) | ((uint16_t)EEPROM.read(idx + 1) << 8);
+        }
+
+        /**
+         * This will tell weather the slot index is part of the schema
+         * @param slot index of the slot
+         * @return true if slot is valid
+         */
+        bool _isValid(int slot)
+        {
+            return _isInitiated && (slot >= 0) && (slot < (int)N);
+        }
+
+    public:
+        /**
+         * Constructor for initializing class object for using fixed slots of EEPROM memory
+         * @param schema constexpr array of keys along with their maximum value length
+         * @param EEPROMOffset index of the first byte used, must not overlap other regions
+         * @return null
+         */
+        EEPROM_FixedMemory(const EEPROMSlot (&schema)[N], int EEPROMOffset)
+        {
+            _schema = schema;
+            _EEPROM_OFFSET = EEPROMOffset;
+            _isInitiated = false;
+
+            _offsets[0] = 0;
+
+            for (size_t i = 0 ; i < N ; i++)
+            {
+                _offsets[i + 1] = _offsets[i] + 2 + schema[i].width;
+            }
+        }
+
+        /**
+         * This method will handle the initialization of the library
+         * Note- Must be called within setup only once
+         * @return FAILURE is initialization fails
+         * @return SUCCESS is initialization successful
+         */
+        bool begin()
+        {
+            _print("Initializing the system");
+
+            if ((_EEPROM_OFFSET + size()) > MAX_EEPROM_SIZE)
+            {
+                _isInitiated = false;
+                return FAILURE;
+            }
+
+            // Setting up EEPROM, other regions may have already set it up with enough size
+            if (EEPROM.length() < (size_t)(_EEPROM_OFFSET + size()))
+            {
+                EEPROM.begin(_EEPROM_OFFSET + size());
+            }
+
+            _isInitiated = true;
+
+            return SUCCESS;
+        }
+
+        /**
+         * This method will remove the values of all the slots
+         * @return FAILURE is format fails
+         * @return SUCCESS is format successful
+         */
+        bool format()
+        {
+            _print("Formatting the system");
+
+            if (!_isInitiated)
+            {
+                _print("System not initiated");
+                return FAILURE;
+            }
+
+            for (int i = 0 ; i < size() ; i++)
+            {
+                EEPROM.write(_EEPROM_OFFSET + i, 0xFF);
+            }
+
+            return EEPROM.commit() ? SUCCESS : FAILURE;
+        }
+
+        /**
+         * This will return the number of bytes used by all the slots
+         * @param null
+         * @return size of the schema (in bytes)
+         */
+        int size()
+        {
+            return _offsets[N];
+        }
+
+        /**
+         * This will return the slot of a key at runtime, use EEPROM_SLOT for resolving it at compile time
+         * @param key the key to search for
+         * @return index of the slot
+         * @return -1 if key is not in the schema
+         */
+        int slotOf(const String& key)
+        {
+            for (size_t i = 0 ; i < N ; i++)
+            {
+                if (key.equals(_schema[i].key))
+                {
+                    return i;
+                }
+            }
+
+            return -1;
+        }
+
+        /**
+         * This method will return the value stored in the slot
+         * @param slot index of the slot, e.g. EEPROM_SLOT(schema, "key")
+         * @param defaultValue default value to return if no value is stored
+         * @return value stored in the slot if found
+         * @return defaultValue otherwise
+         */
+        String get(int slot, const String& defaultValue)
+        {
+            if (!_isValid(slot))
+            {
+                return defaultValue;
+            }
+
+            uint16_t length = _length(slot);
+
+            if ((length == EMPTY_SLOT) || (length > _schema[slot].width))
+            {
+                return defaultValue;
+            }
+
+            String value = "";
+            value.reserve(length);
+
+            int idx = _EEPROM_OFFSET + _offsets[slot] + 2;
+
+            for (uint16_t i = 0 ; i < length ; i++)
+            {
+                value += (char)EEPROM.read(idx + i);
+            }
+
+            return value;
+        }
+
+        /**
+         * This method will store the value in the slot
+         * @param slot index of the slot, e.g. EEPROM_SLOT(schema, "key")
+         * @param value value to store
+         * @return SUCCESS if value stored successfully
+         * @return FAILURE is slot is not valid or write failed
+         * @return MEM_FULL if value is longer than the width of the slot
+         */
+        int8_t insert(int slot, const String& value)
+        {
+            if (!_isValid(slot))
+            {
+                _print("Invalid slot");
+                return FAILURE;
+            }
+
+            if (value.length() > _schema[slot].width)
+            {
+                _print("Value too long for the slot");
+                return MEM_FULL;
+            }
+
+            int idx = _EEPROM_OFFSET + _offsets[slot];
+
+            EEPROM.write(idx, value.length() & 0xFF);
+            EEPROM.write(idx + 1, (value.length() >> 8) & 0xFF);
+
+            for (unsigned int i = 0 ; i < value.length() ; i++)
+            {
+                EEPROM.write(idx + 2 + i, value[i]);
+            }
+
+            return EEPROM.commit() ? SUCCESS : FAILURE;
+        }
+
+        /**
+         * This method will remove the value stored in the slot
+         * @param slot index of the slot, e.g. EEPROM_SLOT(schema, "key")
+         * @return FAILURE if fails or no value is stored
+         * @return SUCCESS if value removed successfully
+         */
+        bool remove(int slot)
+        {
+            if (!exists(slot))
+            {
+                return FAILURE;
+            }
+
+            int idx = _EEPROM_OFFSET + _offsets[slot];
+
+            EEPROM.write(idx, 0xFF);
+            EEPROM.write(idx + 1, 0xFF);
+
+            return EEPROM.commit() ? SUCCESS : FAILURE;
+        }
+
+        /**
+         * This method will tell weather a value is stored in the slot
+         * @param slot index of the slot, e.g. EEPROM_SLOT(schema, "key")
+         * @return SUCCESS if value is stored
+         * @return FAILURE otherwise
+         */
+        bool exists(int slot)
+        {
+            if (!_isValid(slot))
+            {
+                return FAILURE;
+            }
+
+            uint16_t length = _length(slot);
+
+            return ((length != EMPTY_SLOT) && (length <= _schema[slot].width)) ? SUCCESS : FAILURE;
+        }
+
+        /**
+         * Same as get(slot, defaultValue), with the slot of key searched at runtime
+         */
+        String get(const String& key, const String& defaultValue)
+        {
+            return get(slotOf(key), defaultValue);
+        }
+
+        /**
+         * Same as insert(slot, value), with the slot of key searched at runtime.
+         * Returns FAILURE for keys not in the schema
+         */
+        int8_t insert(const String& key, const String& value)
+        {
+            return insert(slotOf(key), value);
+        }
+
+        /**
+         * Same as remove(slot), with the slot of key searched at runtime
+         */
+        bool remove(const String& key)
+        {
+            return remove(slotOf(key));
+        }
+
+        /**
+         * Same as exists(slot), with the slot of key searched at runtime
+         */
+        bool exists(const String& key)
+        {
+            return exists(slotOf(key));
+        }
+};
+
+#endif
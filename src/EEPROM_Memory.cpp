@@ -8,13 +8,63 @@
 #include "Arduino.h"
 #include "EEPROM_Memory.h"
 
+#if defined(DB_STATIC_ARENA)
+/**
+ * Live record of the memory being compacted in the static arena
+ */
+struct ArenaRecord
+{
+    int key;            // index of the full key in the buffer of keys
+    int keyLength;
+    int rest;           // index of the '>' following the key in the memory
+    int restLength;     // bytes from the '>' up to the end of the value
+};
+#endif
+
 /**
  * Constructor of the class for EEPROM memory
  */
 EEPROM_Memory::EEPROM_Memory(int EEPROMSize)
 {
+	// Sizes outside EEPROM are checked before narrowing, begin fails for them
+	if ((EEPROMSize <= 0) || (EEPROMSize > MAX_EEPROM_SIZE))
+	{
+		EEPROMSize = 0;
+	}
+
+	_EEPROM_SIZE = EEPROMSize;
+	_EEPROM_OFFSET = 0;
+	_isInitiated = false;
+	_directoryBuilt = false;
+	_sweepIdx = 0;
+	_compressMinSize = 0;
+	_deferCommit = false;
+	_commitPending = false;
+}
+
+
+
+
+/**
+ * Constructor of the class for a region of EEPROM memory
+ */
+EEPROM_Memory::EEPROM_Memory(int EEPROMSize, int EEPROMOffset)
+{
+	// Regions outside EEPROM are checked before narrowing, begin fails for them
+	if ((EEPROMSize <= 0) || (EEPROMOffset < 0) || ((EEPROMOffset + EEPROMSize) > MAX_EEPROM_SIZE))
+	{
+		EEPROMSize = 0;
+		EEPROMOffset = 0;
+	}
+
 	_EEPROM_SIZE = EEPROMSize;
+	_EEPROM_OFFSET = EEPROMOffset;
 	_isInitiated = false;
+	_directoryBuilt = false;
+	_sweepIdx = 0;
+	_compressMinSize = 0;
+	_deferCommit = false;
+	_commitPending = false;
 }
 
 
@@ -32,50 +82,192 @@ void EEPROM_Memory::_print(const String& msg)
 
 
 
-int EEPROM_Memory::_indexOfKey(const String& key)
+void EEPROM_Memory::_print(const char* msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[EEPROM]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+bool EEPROM_Memory::_commit()
+{
+	if (_deferCommit)
+	{
+		_commitPending = true;
+		return SUCCESS;
+	}
+
+	return EEPROM.commit();
+}
+
+
+
+
+char EEPROM_Memory::_read(int idx)
+{
+	// Bytes of other regions are never read
+	if (!_isInitiated || (idx < 0) || (idx >= _EEPROM_SIZE))
+	{
+		return '\0';
+	}
+
+	return _mirror()[idx];
+}
+
+
+
+
+const char* EEPROM_Memory::_mirror()
+{
+#if defined(ESP8266)
+	// getDataPtr of ESP8266 marks the whole buffer as changed, so that commit writes it back
+	return (const char*)EEPROM.getConstDataPtr() + _EEPROM_OFFSET;
+#else
+	return (const char*)EEPROM.getDataPtr() + _EEPROM_OFFSET;
+#endif
+}
+
+
+
+
+int EEPROM_Memory::_valueOf(int idx, int fileSize, Record& record, int& length)
+{
+	const char* data = _mirror();
+	int sep = dbFindByte(data + idx, fileSize - idx, '>');
+
+	if (sep == -1)
+	{
+		return -1;
+	}
+
+	record.offset = idx;
+	record.flagOffset = idx + sep + 1;
+	record.flag = data[record.flagOffset];
+	record.expiry = 0;
+
+	int valueIdx = record.flagOffset + 1;
+
+	if (dbFlagBits(record.flag) & RECORD_EXPIRES)
+	{
+		for (int i = 0 ; i < 8 ; i++)
+		{
+			record.expiry = (record.expiry << 4) | dbHexValue(data[valueIdx + i]);
+		}
+
+		valueIdx = valueIdx + 8;
+	}
+
+	// Skipping the ':' separating the value
+	valueIdx++;
+
+	if (valueIdx > fileSize)
+	{
+		return -1;
+	}
+
+	length = dbFindByte(data + valueIdx, fileSize - valueIdx, '\n');
+
+	if (length == -1)
+	{
+		length = fileSize - valueIdx;
+	}
+
+	return valueIdx;
+}
+
+
+
+
+void EEPROM_Memory::_write(int idx, char value)
+{
+	// Bytes of other regions are never written
+	if ((idx >= 0) && (idx < _EEPROM_SIZE))
+	{
+		EEPROM.write(_EEPROM_OFFSET + idx, value);
+	}
+}
+
+
+
+
+int EEPROM_Memory::_indexOfKey(const DbKey& key, bool includeExpired)
 {
 	int fileSize = _getFilesize();
-	int keyIndex = 0;
-	int keyByteIndex = 0;
-	String keyStr = "";
+	int length = 0;
+	Record record;
 
-	for (int i = 0 ; i < fileSize ; i++)
+	if (_directoryBuilt)
 	{
-		char currentChar = (char)EEPROM.read(i);
+		int idx = _directory.find(key);
 
-		if (currentChar == '>')
+		if ((idx == -1) || (_valueOf(idx, fileSize, record, length) == -1))
 		{
-			if (key.equals(keyStr))
-			{
-				// Checking if key active or not
-				i = i + 1;
-				currentChar = (char)EEPROM.read(i);
-				
-				if (currentChar == '1')
-				{
-					_print("(inside indexOfKey) Key found at: " + String(keyByteIndex - keyStr.length()));
-					// TODO: Maybe a structure for both
-					return keyByteIndex - keyStr.length();
-					return keyIndex;
-				}
-				else
-				{
-					keyByteIndex++;
-				}
-			}
+			return -1;
 		}
-		else
+
+		return (includeExpired || dbIsLive(record)) ? record.offset : -1;
+	}
+
+	// Comparing the keys directly in the RAM mirror, without copying them
+	const char* data = _mirror();
+	const char* target = key.c_str();
+	int keyLength = key.length();
+	int matched = 0;	// bytes of key equal to the key of the previous record, for front coded keys
+	int idx = 0;
+
+	while (idx < fileSize)
+	{
+		if ((data[idx] == '\n') || (data[idx] == '\0'))
 		{
-			keyStr = keyStr + String(currentChar);
+			idx++;
+			continue;
 		}
 
-		if (currentChar == '\n')
+		int valueIdx = _valueOf(idx, fileSize, record, length);
+
+		if (valueIdx == -1)
+		{
+			return -1;
+		}
+
+		int suffixIdx = idx;
+		int shared = 0;
+
+		if (data[idx] == KEY_SHARED_MARKER)
+		{
+			shared = (dbHexValue(data[idx + 1]) << 4) | dbHexValue(data[idx + 2]);
+			suffixIdx = idx + 3;
+		}
+
+		int suffixLength = (record.flagOffset - 1) - suffixIdx;
+
+		// Record key differs from key before its shared prefix ends, matched stays the same
+		if (shared <= matched)
 		{
-			keyIndex++;
-			keyStr = "";
+			if (((shared + suffixLength) == keyLength) && (memcmp(data + suffixIdx, target + shared, suffixLength) == 0))
+			{
+				if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && (includeExpired || dbIsLive(record)))
+				{
+#ifdef DEBUG
+					_print("(inside indexOfKey) Key found at: " + String(record.offset));
+#endif
+					return record.offset;
+				}
+
+				matched = keyLength;
+			}
+			else
+			{
+				int compared = ((keyLength - shared) < suffixLength) ? (keyLength - shared) : suffixLength;
+				matched = shared + dbMismatch(data + suffixIdx, target + shared, compared);
+			}
 		}
 
-		keyByteIndex++;
+		idx = valueIdx + length + 1;
 	}
 
 	return -1;
@@ -90,9 +282,11 @@ int8_t EEPROM_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forc
 
 	int totalAvailableBytes = _EEPROM_SIZE;
 
+#ifdef DEBUG
 	_print("Space Required (in bytes): " + String(spaceRequired));
 	_print("Current used space (in bytes): " + String(fileSize));
 	_print("Total available space (in bytes): " + String(totalAvailableBytes));
+#endif
 
 	// Checking if space availabe is sufficient or not
 	if (((spaceRequired + fileSize) < (totalAvailableBytes - 5)) && (!forceOptimize))
@@ -111,47 +305,56 @@ int8_t EEPROM_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forc
 			_print("Space not available...performing optimization");
 		}
 
+#if defined(DB_STATIC_ARENA)
+		// Building the new data in the static arena instead of the heap
+		DbArenaScope scope;
+		int newLength = 0;
+		char* newData = _compactToArena(fileSize, newLength);
+
+		if (newData == NULL)
+		{
+			_print("Arena too small for optimization, increase DB_ARENA_SIZE");
+			return FAILURE;
+		}
+#else
 		// Removing un-indexed data that is not required
-		String newData = "";
-		String temp = "";
+		String data = "";
 		char thisChar;
 
+		data.reserve(fileSize);
+
 		for (int i = 0 ; i < fileSize ; i++)
 		{
-			thisChar = (char)EEPROM.read(i);
+			thisChar = _read(i);
 
-			if (thisChar != '\n')
+			if (thisChar != '\0')
 			{
-				temp = temp + String(thisChar);
-			}
-			else
-			{
-				int indexOfSep = temp.indexOf(">");
-
-				if ((char)temp[indexOfSep + 1] == '1')
-				{
-					newData = newData + temp + "\n";
-				}
-
-				temp = "";
+				data += thisChar;
 			}
 		}
 
+		// Dropping removed and expired records, the rest is written sorted with front coded keys
+		String newData = dbCompactRecords(data);
+		int newLength = newData.length();
+		data = "";
+
+#ifdef DEBUG
 		_print("New File Data:- \n" + newData);
+#endif
+#endif
 
-		// Formatting before writing new data
+		// Formatting before writing new data, this also drops the directory as records are moved
 		format();
 
-		// Writing new data to EEPROM
-		int newDataIdx = 0;
-
-		for (int i = 0 ; i <= newData.length() ; i++)
+		// Writing new data to EEPROM, followed by the terminator
+		for (int i = 0 ; i < newLength ; i++)
 		{
-			EEPROM.write(i, (char)newData[newDataIdx]);
-			newDataIdx++;
+			_write(i, newData[i]);
 		}
 
-		if (EEPROM.commit())
+		_write(newLength, '\0');
+
+		if (_commit())
 		{
 			_print("Write operation successful");
 		} 
@@ -178,224 +381,484 @@ int8_t EEPROM_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forc
 
 
 
-int EEPROM_Memory::_getFilesize()
+int8_t EEPROM_Memory::_replaceData(const String& data)
 {
-	char dataChars[3];
-	int i = 0;
-
-	for (i = 0 ; i < _EEPROM_SIZE ; i = i + 3)
+	// Data is followed by the terminator written by inserts, the rest is free space
+	for (int i = 0 ; i < _EEPROM_SIZE ; i++)
 	{
-		dataChars[0] = (char)EEPROM.read(i);
-		dataChars[1] = (char)EEPROM.read(i + 1);
-		dataChars[2] = (char)EEPROM.read(i + 2);
-
-		if ((dataChars[0] == '\n') && (dataChars[1] == '\n') && (dataChars[2] == '\n'))
+		if (i < (int)data.length())
 		{
-			if (i <= 0)
-			{
-				_print("File size:- " + String(i));
-				return i;
-			}
-
-			// Reverse parsing for removing any extra characters
-			for (int j = i ; j >= 0 ; j--)
-			{
-				if (((char)EEPROM.read(j) != '\n'))
-				{
-					_print("File size:- " + String(j + 1));
-					return j + 1;
-				}
-			}
+			_write(i, data[i]);
+		}
+		else
+		{
+			_write(i, (i == (int)data.length()) ? '\0' : '\n');
 		}
 	}
 
-	_print("File size:- " + String(i));
-	return i;
+	_sweepIdx = 0;
+
+	// Single commit for all the records
+	if (_commit())
+	{
+		_print("Write operation successful");
+		return SUCCESS;
+	}
+	else
+	{
+		_print("Write operation failed");
+		return FAILURE;
+	}
 }
 
-// ************************************************************
 
 
 
-// ****************** PUBLIC METHODS **************************
-bool EEPROM_Memory::begin()
+#if defined(DB_STATIC_ARENA)
+char* EEPROM_Memory::_compactToArena(int fileSize, int& length)
 {
-    _print("Initializing the system");
-
-    if ((_EEPROM_SIZE <= 0) || (_EEPROM_SIZE > MAX_EEPROM_SIZE))
-    {
-        _isInitiated = false;
-        return FAILURE;
-    }
-
-    // Setting up EEPROM
-    EEPROM.begin(_EEPROM_SIZE);
-
-    _isInitiated = true;
+	const char* data = _mirror();
+	Record record;
+	int valueLength = 0;
+	int keyBytes = 0;
+	int liveCount = 0;
+	int outBytes = 0;
+	int previousLength = 0;
+	int idx = 0;
+
+	// First pass for the sizes, front coded keys are as long as the shared part of the previous key and the rest
+	while (idx < fileSize)
+	{
+		if ((data[idx] == '\n') || (data[idx] == '\0'))
+		{
+			idx++;
+			continue;
+		}
 
-    return SUCCESS;
-}
+		int valueIdx = _valueOf(idx, fileSize, record, valueLength);
 
+		if (valueIdx == -1)
+		{
+			break;
+		}
 
+		int suffixIdx = idx;
+		int shared = 0;
 
+		if (data[idx] == KEY_SHARED_MARKER)
+		{
+			shared = (dbHexValue(data[idx + 1]) << 4) | dbHexValue(data[idx + 2]);
+			shared = (shared < previousLength) ? shared : previousLength;
+			suffixIdx = idx + 3;
+		}
 
-bool EEPROM_Memory::format()
-{
-    _print("Formatting the system");
+		int keyLength = shared + ((record.flagOffset - 1) - suffixIdx);
 
-    if (_isInitiated)
-	{
-		// Write a 0 to all bytes of the EEPROM
-		for (int i = 0; i < _EEPROM_SIZE; i++) 
+		if (dbIsLive(record))
 		{
-			EEPROM.write(i, '\n');
+			liveCount++;
+			outBytes = outBytes + keyLength + ((valueIdx + valueLength) - (record.flagOffset - 1)) + 1;
 		}
 
-		EEPROM.commit();
-
-		return SUCCESS;
+		keyBytes = keyBytes + keyLength;
+		previousLength = keyLength;
+		idx = valueIdx + valueLength + 1;
 	}
-	else
+
+	char* keys = (char*)dbArenaAlloc(keyBytes + 1);
+	ArenaRecord* records = (ArenaRecord*)dbArenaAlloc((liveCount + 1) * sizeof(ArenaRecord));
+	char* out = (char*)dbArenaAlloc(outBytes + 1);
+
+	if ((keys == NULL) || (records == NULL) || (out == NULL))
 	{
-		_print("System not initiated");
+		return NULL;
 	}
 
-	return FAILURE;
-}
+	// Second pass, writing the full keys one after another and noting the live records
+	int keyIdx = 0;
+	int previousKey = 0;
+	int count = 0;
 
+	previousLength = 0;
+	idx = 0;
 
+	while ((idx < fileSize) && (count < liveCount))
+	{
+		if ((data[idx] == '\n') || (data[idx] == '\0'))
+		{
+			idx++;
+			continue;
+		}
 
+		int valueIdx = _valueOf(idx, fileSize, record, valueLength);
+		int suffixIdx = idx;
+		int shared = 0;
 
-int8_t EEPROM_Memory::optimize()
-{
-	return _optimizeMemory(0, _getFilesize(), true);
-}
+		if (data[idx] == KEY_SHARED_MARKER)
+		{
+			shared = (dbHexValue(data[idx + 1]) << 4) | dbHexValue(data[idx + 2]);
+			shared = (shared < previousLength) ? shared : previousLength;
+			suffixIdx = idx + 3;
+		}
 
+		int suffixLength = (record.flagOffset - 1) - suffixIdx;
 
+		memmove(keys + keyIdx, keys + previousKey, shared);
+		memcpy(keys + keyIdx + shared, data + suffixIdx, suffixLength);
 
+		if (dbIsLive(record))
+		{
+			records[count].key = keyIdx;
+			records[count].keyLength = shared + suffixLength;
+			records[count].rest = record.flagOffset - 1;
+			records[count].restLength = (valueIdx + valueLength) - (record.flagOffset - 1);
+			count++;
+		}
 
-String EEPROM_Memory::get(const String& key, const String& defaultValue)
-{
-	_print("GET CALLED");
-	
-    if (_isInitiated)
+		previousKey = keyIdx;
+		previousLength = shared + suffixLength;
+		keyIdx = keyIdx + previousLength;
+		idx = valueIdx + valueLength + 1;
+	}
+
+	// Sorting by key, insertion sort as the records are mostly sorted already after the first optimization
+	for (int i = 1 ; i < count ; i++)
 	{
-		int keyIndex = _indexOfKey(key);
+		ArenaRecord current = records[i];
+		int j = i - 1;
 
-		if (keyIndex == -1)
-		{
-			return defaultValue;
-		}
-		else
+		while (j >= 0)
 		{
-			String data = "";
-			int i = keyIndex;
-
-			char currentChar = (char)EEPROM.read(i);
+			int common = (records[j].keyLength < current.keyLength) ? records[j].keyLength : current.keyLength;
+			int compared = memcmp(keys + records[j].key, keys + current.key, common);
 
-			while (currentChar != '\n')
+			if ((compared < 0) || ((compared == 0) && (records[j].keyLength <= current.keyLength)))
 			{
-				data = data + String(currentChar);
-				i = i + 1;
-				currentChar = (char)EEPROM.read(i);
+				break;
 			}
 
-			_print(data);
+			records[j + 1] = records[j];
+			j--;
+		}
 
-			int seperatorIndex = data.indexOf(':');
+		records[j + 1] = current;
+	}
 
-			data = data.substring(++seperatorIndex);
+	// Writing the records with front coded keys, a full key every KEY_RESTART_INTERVAL records
+	length = 0;
 
-			_print("Get operation successfull");
+	for (int i = 0 ; i < count ; i++)
+	{
+		const char* key = keys + records[i].key;
+		int shared = 0;
 
-			return data;
+		if ((i % KEY_RESTART_INTERVAL) != 0)
+		{
+			const char* previous = keys + records[i - 1].key;
+			int limit = (records[i - 1].keyLength < records[i].keyLength) ? records[i - 1].keyLength : records[i].keyLength;
+
+			limit = (limit < 0xFF) ? limit : 0xFF;
+			shared = dbMismatch(previous, key, limit);
 		}
-		
-	}
-	else
-	{
-		_print("System not initiated");
+
+		if (shared >= KEY_MIN_SHARED)
+		{
+			out[length++] = KEY_SHARED_MARKER;
+			out[length++] = "0123456789abcdef"[shared >> 4];
+			out[length++] = "0123456789abcdef"[shared & 0x0F];
+		}
+		else
+		{
+			shared = 0;
+		}
+
+		memcpy(out + length, key + shared, records[i].keyLength - shared);
+		length = length + (records[i].keyLength - shared);
+		memcpy(out + length, data + records[i].rest, records[i].restLength);
+		length = length + records[i].restLength;
+		out[length++] = '\n';
 	}
 
-	return defaultValue;
+	return out;
 }
+#endif
 
 
 
 
-String EEPROM_Memory::getAll()
+int EEPROM_Memory::_getFilesize()
 {
-	_print("GETALL CALLED");
-	
-    if (_isInitiated)
+	if (!_isInitiated)
 	{
-		String data = "";
-		int fileSize = _getFilesize();
+		return 0;
+	}
 
-		for (int i = 0 ; i < fileSize ; i++)
+	const char* data = _mirror();
+
+	// Free space is filled with new lines, the data ends before the first run of them
+	int i = dbFindRun(data, _EEPROM_SIZE, '\n', 3);
+
+	if (i == -1)
+	{
+#ifdef DEBUG
+		_print("File size:- " + String(_EEPROM_SIZE));
+#endif
+		return _EEPROM_SIZE;
+	}
+
+	// Reverse parsing for removing any extra characters
+	while ((i > 0) && (data[i - 1] == '\n'))
+	{
+		i--;
+	}
+
+#ifdef DEBUG
+	_print("File size:- " + String(i));
+#endif
+	return i;
+}
+
+
+
+
+bool EEPROM_Memory::_readKey(int& idx, int fileSize, Record& record)
+{
+	// Skipping the separators left between records
+	while ((idx < fileSize) && ((_read(idx) == '\n') || (_read(idx) == '\0')))
+	{
+		idx++;
+	}
+
+	if (idx >= fileSize)
+	{
+		return false;
+	}
+
+	record.offset = idx;
+
+	char currentChar = _read(idx);
+
+	if (currentChar == KEY_SHARED_MARKER)
+	{
+		// Front coded key, record.key holds the key of the previous record
+		int shared = (dbHexValue(_read(idx + 1)) << 4) | dbHexValue(_read(idx + 2));
+		record.key = record.key.substring(0, shared);
+		idx = idx + 3;
+		currentChar = _read(idx);
+	}
+	else
+	{
+		record.key = "";
+	}
+
+	while (currentChar != '>')
+	{
+		if ((currentChar == '\n') || (idx >= fileSize))
 		{
-			data = data + String((char)EEPROM.read(i));
+			// Malformed record, no active flag present
+			return false;
 		}
 
-		return data;
+		record.key += currentChar;
+		idx++;
+		currentChar = _read(idx);
 	}
-	else
+
+	record.flagOffset = idx + 1;
+	record.flag = _read(idx + 1);
+	record.expiry = 0;
+	idx = idx + 2;
+
+	if (dbFlagBits(record.flag) & RECORD_EXPIRES)
 	{
-		_print("System not initiated");
+		for (int i = 0 ; i < 8 ; i++)
+		{
+			record.expiry = (record.expiry << 4) | dbHexValue(_read(idx));
+			idx++;
+		}
 	}
 
-	return "";
+	return true;
 }
 
 
 
 
-// TODO: Optimize/defrag memory before inserting data if memory is close to full
-int8_t EEPROM_Memory::insert(const String& key, const String& value)
+void EEPROM_Memory::_readValue(int& idx, int fileSize, ValueDecoder* decoder)
 {
-	_print("INSERT CALLED");
+	bool isValue = false;
 
-    if (_isInitiated)
+	while (idx < fileSize)
 	{
-		String data = key + ">1:" + value + "\n";
-		int fileSize = _getFilesize();
+		char currentChar = _read(idx);
+		idx++;
 
-		// Finding the key index if key already exists
-		int keyIndex = _indexOfKey(key);
+		if (currentChar == '\n')
+		{
+			return;
+		}
 
-		if (keyIndex != -1)
+		if (isValue)
 		{
-			// Key exists, remove that first
-			remove(key);
+			if (decoder != NULL)
+			{
+				decoder->feed(currentChar);
+			}
+		}
+		else if (currentChar == ':')
+		{
+			isValue = true;
 		}
+	}
+}
 
-		// Before writing to file performing optimizations if required
-		int optimize_res = _optimizeMemory(data.length(), fileSize, false);
 
-		if (optimize_res == FAILURE)
-			return FAILURE;
-		else if (optimize_res == MEM_FULL)
-			return MEM_FULL;
 
-		int dataIdx = 0;
-		fileSize = _getFilesize();
 
-		for (int i = fileSize ; i <= (fileSize + data.length()) ; i++)
+bool EEPROM_Memory::_buildDirectory()
+{
+	_print("Building key directory");
+
+	_directory.clear();
+
+	int fileSize = _getFilesize();
+	int idx = 0;
+	Record record;
+
+	while (_readKey(idx, fileSize, record))
+	{
+		// Expired records are kept in the directory until removed, so that inserts can replace them
+		if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && (_directory.find(record.key) == -1))
 		{
-			EEPROM.write(i, (char)data[dataIdx]);
-			dataIdx++;
+			if (!_directory.put(record.key, record.offset))
+			{
+				_print("Memory not available for directory");
+				_directory.clear();
+				return false;
+			}
 		}
 
-		if (EEPROM.commit())
+		_readValue(idx, fileSize, NULL);
+	}
+
+	_directoryBuilt = true;
+
+	return true;
+}
+
+
+
+
+int EEPROM_Memory::_scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context)
+{
+	int visited = 0;
+
+	if (!_directoryBuilt && !_buildDirectory())
+	{
+		return visited;
+	}
+
+	int fileSize = _getFilesize();
+	Record record;
+	String value = "";
+
+	// Binary search for the first key, then reading the records in sorted order
+	for (int pos = _directory.lowerBound(low) ; pos < _directory.size() ; pos++)
+	{
+		const String& key = _directory.keyAt(pos);
+
+		if (isPrefix ? !key.startsWith(low) : (key.compareTo(high) >= 0))
 		{
-			_print("Write operation successful");
-			return SUCCESS;
-		} 
-		else
+			break;
+		}
+
+		int idx = _directory.offsetAt(pos);
+		record.key = key;
+
+		if (!_readKey(idx, fileSize, record))
 		{
-			_print("Write operation failed");
-			return FAILURE;
+			break;
+		}
+
+		if (!dbIsLive(record))
+		{
+			continue;
+		}
+
+		value = "";
+		ValueDecoder decoder(&value, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+		_readValue(idx, fileSize, &decoder);
+		visited++;
+
+		if (!callback(key, value, context))
+		{
+			break;
+		}
+	}
+
+#if defined(DB_STATIC_ARENA)
+	// Directory is kept in the heap, inserts would have to grow it
+	_directory.clear();
+	_directoryBuilt = false;
+#endif
+
+	return visited;
+}
+
+// ************************************************************
+
+
+
+// ****************** PUBLIC METHODS **************************
+bool EEPROM_Memory::begin()
+{
+    _print("Initializing the system");
+
+    if ((_EEPROM_SIZE == 0) || ((_EEPROM_OFFSET + _EEPROM_SIZE) > MAX_EEPROM_SIZE))
+    {
+        _isInitiated = false;
+        return FAILURE;
+    }
+
+    // Setting up EEPROM, other regions may have already set it up with enough size
+    if (EEPROM.length() < (size_t)(_EEPROM_OFFSET + _EEPROM_SIZE))
+    {
+        // Growing reloads the buffer from flash, writes of other regions not committed yet would be lost
+        if (EEPROM.length() > 0)
+        {
+            EEPROM.commit();
+        }
+
+        EEPROM.begin(_EEPROM_OFFSET + _EEPROM_SIZE);
+    }
+
+    _isInitiated = true;
+
+    return SUCCESS;
+}
+
+
+
+
+bool EEPROM_Memory::format()
+{
+    _print("Formatting the system");
+
+    if (_isInitiated)
+	{
+		// Write a new line to all bytes of this region of EEPROM
+		for (int i = 0; i < _EEPROM_SIZE; i++) 
+		{
+			_write(i, '\n');
 		}
+
+		_commit();
+
+		_directory.clear();
+		_directoryBuilt = false;
+		_sweepIdx = 0;
+
+		return SUCCESS;
 	}
 	else
 	{
@@ -408,41 +871,104 @@ int8_t EEPROM_Memory::insert(const String& key, const String& value)
 
 
 
-bool EEPROM_Memory::remove(const String& key)
+bool EEPROM_Memory::clear()
 {
-	_print("REMOVE CALLED");
-	
-    if (_isInitiated)
+	_print("Clearing the region");
+
+	return format();
+}
+
+
+
+
+int8_t EEPROM_Memory::optimize()
+{
+	return _optimizeMemory(0, _getFilesize(), true);
+}
+
+
+
+
+void EEPROM_Memory::setCompression(uint16_t minSize)
+{
+	_compressMinSize = minSize;
+}
+
+
+
+
+void EEPROM_Memory::setDeferredCommit(bool defer)
+{
+	_deferCommit = defer;
+}
+
+
+
+
+bool EEPROM_Memory::commit()
+{
+	if (!_commitPending)
 	{
-		// Searching for key index
-		int keyIndex = _indexOfKey(key);
+		return SUCCESS;
+	}
 
-		_print(String(keyIndex));
+	_commitPending = false;
+
+	return EEPROM.commit();
+}
+
+
+
+
+String EEPROM_Memory::get(const DbKey& key, const String& defaultValue)
+{
+	bool found;
+
+	return get(key, defaultValue, found);
+}
+
+
+
+
+String EEPROM_Memory::get(const DbKey& key, const String& defaultValue, bool& found)
+{
+	_print("GET CALLED");
+
+	found = false;
+
+    if (_isInitiated)
+	{
+		int keyIndex = _indexOfKey(key, false);
 
 		if (keyIndex == -1)
 		{
-			// Key does not exists
-			_print("Key not found");
-			return FAILURE;
+			return defaultValue;
 		}
 		else
 		{
-			// Key exists
-			int idx = keyIndex;
-			char currentChar = (char)EEPROM.read(idx);
+			found = true;
+
+			String data = "";
+			int length = 0;
+			Record record;
+			int valueIdx = _valueOf(keyIndex, _getFilesize(), record, length);
 
-			while (currentChar != '>')
+			if (valueIdx != -1)
 			{
-				idx++;
-				currentChar = (char)EEPROM.read(idx);
-			}
+				const char* value = _mirror() + valueIdx;
+				ValueDecoder decoder(&data, dbFlagBits(record.flag) & RECORD_COMPRESSED);
 
-			EEPROM.write(idx + 1, '0');
+				data.reserve(length);
 
-			if (EEPROM.commit())
-			{
-				return SUCCESS;
+				for (int i = 0 ; i < length ; i++)
+				{
+					decoder.feed(value[i]);
+				}
 			}
+
+			_print("Get operation successfull");
+
+			return data;
 		}
 		
 	}
@@ -451,35 +977,928 @@ bool EEPROM_Memory::remove(const String& key)
 		_print("System not initiated");
 	}
 
-	return FAILURE;
+	return defaultValue;
 }
 
 
 
 
-bool EEPROM_Memory::exists(const String& key)
+int EEPROM_Memory::get(const DbKey& key, char* buffer, size_t bufferSize)
 {
-	_print("EXISTS CALLED");
+	_print("GET CALLED");
+
+	if ((buffer == NULL) || (bufferSize == 0))
+	{
+		return -1;
+	}
+
+	buffer[0] = '\0';
 
 	if (_isInitiated)
 	{
-		int idx = _indexOfKey(key);
+		int keyIndex = _indexOfKey(key, false);
 
-		if (idx != -1)
+		if (keyIndex == -1)
 		{
-			return SUCCESS;
+			return -1;
 		}
-		else
+
+		int length = 0;
+		Record record;
+		int valueIdx = _valueOf(keyIndex, _getFilesize(), record, length);
+
+		if (valueIdx == -1)
 		{
-			return FAILURE;
+			return -1;
+		}
+
+		const char* value = _mirror() + valueIdx;
+
+		// Leaving space for the null character
+		ValueDecoder decoder(buffer, bufferSize - 1, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+
+		for (int i = 0 ; (i < length) && !decoder.isFull() ; i++)
+		{
+			decoder.feed(value[i]);
 		}
+
+		buffer[decoder.length()] = '\0';
+
+		return decoder.length();
 	}
 	else
 	{
 		_print("System not initiated");
 	}
 
-	return FAILURE;
+	return -1;
+}
+
+
+
+
+bool EEPROM_Memory::getView(const DbKey& key, const char*& value, size_t& length)
+{
+	_print("GETVIEW CALLED");
+
+	if (_isInitiated)
+	{
+		int keyIndex = _indexOfKey(key, false);
+
+		if (keyIndex == -1)
+		{
+			return FAILURE;
+		}
+
+		int valueLength = 0;
+		Record record;
+		int valueIdx = _valueOf(keyIndex, _getFilesize(), record, valueLength);
+
+		// Compressed values have to be decoded, they can not be viewed
+		if ((valueIdx == -1) || (dbFlagBits(record.flag) & RECORD_COMPRESSED))
+		{
+			return FAILURE;
+		}
+
+		value = _mirror() + valueIdx;
+		length = valueLength;
+
+		return SUCCESS;
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+String EEPROM_Memory::getAll()
+{
+	_print("GETALL CALLED");
+	
+    if (_isInitiated)
+	{
+		String data = "";
+		int fileSize = _getFilesize();
+		const char* mirror = _mirror();
+
+		data.reserve(fileSize);
+
+		for (int i = 0 ; i < fileSize ; i++)
+		{
+			if (mirror[i] != '\0')
+			{
+				data += mirror[i];
+			}
+		}
+
+		return dbDecodeRecords(data);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return "";
+}
+
+
+
+
+int EEPROM_Memory::getMany(const String keys[], String values[], int count, const String& defaultValue, bool found[])
+{
+	_print("GETMANY CALLED");
+
+	int foundCount = 0;
+
+	for (int i = 0 ; i < count ; i++)
+	{
+		values[i] = defaultValue;
+
+		if (found != NULL)
+		{
+			found[i] = false;
+		}
+	}
+
+	if (_isInitiated)
+	{
+		KeyLookup lookup(keys, count);
+		int distinct = lookup.distinctCount();
+		int fileSize = _getFilesize();
+		int idx = 0;
+		Record record;
+
+		// Single pass over the memory, stopping early once all keys are found
+		while ((foundCount < distinct) && _readKey(idx, fileSize, record))
+		{
+			int keyIdx = dbIsLive(record) ? lookup.find(record.key) : -1;
+
+			if (keyIdx != -1)
+			{
+				values[keyIdx] = "";
+				ValueDecoder decoder(&values[keyIdx], dbFlagBits(record.flag) & RECORD_COMPRESSED);
+				_readValue(idx, fileSize, &decoder);
+				foundCount++;
+
+				if (found != NULL)
+				{
+					found[keyIdx] = true;
+				}
+			}
+			else
+			{
+				_readValue(idx, fileSize, NULL);
+			}
+		}
+
+		// Copying values for the keys requested more than once
+		for (int i = 0 ; i < count ; i++)
+		{
+			int keyIdx = lookup.find(keys[i]);
+
+			if (keyIdx != i)
+			{
+				values[i] = values[keyIdx];
+
+				if (found != NULL)
+				{
+					found[i] = found[keyIdx];
+				}
+			}
+		}
+
+#ifdef DEBUG
+		_print("Keys found: " + String(foundCount));
+#endif
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return foundCount;
+}
+
+
+
+
+// TODO: Optimize/defrag memory before inserting data if memory is close to full
+int8_t EEPROM_Memory::insert(const DbKey& key, const String& value)
+{
+	return insert(key, value, 0);
+}
+
+
+
+
+int8_t EEPROM_Memory::insert(const DbKey& key, const String& value, uint32_t ttlSeconds)
+{
+	return insertAt(key, value, (ttlSeconds > 0) ? (dbNow() + ttlSeconds) : 0);
+}
+
+
+
+
+int8_t EEPROM_Memory::insertAt(const DbKey& key, const String& value, uint32_t expiry)
+{
+	_print("INSERT CALLED");
+
+    if (_isInitiated)
+	{
+#if defined(DB_STATIC_ARENA)
+		// Building the record in the static arena, values are not compressed
+		DbArenaScope scope;
+		char* data = (char*)dbArenaAlloc(key.length() + value.length() + RECORD_MAX_OVERHEAD);
+
+		if (data == NULL)
+		{
+			_print("Arena too small for the value, increase DB_ARENA_SIZE");
+			return FAILURE;
+		}
+
+		int dataLength = dbEncodeRecordTo(data, key, value, expiry);
+#else
+		String data = dbEncodeRecordAt(key, value, expiry, _compressMinSize);
+		int dataLength = data.length();
+#endif
+
+		int fileSize = _getFilesize();
+
+		// Finding the key index if key already exists, expired records are replaced as well
+		int keyIndex = _indexOfKey(key, true);
+
+		if (keyIndex != -1)
+		{
+			// Key exists, remove that first
+			remove(key);
+		}
+
+		// Before writing to file performing optimizations if required
+		int optimize_res = _optimizeMemory(dataLength, fileSize, false);
+
+		if (optimize_res == FAILURE)
+			return FAILURE;
+		else if (optimize_res == MEM_FULL)
+			return MEM_FULL;
+
+		fileSize = _getFilesize();
+
+		for (int i = 0 ; i < dataLength ; i++)
+		{
+			_write(fileSize + i, data[i]);
+		}
+
+		_write(fileSize + dataLength, '\0');
+
+		if (_directoryBuilt)
+		{
+			_directory.put(key.c_str(), fileSize);
+		}
+
+		if (_commit())
+		{
+			_print("Write operation successful");
+			return SUCCESS;
+		} 
+		else
+		{
+			_print("Write operation failed");
+			return FAILURE;
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+int8_t EEPROM_Memory::putMany(const String keys[], const String values[], int count)
+{
+	return putMany(keys, values, NULL, NULL, count);
+}
+
+
+
+
+int8_t EEPROM_Memory::putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count)
+{
+	if (ttlSeconds == NULL)
+	{
+		return putManyAt(keys, values, NULL, removed, count);
+	}
+
+	uint32_t* expiries = new uint32_t[count];
+	dbExpiryTimes(ttlSeconds, expiries, count);
+
+	int8_t result = putManyAt(keys, values, expiries, removed, count);
+
+	delete[] expiries;
+
+	return result;
+}
+
+
+
+
+int8_t EEPROM_Memory::putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count)
+{
+	_print("PUTMANY CALLED");
+
+	if (_isInitiated)
+	{
+		KeyLookup lookup(keys, count);
+		int idx = 0;
+		Record record;
+		String data = "";
+		int* offsets = new int[count];
+
+		for (int i = 0 ; i < count ; i++)
+		{
+			// Only the last value of a repeated key is stored, offsets are relative to the start of data
+			if ((lookup.find(keys[i]) == i) && !((removed != NULL) && removed[i]))
+			{
+				offsets[i] = data.length();
+				data = data + dbEncodeRecordAt(keys[i], values[i], (expiries != NULL) ? expiries[i] : 0, _compressMinSize);
+			}
+		}
+
+		// Before changing any record performing optimizations if required, so nothing is changed if the values do not fit
+		int optimize_res = _optimizeMemory(data.length(), _getFilesize(), false);
+
+		if (optimize_res != SUCCESS)
+		{
+			delete[] offsets;
+			return optimize_res;
+		}
+
+		int fileSize = _getFilesize();
+
+		// Single pass over the memory, de-activating the existing records of all the keys
+		while (_readKey(idx, fileSize, record))
+		{
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && (lookup.find(record.key) != -1))
+			{
+				_write(record.flagOffset, '0');
+			}
+
+			_readValue(idx, fileSize, NULL);
+		}
+
+		for (unsigned int i = 0 ; i < data.length() ; i++)
+		{
+			_write(fileSize + i, data[i]);
+		}
+
+		_write(fileSize + data.length(), '\0');
+
+		if (_directoryBuilt)
+		{
+			for (int i = 0 ; i < count ; i++)
+			{
+				if (lookup.find(keys[i]) != i)
+				{
+					continue;
+				}
+
+				if ((removed != NULL) && removed[i])
+				{
+					_directory.erase(keys[i]);
+				}
+				else
+				{
+					_directory.put(keys[i], fileSize + offsets[i]);
+				}
+			}
+		}
+
+		delete[] offsets;
+
+		// Single commit for all the key value pairs
+		if (_commit())
+		{
+			_print("Write operation successful");
+			return SUCCESS;
+		}
+		else
+		{
+			_print("Write operation failed");
+			return FAILURE;
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+bool EEPROM_Memory::remove(const DbKey& key)
+{
+	_print("REMOVE CALLED");
+	
+    if (_isInitiated)
+	{
+		// Searching for key index
+		int keyIndex = _indexOfKey(key, true);
+
+#ifdef DEBUG
+		_print(String(keyIndex));
+#endif
+
+		if (keyIndex == -1)
+		{
+			// Key does not exists
+			_print("Key not found");
+			return FAILURE;
+		}
+		else
+		{
+			// Key exists, an expired record is de-activated as well but the key was not found for the caller
+			Record record;
+			int length = 0;
+
+			if (_valueOf(keyIndex, _getFilesize(), record, length) == -1)
+			{
+				return FAILURE;
+			}
+
+			_write(record.flagOffset, '0');
+
+			if (_directoryBuilt)
+			{
+				_directory.erase(key);
+			}
+
+			if (_commit())
+			{
+				return dbIsLive(record) ? SUCCESS : FAILURE;
+			}
+		}
+		
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+bool EEPROM_Memory::exists(const DbKey& key)
+{
+	_print("EXISTS CALLED");
+
+	if (_isInitiated)
+	{
+		int idx = _indexOfKey(key, false);
+
+		if (idx != -1)
+		{
+			return SUCCESS;
+		}
+		else
+		{
+			return FAILURE;
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+uint32_t EEPROM_Memory::expiresAt(const DbKey& key)
+{
+	_print("EXPIRESAT CALLED");
+
+	if (_isInitiated)
+	{
+		int idx = _indexOfKey(key, false);
+		int length = 0;
+		Record record;
+
+		if ((idx != -1) && (_valueOf(idx, _getFilesize(), record, length) != -1))
+		{
+			return record.expiry;
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int EEPROM_Memory::sweep(int maxRecords)
+{
+	_print("SWEEP CALLED");
+
+	int removed = 0;
+
+	if (_isInitiated)
+	{
+		int fileSize = _getFilesize();
+		int idx = (_sweepIdx < fileSize) ? _sweepIdx : 0;
+		Record record;
+
+#if defined(DB_STATIC_ARENA)
+		// Reading only the flags and expiry times in the RAM mirror, the keys are not decoded
+		const char* data = _mirror();
+		int length = 0;
+
+		for (int i = 0 ; i < maxRecords ; i++)
+		{
+			while ((idx < fileSize) && ((data[idx] == '\n') || (data[idx] == '\0')))
+			{
+				idx++;
+			}
+
+			int valueIdx = (idx < fileSize) ? _valueOf(idx, fileSize, record, length) : -1;
+
+			if (valueIdx == -1)
+			{
+				// End of data, next sweep starts from the beginning
+				idx = 0;
+				break;
+			}
+
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && !dbIsLive(record))
+			{
+				_write(record.flagOffset, '0');
+				removed++;
+			}
+
+			idx = valueIdx + length + 1;
+		}
+
+		// Directory is kept in the heap, it is dropped instead of erasing the keys
+		if ((removed > 0) && _directoryBuilt)
+		{
+			_directory.clear();
+			_directoryBuilt = false;
+		}
+#else
+		record.key = (idx > 0) ? _sweepKey : "";
+
+		for (int i = 0 ; i < maxRecords ; i++)
+		{
+			if (!_readKey(idx, fileSize, record))
+			{
+				// End of data, next sweep starts from the beginning
+				idx = 0;
+				break;
+			}
+
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && !dbIsLive(record))
+			{
+				_write(record.flagOffset, '0');
+				removed++;
+
+				if (_directoryBuilt)
+				{
+					_directory.erase(record.key);
+				}
+			}
+
+			_readValue(idx, fileSize, NULL);
+		}
+
+		_sweepKey = record.key;
+#endif
+
+		_sweepIdx = idx;
+
+		if (removed > 0)
+		{
+			_commit();
+		}
+
+#ifdef DEBUG
+		_print("Expired records removed: " + String(removed));
+#endif
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return removed;
+}
+
+
+
+
+DbUsage EEPROM_Memory::getUsage()
+{
+	DbUsage usage;
+
+	usage.capacity = capacity();
+	usage.usedBytes = 0;
+	usage.liveBytes = 0;
+	usage.deadBytes = 0;
+
+	if (_isInitiated)
+	{
+		int fileSize = _getFilesize();
+		int idx = 0;
+		Record record;
+		record.key = "";
+
+		while (_readKey(idx, fileSize, record))
+		{
+			_readValue(idx, fileSize, NULL);
+
+			// The new line of the last record is not counted in the size
+			int length = ((idx < fileSize) ? idx : fileSize) - record.offset;
+
+			if (dbIsLive(record))
+			{
+				usage.liveBytes = usage.liveBytes + length;
+			}
+			else
+			{
+				usage.deadBytes = usage.deadBytes + length;
+			}
+		}
+
+		usage.usedBytes = fileSize;
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return usage;
+}
+
+
+
+
+uint32_t EEPROM_Memory::capacity()
+{
+	// Last bytes are kept for the new lines ending the data
+	return _EEPROM_SIZE - 5;
+}
+
+
+
+
+uint32_t EEPROM_Memory::freeSpace()
+{
+	uint32_t fileSize = _getFilesize();
+
+	return (capacity() > fileSize) ? (capacity() - fileSize) : 0;
+}
+
+
+
+
+bool EEPROM_Memory::buildDirectory()
+{
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	return _directoryBuilt || _buildDirectory();
+}
+
+
+
+
+int EEPROM_Memory::scanPrefix(const String& prefix, ScanCallback callback, void* context)
+{
+	_print("SCANPREFIX CALLED");
+
+	if (_isInitiated)
+	{
+		return _scan(prefix, "", true, callback, context);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int EEPROM_Memory::scanRange(const String& low, const String& high, ScanCallback callback, void* context)
+{
+	_print("SCANRANGE CALLED");
+
+	if (_isInitiated)
+	{
+		return _scan(low, high, false, callback, context);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int EEPROM_Memory::exportTo(BackupWriter& writer)
+{
+	_print("EXPORT CALLED");
+
+	int exported = 0;
+
+	if (_isInitiated)
+	{
+		int fileSize = _getFilesize();
+		int idx = 0;
+		Record record;
+		String value = "";
+
+		// Single pass over the memory, only one value is held in RAM at a time
+		while (_readKey(idx, fileSize, record))
+		{
+			if (!dbIsLive(record))
+			{
+				_readValue(idx, fileSize, NULL);
+				continue;
+			}
+
+			value = "";
+			ValueDecoder decoder(&value, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+			_readValue(idx, fileSize, &decoder);
+
+			writer.add(record.key, value, record.expiry);
+			exported++;
+		}
+
+#ifdef DEBUG
+		_print("Records exported: " + String(exported));
+#endif
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return exported;
+}
+
+
+
+
+int8_t EEPROM_Memory::importFrom(Stream& in)
+{
+	_print("IMPORT CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	BackupReader reader(in);
+	String data = "";
+	String key;
+	String value;
+	uint32_t expiry;
+	uint32_t now = dbNow();
+	bool full = false;
+
+	// Staging the records in RAM, the region is written only once the whole backup is checked
+	while (reader.next(key, value, expiry))
+	{
+		if (full || ((expiry != 0) && (expiry <= now)))
+		{
+			continue;
+		}
+
+		data += dbEncodeRecordAt(key, value, expiry, _compressMinSize);
+
+		if (data.length() > (unsigned int)(_EEPROM_SIZE - 5))
+		{
+			// Reading the rest anyway, so that a corrupted backup is still reported as such
+			full = true;
+			data = "";
+		}
+	}
+
+	if (!reader.isValid())
+	{
+		_print("Backup incomplete or corrupted");
+		return FAILURE;
+	}
+
+	if (full)
+	{
+		_print("Memory full, backup does not fit");
+		return MEM_FULL;
+	}
+
+	// Written sorted with front coded keys as after optimize, repeated keys keep their last value
+	String newData = dbCompactRecords(data);
+	data = "";
+
+	_directory.clear();
+	_directoryBuilt = false;
+
+	return _replaceData(newData);
+}
+
+
+
+
+int8_t EEPROM_Memory::load(BulkLoader& loader)
+{
+	_print("LOAD CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	if (!loader.rewind())
+	{
+		return FAILURE;
+	}
+
+	String data = "";
+	String key;
+	String value;
+	String previousKey = "";
+	int written = 0;
+	bool indexed = true;
+	bool full = false;
+
+	_directory.clear();
+	_directoryBuilt = false;
+
+	// Pairs come sorted and without repeated keys, so the records are written as compaction writes them
+	// and every key is appended to the end of the directory
+	while (!full && loader.next(key, value))
+	{
+		String record = dbEncodeRecord(key, value, 0, _compressMinSize);
+
+		if (indexed && !_directory.put(key, data.length()))
+		{
+			_print("Memory not available for directory");
+			_directory.clear();
+			indexed = false;
+		}
+
+		data += ((written % KEY_RESTART_INTERVAL) == 0) ? key : dbEncodeKey(previousKey, key);
+		data += record.substring(key.length());
+		previousKey = key;
+		written++;
+
+		full = data.length() > (unsigned int)(_EEPROM_SIZE - 5);
+	}
+
+	if (full || !loader.isValid())
+	{
+		_directory.clear();
+		_print(full ? "Memory full, pairs do not fit" : "Bulk load failed");
+		return full ? MEM_FULL : FAILURE;
+	}
+
+	int8_t result = _replaceData(data);
+	_directoryBuilt = indexed;
+
+#ifdef DEBUG
+	_print("Pairs loaded: " + String(written));
+#endif
+
+	return result;
 }
 
 // ************************************************************
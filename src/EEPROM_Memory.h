@@ -11,6 +11,13 @@
 #include "Arduino.h"
 #include <EEPROM.h>
 #include "Config.h"
+#include "DbUtils.h"
+#include "KeyDirectory.h"
+#include "Compression.h"
+#include "ScanKernel.h"
+#include "Backup.h"
+#include "BulkLoader.h"
+#include "DbArena.h"
 
 // Possible failure and success values
 // #define FAILURE false
@@ -20,21 +27,81 @@ class EEPROM_Memory
 {
     private:
         uint16_t _EEPROM_SIZE;
+        uint16_t _EEPROM_OFFSET;
         bool _isInitiated;
 
+        KeyDirectory _directory;
+        bool _directoryBuilt;
+
+        int _sweepIdx;      // index from where the next sweep for expired records starts
+#if !defined(DB_STATIC_ARENA)
+        String _sweepKey;   // key of the record before _sweepIdx, for decoding front coded keys
+#endif
+        uint16_t _compressMinSize;  // values of at least this length are stored compressed, 0 for never
+        bool _deferCommit;          // writes are committed only by commit, not by every operation
+        bool _commitPending;        // writes not committed yet because of _deferCommit
+
         /**
          * This function will just print the message to the Serial if DEBUG is 1
          * @param msg The message to print in Serial
          */
         void _print(const String& msg);
 
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1, without building a String
+         * @param msg The message to print in Serial
+         */
+        void _print(const char* msg);
+
+        /**
+         * This will commit the writes to flash, or only note them if commits are deferred
+         * @param null
+         * @return SUCCESS if committed or deferred
+         * @return FAILURE otherwise
+         */
+        bool _commit();
+
+        /**
+         * This will read a byte from this region of EEPROM memory
+         * @param idx index of the byte within the region
+         * @return byte at the index
+         */
+        char _read(int idx);
+
+        /**
+         * This will return the first byte of this region in the RAM mirror of EEPROM memory
+         * Note- The mirror may move when EEPROM is initialized again, do not keep the pointer
+         * @param null
+         * @return pointer to the first byte of the region
+         */
+        const char* _mirror();
+
+        /**
+         * This will parse the header of the record directly in the RAM mirror, without copying its key
+         * @param idx index of the first byte of the record
+         * @param fileSize number of bytes occupied by the data
+         * @param record Record to hold the offsets, flag and expiry of the record, its key is not set
+         * @param length to hold the number of bytes of the stored value
+         * @return index of the first byte of the stored value
+         * @return -1 if the record is malformed
+         */
+        int _valueOf(int idx, int fileSize, Record& record, int& length);
+
+        /**
+         * This will write a byte to this region of EEPROM memory, commit is required to save it
+         * @param idx index of the byte within the region
+         * @param value byte to write
+         */
+        void _write(int idx, char value);
+
         /**
          * This will return the index at which key is available
          * @param key the key whose index is to be searched
+         * @param includeExpired set to true for finding the key even if its record has expired
          * @return index of key if found
          * @return -1 if key index not found
          */
-        int _indexOfKey(const String& key);
+        int _indexOfKey(const DbKey& key, bool includeExpired);
 
          /**
          * This method will perform memory optimization if required by checking the space needed for new data
@@ -47,6 +114,27 @@ class EEPROM_Memory
          */
         int8_t _optimizeMemory(int spaceRequired, int fileSize, bool forceOptimize);
 
+        /**
+         * This will replace all the data of the region with the given records and commit it,
+         * the directory is not changed
+         * @param data records as stored
+         * @return SUCCESS if committed
+         * @return FAILURE otherwise
+         */
+        int8_t _replaceData(const String& data);
+
+#if defined(DB_STATIC_ARENA)
+        /**
+         * This will build the compacted records in the static arena, dropping removed and expired records
+         * and writing the rest sorted with front coded keys, as dbCompactRecords does
+         * @param fileSize current total size used by the records (in bytes)
+         * @param length to hold the number of bytes of the compacted records
+         * @return compacted records, valid until the arena is released
+         * @return NULL if the arena is too small
+         */
+        char* _compactToArena(int fileSize, int& length);
+#endif
+
 		/**
 		 * To calculate the size occupied by EEPROM stored data in EEPROM memory 
 		 * @param null
@@ -54,6 +142,44 @@ class EEPROM_Memory
 		 */
         int _getFilesize();
 
+        /**
+         * This will read the key and active flag of the next record in the memory
+         * @param idx index to start reading from, moved past the active flag of the record
+         * @param fileSize number of bytes occupied by the data
+         * @param record Record to hold the details of the record read, for reading front coded keys
+         *               its key must hold the key of the previous record or the key expected at this index
+         * @return true if a record was read
+         * @return false if no more records are available
+         */
+        bool _readKey(int& idx, int fileSize, Record& record);
+
+        /**
+         * This will read the value of the record whose key was just read using _readKey
+         * @param idx index just after the active flag, moved to the start of the next record
+         * @param fileSize number of bytes occupied by the data
+         * @param decoder decoder writing the value, pass NULL for skipping the value
+         */
+        void _readValue(int& idx, int fileSize, ValueDecoder* decoder);
+
+        /**
+         * This will build the sorted directory of the active keys using a single scan of the memory
+         * @param null
+         * @return true if directory built successfully
+         * @return false if memory for the directory is not available
+         */
+        bool _buildDirectory();
+
+        /**
+         * This will call callback for the keys in the directory starting from low, in sorted order
+         * @param low the first key to visit, or the prefix of the keys to visit
+         * @param high the keys not less than high are not visited, not used for prefix scan
+         * @param isPrefix set to true to visit only the keys starting with low
+         * @param callback function called for every key value pair
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int _scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context);
+
 
     public:
         /**
@@ -63,6 +189,15 @@ class EEPROM_Memory
          */
         EEPROM_Memory(int EEPROMSize);
 
+        /**
+         * Constructor for initializing class object for using a region of EEPROM memory,
+         * multiple objects with separate regions can share the EEPROM memory
+         * @param EEPROMSize size of the region you want to use for Database storage(in bytes)
+         * @param EEPROMOffset index of the first byte of the region
+         * @return null
+         */
+        EEPROM_Memory(int EEPROMSize, int EEPROMOffset);
+
          /**
          * This method will handle the initialization of the library
          * Note- Must be called within setup only once
@@ -78,6 +213,13 @@ class EEPROM_Memory
          */
         bool format();
 
+        /**
+         * This method will remove all the data stored in this region of the memory
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
         /**
          * Call this method to optimize the database forcefully
          * @param null
@@ -86,6 +228,28 @@ class EEPROM_Memory
          */
         int8_t optimize();
 
+        /**
+         * This method will enable compression of values for the following inserts, values
+         * which do not get smaller are stored as it is. Existing values are read either way
+         * @param minSize values of at least this length (in bytes) are compressed, 0 to disable
+         */
+        void setCompression(uint16_t minSize);
+
+        /**
+         * This method will defer the commits of the following writes until commit is called, so several
+         * operations are written to flash together and the slow flash write is kept out of locked sections
+         * @param defer set to true to defer the commits, false to commit on every operation again
+         */
+        void setDeferredCommit(bool defer);
+
+        /**
+         * This method will commit the writes whose commit was deferred
+         * @param null
+         * @return SUCCESS if committed or nothing to commit
+         * @return FAILURE otherwise
+         */
+        bool commit();
+
         /**
          * This method will return the value associated with key
          * @param key key for which value is required
@@ -93,7 +257,40 @@ class EEPROM_Memory
          * @return value associated with key if found
          * @return defaultValue otherwise
          */
-        String get(const String& key, const String& defaultValue);
+        String get(const DbKey& key, const String& defaultValue);
+
+        /**
+         * This method will return the value associated with key, telling a missing key apart from a value equal to defaultValue
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @param found set to true if the key was found, false otherwise
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const DbKey& key, const String& defaultValue, bool& found);
+
+        /**
+         * This method will copy the value associated with key into buffer, decompressing it on the fly
+         * without building the whole value in memory. Values longer than the buffer are truncated
+         * @param key key for which value is required
+         * @param buffer buffer to hold the value, always null terminated
+         * @param bufferSize size of buffer (in bytes)
+         * @return length of the value copied into buffer
+         * @return -1 if key not found
+         */
+        int get(const DbKey& key, char* buffer, size_t bufferSize);
+
+        /**
+         * This method will return the value associated with key without copying it, pointing
+         * directly into the RAM mirror of EEPROM memory. The value is not null terminated and
+         * is valid only until the next insert, remove, optimize or format
+         * @param key key for which value is required
+         * @param value to hold the pointer to the first byte of the value
+         * @param length to hold the number of bytes of the value
+         * @return SUCCESS if key found
+         * @return FAILURE if key not found or the value is stored compressed
+         */
+        bool getView(const DbKey& key, const char*& value, size_t& length);
 
         /**
          * This method will return all the stored key value pairs
@@ -102,6 +299,17 @@ class EEPROM_Memory
          */
         String getAll();
 
+        /**
+         * This method will return the values associated with multiple keys using a single scan of the memory
+         * @param keys array of keys for which values are required
+         * @param values array to hold the values, must have space for count values
+         * @param count number of keys
+         * @param defaultValue default value to store for keys not found
+         * @param found optional array set to true for the keys found, must have space for count flags
+         * @return number of keys found
+         */
+        int getMany(const String keys[], String values[], int count, const String& defaultValue, bool found[] = NULL);
+
         /**
          * This method will insert the data into the database
          * @param key unique key for the value
@@ -109,15 +317,73 @@ class EEPROM_Memory
          * @return SUCCESS if value inserted successfully
          * @return FAILURE is value insertion failed
          */
-        int8_t insert(const String& key, const String& value);
+        int8_t insert(const DbKey& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         */
+        int8_t insert(const DbKey& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will insert the data into the database, which expires at the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param expiry time at which the key expires (as returned by dbNow), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if space for the value is not available
+         */
+        int8_t insertAt(const DbKey& key, const String& value, uint32_t expiry);
+
+        /**
+         * This method will insert multiple key value pairs using a single scan of the memory and a single commit
+         * @param keys array of unique keys, for repeated keys the last value is kept
+         * @param values array of values associated with the keys
+         * @param count number of key value pairs
+         * @return SUCCESS if values inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putMany(const String keys[], const String values[], int count);
+
+        /**
+         * This method will insert and remove multiple keys using a single scan of the memory and a single commit, as a group of changes
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count);
+
+        /**
+         * This method will insert and remove multiple keys as putMany does, with the times at which the keys expire
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param expiries array of times at which the keys expire (as returned by dbNow, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count);
 
         /**
          * This method will remove the key and associated value from db
          * @param key key to be removed
-         * @return FAILURE if fails or key not found
+         * @return FAILURE if fails or key not found, an expired key is not found but its data is removed
          * @return SUCCESS if key removed successfully
          */
-        bool remove(const String& key);
+        bool remove(const DbKey& key);
 
         /**
          * This method will tell weather the key exists or not in the database
@@ -125,7 +391,103 @@ class EEPROM_Memory
          * @return SUCCESS if key found
          * @return FAILURE is key not found
          */
-        bool exists(const String& key);
+        bool exists(const DbKey& key);
+
+        /**
+         * This method will return the time at which the key expires
+         * @param key key to search for
+         * @return expiry time in seconds
+         * @return 0 if the key never expires or is not found
+         */
+        uint32_t expiresAt(const DbKey& key);
+
+        /**
+         * This method will remove the expired records, checking at most maxRecords records per call.
+         * Every call continues from where the previous one stopped
+         * @param maxRecords maximum number of records to check
+         * @return number of expired records removed
+         */
+        int sweep(int maxRecords);
+
+        /**
+         * This method will count the bytes used by live records and by removed or expired records, with a single scan
+         * @param null
+         * @return usage of the memory
+         */
+        DbUsage getUsage();
+
+        /**
+         * This method will return the bytes of the region usable for records
+         * @param null
+         * @return capacity (in bytes)
+         */
+        uint32_t capacity();
+
+        /**
+         * This method will return the bytes that can still be appended before the region has to be compacted
+         * @param null
+         * @return free space (in bytes)
+         */
+        uint32_t freeSpace();
+
+        /**
+         * This method will build the sorted directory of the active keys used by the scans, if not already built
+         * Note- Scans build it on first use, building it beforehand lets scans run without modifying the object
+         * @param null
+         * @return true if the directory is built
+         * @return false if memory for the directory is not available
+         */
+        bool buildDirectory();
+
+        /**
+         * This method will call callback for every key starting with prefix, in sorted order of keys
+         * Note- The callback must not modify the database
+         * @param prefix prefix of the keys to visit
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanPrefix(const String& prefix, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will call callback for every key from low (inclusive) to high (exclusive), in sorted order of keys
+         * Note- The callback must not modify the database
+         * @param low the first key of the range
+         * @param high the end of the range, this key is not visited
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanRange(const String& low, const String& high, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will add the live records to a backup (see Backup.h), one record at a time
+         * @param writer backup to add the records to, finish it after all the records are added
+         * @return number of key value pairs added
+         */
+        int exportTo(BackupWriter& writer);
+
+        /**
+         * This method will replace all the data of this region with the records of a backup written by exportTo.
+         * The records are checked and compacted in RAM and written with a single commit, the data is not touched
+         * if the backup is corrupted or does not fit. Expired records of the backup are dropped
+         * @param in where the backup is read from
+         * @return SUCCESS if the backup was loaded
+         * @return FAILURE if the backup is incomplete or corrupted
+         * @return MEM_FULL if the records do not fit in the region
+         */
+        int8_t importFrom(Stream& in);
+
+        /**
+         * This method will replace all the data of this region with the pairs of a bulk loader. The records are
+         * written sorted with front coded keys and a single commit, and the key directory is built while writing.
+         * The data is not touched if the pairs do not fit
+         * @param loader loader holding the pairs
+         * @return SUCCESS if the pairs were loaded
+         * @return FAILURE if the pairs of the loader could not be read
+         * @return MEM_FULL if the pairs do not fit in the region
+         */
+        int8_t load(BulkLoader& loader);
 
 };
 
@@ -0,0 +1,245 @@
+/*
+    KeyDirectory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "KeyDirectory.h"
+
+/**
+ * Constructor of the directory
+ */
+KeyDirectory::KeyDirectory()
+{
+	_keys = NULL;
+	_offsets = NULL;
+	_size = 0;
+	_capacity = 0;
+}
+
+
+
+
+KeyDirectory::KeyDirectory(const KeyDirectory& other)
+{
+	_keys = NULL;
+	_offsets = NULL;
+	_size = 0;
+	_capacity = 0;
+
+	*this = other;
+}
+
+
+
+
+KeyDirectory& KeyDirectory::operator=(const KeyDirectory& other)
+{
+	if (this != &other)
+	{
+		clear();
+
+		for (int i = 0 ; i < other._size ; i++)
+		{
+			if ((_size == _capacity) && !_grow())
+			{
+				break;
+			}
+
+			_keys[_size] = other._keys[i];
+			_offsets[_size] = other._offsets[i];
+			_size++;
+		}
+	}
+
+	return *this;
+}
+
+
+
+
+KeyDirectory::~KeyDirectory()
+{
+	clear();
+}
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+bool KeyDirectory::_grow()
+{
+	int capacity = (_capacity == 0) ? 16 : (_capacity * 2);
+	String* keys = new String[capacity];
+	int* offsets = new int[capacity];
+
+	if ((keys == NULL) || (offsets == NULL))
+	{
+		delete[] keys;
+		delete[] offsets;
+		return false;
+	}
+
+	for (int i = 0 ; i < _size ; i++)
+	{
+		keys[i] = _keys[i];
+		offsets[i] = _offsets[i];
+	}
+
+	delete[] _keys;
+	delete[] _offsets;
+
+	_keys = keys;
+	_offsets = offsets;
+	_capacity = capacity;
+
+	return true;
+}
+
+
+
+
+int KeyDirectory::_compare(const String& stored, const DbKey& key)
+{
+	int length = (stored.length() < key.length()) ? stored.length() : key.length();
+	int res = memcmp(stored.c_str(), key.c_str(), length);
+
+	// Same order as String::compareTo, a key sorts after its prefixes
+	return (res != 0) ? res : ((int)stored.length() - (int)key.length());
+}
+
+// ************************************************************
+
+
+
+// ****************** PUBLIC METHODS **************************
+void KeyDirectory::clear()
+{
+	delete[] _keys;
+	delete[] _offsets;
+
+	_keys = NULL;
+	_offsets = NULL;
+	_size = 0;
+	_capacity = 0;
+}
+
+
+
+
+int KeyDirectory::size()
+{
+	return _size;
+}
+
+
+
+
+int KeyDirectory::lowerBound(const DbKey& key)
+{
+	int low = 0;
+	int high = _size;
+
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+
+		if (_compare(_keys[mid], key) < 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+
+
+int KeyDirectory::find(const DbKey& key)
+{
+	int pos = lowerBound(key);
+
+	if ((pos < _size) && key.equals(_keys[pos]))
+	{
+		return _offsets[pos];
+	}
+
+	return -1;
+}
+
+
+
+
+bool KeyDirectory::put(const String& key, int offset)
+{
+	int pos = lowerBound(key);
+
+	if ((pos < _size) && key.equals(_keys[pos]))
+	{
+		_offsets[pos] = offset;
+		return true;
+	}
+
+	if ((_size == _capacity) && !_grow())
+	{
+		return false;
+	}
+
+	// Shifting the greater keys to keep the directory sorted
+	for (int i = _size ; i > pos ; i--)
+	{
+		_keys[i] = _keys[i - 1];
+		_offsets[i] = _offsets[i - 1];
+	}
+
+	_keys[pos] = key;
+	_offsets[pos] = offset;
+	_size++;
+
+	return true;
+}
+
+
+
+
+void KeyDirectory::erase(const DbKey& key)
+{
+	int pos = lowerBound(key);
+
+	if ((pos < _size) && key.equals(_keys[pos]))
+	{
+		for (int i = pos ; i < (_size - 1) ; i++)
+		{
+			_keys[i] = _keys[i + 1];
+			_offsets[i] = _offsets[i + 1];
+		}
+
+		_size--;
+		_keys[_size] = "";
+	}
+}
+
+
+
+
+const String& KeyDirectory::keyAt(int pos)
+{
+	return _keys[pos];
+}
+
+
+
+
+int KeyDirectory::offsetAt(int pos)
+{
+	return _offsets[pos];
+}
+
+// ************************************************************
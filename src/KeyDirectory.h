@@ -0,0 +1,123 @@
+/*
+    KeyDirectory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef KeyDirectory_h
+#define KeyDirectory_h
+
+#include "Arduino.h"
+#include "DbKey.h"
+
+/**
+ * Callback used by the scan methods, called once for every matching key value pair
+ * @param key key of the pair
+ * @param value value associated with the key
+ * @param context pointer passed to the scan method, NULL if none was passed
+ * @return true to continue scanning
+ * @return false to stop the scan
+ */
+typedef bool (*ScanCallback)(const String& key, const String& value, void* context);
+
+/**
+ * In-RAM directory of the active keys, sorted by key along with the index of their record
+ */
+class KeyDirectory
+{
+    private:
+        String* _keys;
+        int* _offsets;
+        int _size;
+        int _capacity;
+
+        /**
+         * This will increase the capacity of the directory
+         * @param null
+         * @return true if capacity increased
+         * @return false if memory is not available
+         */
+        bool _grow();
+
+        /**
+         * This will compare a key of the directory with key, byte by byte
+         * @param stored key of the directory
+         * @param key the key to compare with
+         * @return less than 0, 0 or greater than 0 if stored is less than, equal to or greater than key
+         */
+        int _compare(const String& stored, const DbKey& key);
+
+    public:
+        /**
+         * Constructor for initializing an empty directory
+         * @param null
+         * @return null
+         */
+        KeyDirectory();
+
+        KeyDirectory(const KeyDirectory& other);
+
+        KeyDirectory& operator=(const KeyDirectory& other);
+
+        ~KeyDirectory();
+
+        /**
+         * This will remove all the keys and release the memory used by the directory
+         * @param null
+         */
+        void clear();
+
+        /**
+         * This will return the number of keys in the directory
+         * @param null
+         * @return number of keys
+         */
+        int size();
+
+        /**
+         * This will return the position of the first key not less than key (binary search)
+         * @param key the key to search for
+         * @return position of the key, size() if all keys are less than key
+         */
+        int lowerBound(const DbKey& key);
+
+        /**
+         * This will return the index of the record of key
+         * @param key the key to search for
+         * @return index of the record if found
+         * @return -1 if key not found
+         */
+        int find(const DbKey& key);
+
+        /**
+         * This will add the key or update the index of its record if already present
+         * @param key the key to add
+         * @param offset index of the record of key
+         * @return true if added successfully
+         * @return false if memory is not available
+         */
+        bool put(const String& key, int offset);
+
+        /**
+         * This will remove the key from the directory
+         * @param key the key to remove
+         */
+        void erase(const DbKey& key);
+
+        /**
+         * This will return the key at the given position
+         * @param pos position of the key, must be less than size()
+         * @return key at the position
+         */
+        const String& keyAt(int pos);
+
+        /**
+         * This will return the index of the record at the given position
+         * @param pos position of the key, must be less than size()
+         * @return index of the record
+         */
+        int offsetAt(int pos);
+};
+
+#endif
@@ -0,0 +1,555 @@
+/*
+    Partition_Memory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers using a raw flash partition (ESP32)
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Partition_Memory.h"
+
+#if defined(ESP32)
+
+#define PARTITION_MAGIC "ADBP"
+#define PARTITION_HEADER_SIZE 8     // magic and sequence number at the start of every half
+
+// Constructors
+
+Partition_Memory::Partition_Memory(const char* label)
+{
+	_label = label;
+	_isInitiated = false;
+	_partition = NULL;
+	_mapped = NULL;
+	_halfSize = 0;
+	_active = 0;
+	_sequence = 0;
+	_end = PARTITION_HEADER_SIZE;
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void Partition_Memory::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[Partition]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+const char* Partition_Memory::_data()
+{
+	return _mapped + (_active * _halfSize);
+}
+
+
+
+
+bool Partition_Memory::_readHeader(uint8_t half, uint32_t& sequence)
+{
+	const char* header = _mapped + (half * _halfSize);
+
+	if (memcmp(header, PARTITION_MAGIC, 4) != 0)
+	{
+		return false;
+	}
+
+	sequence = 0;
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		sequence = sequence | ((uint32_t)(uint8_t)header[4 + i] << (8 * i));
+	}
+
+	return true;
+}
+
+
+
+
+uint32_t Partition_Memory::_findEnd(bool& complete)
+{
+	const char* data = _data();
+	uint32_t idx = PARTITION_HEADER_SIZE;
+
+	complete = true;
+
+	// Keys never start with an erased byte (0xFF is not valid in UTF-8)
+	while ((idx < _halfSize) && ((uint8_t)data[idx] != 0xFF))
+	{
+		int length = dbFindByte(data + idx, _halfSize - idx, '\n');
+
+		if (length == -1)
+		{
+			_print("Incomplete record at: " + String(idx));
+			complete = false;
+			break;
+		}
+
+		idx = idx + length + 1;
+	}
+
+	return idx;
+}
+
+
+
+
+bool Partition_Memory::_write(uint8_t half, uint32_t offset, const char* data, uint32_t length)
+{
+	char buffer[PARTITION_WRITE_CHUNK];
+	uint32_t base = (half * _halfSize) + offset;
+
+	for (uint32_t i = 0 ; i < length ; i += PARTITION_WRITE_CHUNK)
+	{
+		uint32_t chunk = length - i;
+
+		if (chunk > PARTITION_WRITE_CHUNK)
+		{
+			chunk = PARTITION_WRITE_CHUNK;
+		}
+
+		// The source may be in the mapped flash, which is not readable while the flash is written
+		memcpy(buffer, data + i, chunk);
+
+		// The partition API flushes the flash cache of the written range, so the mapping shows the new bytes
+		if (esp_partition_write(_partition, base + i, buffer, chunk) != ESP_OK)
+		{
+			_print("Write operation failed");
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+int Partition_Memory::_next(uint32_t& idx, Record& record, int& keyLength, int& length)
+{
+	const char* data = _data();
+
+	if (idx >= _end)
+	{
+		return -1;
+	}
+
+	keyLength = dbFindByte(data + idx, _end - idx, '>');
+
+	if (keyLength == -1)
+	{
+		return -1;
+	}
+
+	record.offset = idx;
+	record.flagOffset = idx + keyLength + 1;
+	record.flag = data[record.flagOffset];
+	record.expiry = 0;
+
+	uint32_t valueIdx = record.flagOffset + 1;
+
+	if (dbFlagBits(record.flag) & RECORD_EXPIRES)
+	{
+		for (int i = 0 ; i < 8 ; i++)
+		{
+			record.expiry = (record.expiry << 4) | dbHexValue(data[valueIdx + i]);
+		}
+
+		valueIdx = valueIdx + 8;
+	}
+
+	// Skipping the ':' separating the value
+	valueIdx++;
+
+	if (valueIdx > _end)
+	{
+		return -1;
+	}
+
+	length = dbFindByte(data + valueIdx, _end - valueIdx, '\n');
+
+	if (length == -1)
+	{
+		return -1;
+	}
+
+	idx = valueIdx + length + 1;
+
+	return valueIdx;
+}
+
+
+
+
+int Partition_Memory::_valueOf(const String& key, bool includeExpired, Record& record, int& length)
+{
+	const char* data = _data();
+	uint32_t idx = PARTITION_HEADER_SIZE;
+	int keyLength;
+	int valueIdx;
+
+	// Plain scan of the mapped flash, nothing is copied to RAM
+	while ((valueIdx = _next(idx, record, keyLength, length)) != -1)
+	{
+		if ((keyLength == (int)key.length()) && (dbFlagBits(record.flag) & RECORD_ACTIVE) &&
+			(memcmp(data + record.offset, key.c_str(), keyLength) == 0))
+		{
+			return (includeExpired || dbIsLive(record)) ? valueIdx : -1;
+		}
+	}
+
+	return -1;
+}
+
+
+
+
+bool Partition_Memory::_eraseHalf(uint8_t half)
+{
+	if (esp_partition_erase_range(_partition, half * _halfSize, _halfSize) != ESP_OK)
+	{
+		_print("Erase operation failed");
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+bool Partition_Memory::_writeHeader(uint8_t half, uint32_t sequence)
+{
+	char header[PARTITION_HEADER_SIZE];
+
+	memcpy(header, PARTITION_MAGIC, 4);
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		header[4 + i] = (char)(sequence >> (8 * i));
+	}
+
+	return _write(half, 0, header, PARTITION_HEADER_SIZE);
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+bool Partition_Memory::begin()
+{
+	_print("Initializing the system");
+
+	_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, _label);
+
+	if (_partition == NULL)
+	{
+		_print("Partition not found");
+		_isInitiated = false;
+		return FAILURE;
+	}
+
+	// Halves are erased separately, so each one is a whole number of flash sectors
+	_halfSize = (_partition->size / 2) - ((_partition->size / 2) % SPI_FLASH_SEC_SIZE);
+
+	const void* mapped = NULL;
+
+	if ((_halfSize == 0) ||
+		(esp_partition_mmap(_partition, 0, 2 * _halfSize, SPI_FLASH_MMAP_DATA, &mapped, &_mapHandle) != ESP_OK))
+	{
+		_print("Partition can not be mapped");
+		_isInitiated = false;
+		return FAILURE;
+	}
+
+	_mapped = (const char*)mapped;
+	_isInitiated = true;
+
+	uint32_t sequences[2];
+	bool valid[2];
+
+	valid[0] = _readHeader(0, sequences[0]);
+	valid[1] = _readHeader(1, sequences[1]);
+
+	if (!valid[0] && !valid[1])
+	{
+		_print("No database in the partition, formatting it");
+		return format();
+	}
+
+	// An optimize interrupted before the header of the new half was written leaves the old half active
+	_active = (valid[1] && (!valid[0] || (sequences[1] > sequences[0]))) ? 1 : 0;
+	_sequence = sequences[_active];
+
+	bool complete;
+	_end = _findEnd(complete);
+
+	if (!complete)
+	{
+		// Written bytes of the incomplete record can not be appended over, the complete records are copied to the other half
+		if (optimize() != SUCCESS)
+		{
+			// Every insert tries to optimize again, as the active half has no free space
+			_end = _halfSize;
+			return FAILURE;
+		}
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+bool Partition_Memory::format()
+{
+	_print("Formatting the partition");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	if (!_eraseHalf(0) || !_eraseHalf(1))
+	{
+		return FAILURE;
+	}
+
+	_active = 0;
+	_sequence++;
+	_end = PARTITION_HEADER_SIZE;
+
+	return _writeHeader(0, _sequence);
+}
+
+
+
+
+int8_t Partition_Memory::optimize()
+{
+	_print("Inside Optimize Memory");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	uint8_t other = 1 - _active;
+
+	if (!_eraseHalf(other))
+	{
+		return FAILURE;
+	}
+
+	// Copying the live records, the header is written last so the old half stays active until the copy is complete
+	const char* data = _data();
+	uint32_t idx = PARTITION_HEADER_SIZE;
+	uint32_t position = PARTITION_HEADER_SIZE;
+	Record record;
+	int keyLength;
+	int length;
+
+	while (_next(idx, record, keyLength, length) != -1)
+	{
+		if (!dbIsLive(record))
+		{
+			continue;
+		}
+
+		uint32_t size = idx - record.offset;
+
+		if (!_write(other, position, data + record.offset, size))
+		{
+			return FAILURE;
+		}
+
+		position = position + size;
+	}
+
+	if (!_writeHeader(other, _sequence + 1))
+	{
+		return FAILURE;
+	}
+
+	_active = other;
+	_sequence++;
+	_end = position;
+
+	_print("Used space (in bytes): " + String(_end));
+
+	return SUCCESS;
+}
+
+
+
+
+String Partition_Memory::get(const String& key, const String& defaultValue)
+{
+	_print("GET CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return defaultValue;
+	}
+
+	Record record;
+	int length;
+	int valueIdx = _valueOf(key, false, record, length);
+
+	if (valueIdx == -1)
+	{
+		return defaultValue;
+	}
+
+	String data = "";
+	const char* value = _data() + valueIdx;
+	ValueDecoder decoder(&data, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+
+	data.reserve(length);
+
+	for (int i = 0 ; i < length ; i++)
+	{
+		decoder.feed(value[i]);
+	}
+
+	return data;
+}
+
+
+
+
+bool Partition_Memory::getView(const String& key, const char*& value, size_t& length)
+{
+	_print("GETVIEW CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	Record record;
+	int valueLength;
+	int valueIdx = _valueOf(key, false, record, valueLength);
+
+	if ((valueIdx == -1) || (dbFlagBits(record.flag) & RECORD_COMPRESSED))
+	{
+		return FAILURE;
+	}
+
+	value = _data() + valueIdx;
+	length = valueLength;
+
+	return SUCCESS;
+}
+
+
+
+
+int8_t Partition_Memory::insert(const String& key, const String& value)
+{
+	return insert(key, value, 0);
+}
+
+
+
+
+int8_t Partition_Memory::insert(const String& key, const String& value, uint32_t ttlSeconds)
+{
+	_print("INSERT CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	String data = dbEncodeRecord(key, value, ttlSeconds, 0);
+	Record record;
+	int length;
+
+	// Key exists, expired records are replaced as well
+	if (_valueOf(key, true, record, length) != -1)
+	{
+		char removed = '0';
+
+		if (!_write(_active, record.flagOffset, &removed, 1))
+		{
+			return FAILURE;
+		}
+	}
+
+	if ((_end + data.length()) > _halfSize)
+	{
+		if (optimize() != SUCCESS)
+		{
+			return FAILURE;
+		}
+
+		if ((_end + data.length()) > _halfSize)
+		{
+			_print("Memory full, please delete some data");
+			return MEM_FULL;
+		}
+	}
+
+	if (!_write(_active, _end, data.c_str(), data.length()))
+	{
+		return FAILURE;
+	}
+
+	_end = _end + data.length();
+
+	return SUCCESS;
+}
+
+
+
+
+bool Partition_Memory::remove(const String& key)
+{
+	_print("REMOVE CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	Record record;
+	int length;
+
+	if (_valueOf(key, false, record, length) == -1)
+	{
+		return FAILURE;
+	}
+
+	// '1' (or '3', '5', '7') to '0' only clears bits, so the flag is written in place without erasing
+	char removed = '0';
+
+	return _write(_active, record.flagOffset, &removed, 1);
+}
+
+
+
+
+bool Partition_Memory::exists(const String& key)
+{
+	Record record;
+	int length;
+
+	return (_isInitiated && (_valueOf(key, false, record, length) != -1)) ? SUCCESS : FAILURE;
+}
+
+#endif
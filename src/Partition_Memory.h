@@ -0,0 +1,216 @@
+/*
+    Partition_Memory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using a raw flash partition (ESP32)
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Partition_Memory_h
+#define Partition_Memory_h
+
+#if defined(ESP32)
+
+#include "Arduino.h"
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include "Config.h"
+#include "DbUtils.h"
+#include "Compression.h"
+#include "ScanKernel.h"
+
+/**
+ * Database kept in a raw data partition of the flash, read through the flash cache (memory mapped)
+ * instead of the file system. Lookups scan the mapped flash directly like the RAM mirror of EEPROM,
+ * without copying it through the VFS layer. Writes go through the partition API.
+ * The partition is used as two halves, records are appended to the active half and optimize copies the
+ * live records to the other half. Records use the same format as the other memories, removing a record
+ * only clears bits of its flag ('1' to '0'), so it is done in place without erasing flash
+ */
+class Partition_Memory
+{
+    private:
+        const char* _label;
+        bool _isInitiated;
+
+        const esp_partition_t* _partition;
+        spi_flash_mmap_handle_t _mapHandle;
+        const char* _mapped;        // first byte of the partition in the address space
+
+        uint32_t _halfSize;         // bytes of each half, a multiple of the flash sector
+        uint8_t _active;            // half holding the data
+        uint32_t _sequence;         // increased every time the active half changes
+        uint32_t _end;              // offset within the active half where the next record is written
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will return the first byte of the active half in the mapped flash
+         * @param null
+         * @return pointer to the header of the active half
+         */
+        const char* _data();
+
+        /**
+         * This will read the sequence number of a half
+         * @param half index of the half
+         * @param sequence to hold the sequence number
+         * @return true if the half holds a valid header
+         */
+        bool _readHeader(uint8_t half, uint32_t& sequence);
+
+        /**
+         * This will find the end of the complete records of the active half
+         * @param complete set to false if an incomplete record (interrupted write) follows the end
+         * @return offset of the end, the first erased byte if all the records are complete
+         */
+        uint32_t _findEnd(bool& complete);
+
+        /**
+         * This will write bytes to the active half, copying them through RAM as the mapped
+         * flash can not be read while the flash is written
+         * @param half index of the half
+         * @param offset offset within the half
+         * @param data bytes to write
+         * @param length number of bytes to write
+         * @return SUCCESS if written
+         * @return FAILURE otherwise
+         */
+        bool _write(uint8_t half, uint32_t offset, const char* data, uint32_t length);
+
+        /**
+         * This will parse the record at the offset of the active half
+         * @param idx offset of the first byte of the record, moved to the next record on return
+         * @param record Record to hold the offsets, flag and expiry of the record, its key is not set
+         * @param keyLength to hold the number of bytes of the key
+         * @param length to hold the number of bytes of the stored value
+         * @return offset of the first byte of the stored value
+         * @return -1 if no more complete records are available
+         */
+        int _next(uint32_t& idx, Record& record, int& keyLength, int& length);
+
+        /**
+         * This will return the offset of the active record of key in the active half
+         * @param key the key whose record is to be searched
+         * @param includeExpired set to true for finding the key even if its record has expired
+         * @param record Record to hold the offsets, flag and expiry of the record
+         * @param length to hold the number of bytes of the stored value
+         * @return offset of the first byte of the stored value if found
+         * @return -1 if key not found
+         */
+        int _valueOf(const String& key, bool includeExpired, Record& record, int& length);
+
+        /**
+         * This will erase a half, leaving it without a valid header
+         * @param half index of the half
+         * @return SUCCESS if erased
+         * @return FAILURE otherwise
+         */
+        bool _eraseHalf(uint8_t half);
+
+        /**
+         * This will write the header of a half, making it the active half from the next begin on
+         * @param half index of the half
+         * @param sequence sequence number of the half, greater than the one of the other half
+         * @return SUCCESS if written
+         * @return FAILURE otherwise
+         */
+        bool _writeHeader(uint8_t half, uint32_t sequence);
+
+    public:
+        /**
+         * Constructor for initializing class object for using a data partition
+         * @param label label of the partition in the partition table, of type data (any subtype)
+         * @return null
+         */
+        Partition_Memory(const char* label);
+
+        /**
+         * This method will find and map the partition, formatting it if it holds no database
+         * An incomplete last record left by a reset during a write is dropped by optimizing the partition
+         * Note- Must be called within setup only once
+         * @return FAILURE is initialization fails, or the incomplete last record could not be dropped
+         * @return SUCCESS is initialization successful
+         */
+        bool begin();
+
+        /**
+         * This method will remove all the data of the partition
+         * @return FAILURE is format fails
+         * @return SUCCESS is format successful
+         */
+        bool format();
+
+        /**
+         * Call this method to copy the live records to the other half of the partition, dropping removed and expired records
+         * @param null
+         * @return SUCCESS, if optimization task successful
+         * @return FAILURE, if optimization failed
+         */
+        int8_t optimize();
+
+        /**
+         * This method will return the value associated with key
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const String& key, const String& defaultValue);
+
+        /**
+         * This method will return the value associated with key without copying it, pointing directly
+         * into the mapped flash. The value is not null terminated and is valid only until the next
+         * optimize or format (inserts may optimize)
+         * @param key key for which value is required
+         * @param value to hold the pointer to the first byte of the value
+         * @param length to hold the number of bytes of the value
+         * @return SUCCESS if key found
+         * @return FAILURE if key not found or the value is stored compressed
+         */
+        bool getView(const String& key, const char*& value, size_t& length);
+
+        /**
+         * This method will insert the data into the database
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const String& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const String& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will remove the key and associated value from db
+         * @param key key to be removed
+         * @return FAILURE if fails or key not found
+         * @return SUCCESS if key removed successfully
+         */
+        bool remove(const String& key);
+
+        /**
+         * This method will tell weather the key exists or not in the database
+         * @param key key to search for
+         * @return SUCCESS if key found
+         * @return FAILURE is key not found
+         */
+        bool exists(const String& key);
+};
+
+#endif
+
+#endif
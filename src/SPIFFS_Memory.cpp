@@ -8,6 +8,12 @@
 #include "Arduino.h"
 #include "SPIFFS_Memory.h"
 
+// Number of bytes read from the file at a time while scanning
+#define READ_CHUNK_SIZE 32
+
+// Expiry time of removed keys in the redo journal, already expired whenever the journal is read
+#define JOURNAL_REMOVED 1
+
 /**
  * Constructor of the class for SPIFFS memory
  */
@@ -15,6 +21,46 @@ SPIFFS_Memory::SPIFFS_Memory()
 {
 	_FILE_NAME = "/store.txt";
 	_isInitiated = false;
+	_directoryBuilt = false;
+	_sweepIdx = 0;
+	_compressMinSize = 0;
+	_livePin = -1;
+
+	for (int i = 0 ; i < SNAPSHOT_MAX_VERSIONS ; i++)
+	{
+		_pinRefs[i] = 0;
+		_pinMoved[i] = false;
+	}
+
+#if defined(THREAD_SAFE)
+	_pinLock = NULL;
+#endif
+}
+
+
+
+
+/**
+ * Constructor of the class for a separate file of SPIFFS memory
+ */
+SPIFFS_Memory::SPIFFS_Memory(const char* name)
+{
+	_FILE_NAME = String("/") + name + ".txt";
+	_isInitiated = false;
+	_directoryBuilt = false;
+	_sweepIdx = 0;
+	_compressMinSize = 0;
+	_livePin = -1;
+
+	for (int i = 0 ; i < SNAPSHOT_MAX_VERSIONS ; i++)
+	{
+		_pinRefs[i] = 0;
+		_pinMoved[i] = false;
+	}
+
+#if defined(THREAD_SAFE)
+	_pinLock = NULL;
+#endif
 }
 
 
@@ -32,94 +78,296 @@ void SPIFFS_Memory::_print(const String& msg)
 
 
 
-int SPIFFS_Memory::_indexOfKey(const String& key)
+File SPIFFS_Memory::_acquire(bool create)
 {
-	// Opening and reading the file contents
-	File file = SPIFFS.open(_FILE_NAME, "r");
+	if (_file)
+	{
+		_file.seek(0, SeekSet);
+		return _file;
+	}
 
-	if (!file)
+	File file;
+
+	if (SPIFFS.exists(_FILE_NAME))
 	{
-		_print("INDEX_OF_KEY operation failed");
-		return -1;
+		file = SPIFFS.open(_FILE_NAME, "r+");
 	}
-	else 
+	else if (create)
 	{
-		int keyIndex = 0;
-		int keyByteIndex = 0;
-		String keyStr = "";
+		file = SPIFFS.open(_FILE_NAME, "w+");
+	}
 
-		for (int i = 0 ; i < file.size() ; i++)
-		{
-			char currentChar = (char)file.read();
+#if !defined(THREAD_SAFE)
+	_file = file;
+#endif
 
-			if (currentChar == '>')
-			{
-				if (key.equals(keyStr))
-				{
-					// Checking if key active or not
-					currentChar = (char)file.read();
-					if (currentChar == '1')
-					{
-						file.close();
-						_print("(inside indexOfKey) Key found at: " + String(keyByteIndex - keyStr.length()));
-						// TODO: Maybe a structure for both
-						return keyByteIndex - keyStr.length();
-						return keyIndex;
-					}
-					else
-					{
-						keyByteIndex++;
-					}
-					
-				}
+	return file;
+}
 
-				keyStr = "";
-			} else {
-				keyStr = keyStr + String(currentChar);
-			}
 
-			if (currentChar == '\n')
-			{
-				keyIndex++;
 
-				keyStr = "";
-			}
 
-			keyByteIndex++;
+void SPIFFS_Memory::_release(File& file)
+{
+#if defined(THREAD_SAFE)
+	file.close();
+#else
+	// Written data is made durable after every operation, as the handle is not closed
+	file.flush();
+#endif
+}
+
+
+
+
+void SPIFFS_Memory::_lockPins()
+{
+#if defined(THREAD_SAFE)
+	xSemaphoreTake(_pinLock, portMAX_DELAY);
+#endif
+}
+
+
+
+
+void SPIFFS_Memory::_unlockPins()
+{
+#if defined(THREAD_SAFE)
+	xSemaphoreGive(_pinLock);
+#endif
+}
+
+
+
+
+String SPIFFS_Memory::_pinName(int8_t slot)
+{
+	// Same length as the name of the file, so it is valid for any valid name
+	return _FILE_NAME.substring(0, _FILE_NAME.length() - 4) + ".sn" + String(slot);
+}
+
+
+
+
+String SPIFFS_Memory::_pendingName()
+{
+	// Same length as the name of the file, so it is valid for any valid name
+	return _FILE_NAME.substring(0, _FILE_NAME.length() - 4) + ".new";
+}
+
+
+
+
+bool SPIFFS_Memory::_copyFile(const String& from, const String& to)
+{
+	File source = SPIFFS.open(from, "r");
+	File copy = SPIFFS.open(to, "w");
+
+	bool copied = source && copy;
+
+	if (copied)
+	{
+		char buffer[READ_CHUNK_SIZE];
+		int count = source.read((uint8_t*)buffer, READ_CHUNK_SIZE);
+
+		while (copied && (count > 0))
+		{
+			copied = (copy.write((const uint8_t*)buffer, count) == (size_t)count);
+			count = source.read((uint8_t*)buffer, READ_CHUNK_SIZE);
 		}
+	}
 
-		file.close();
+	source.close();
+	copy.close();
 
-		return -1;
+	if (!copied)
+	{
+		_print("Copy of the file failed");
+		SPIFFS.remove(to);
 	}
+
+	return copied;
 }
 
 
 
 
-int8_t SPIFFS_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forceOptimize)
+bool SPIFFS_Memory::_detachSnapshots(File& file, bool keepData)
 {
-// 	FSInfo fs_info;
-// SPIFFS.info(fs_info);
-// float fileTotalKB = (float)fs_info.totalBytes; 
-// float fileUsedKB = (float)fs_info.usedBytes; 
-// float realFlashChipSize = (float)ESP.getFlashChipRealSize() / 1024.0 / 1024.0;
-// Serial.print("    Actual size based on chip Id: "); Serial.print(realFlashChipSize); Serial.println(" MB ... given by (2^( \"Device\" - 1) / 8 / 1024");
-// Serial.print("    Total KB: "); Serial.print(fileTotalKB); Serial.println(" KB");
-// Serial.print("    Used KB: "); Serial.print(fileUsedKB); Serial.println(" KB");
-// Serial.printf("    Block size: %lu\n", fs_info.blockSize);
-// Serial.printf("    Page size: %lu\n", fs_info.pageSize);
+	_lockPins();
 
-	_print("Inside Optimize Memory");
+	int8_t slot = _livePin;
+
+	_unlockPins();
+
+	if (slot == -1)
+	{
+		return SUCCESS;
+	}
+
+	_print("Moving the version of snapshots to " + _pinName(slot));
+
+	// Snapshots reading the file keep their handles, the moved file is never written again
+	file.close();
+	_file.close();
+
+	// The data is copied before the file is moved, so it is complete under one of the names at any time
+	bool exists = SPIFFS.exists(_FILE_NAME);
+	bool copied = !keepData || !exists || _copyFile(_FILE_NAME, _pendingName());
+
+	_lockPins();
+
+	bool moved = copied;
+
+	// The last snapshot of the version may have been released during the copy
+	if (_livePin == slot)
+	{
+		moved = copied && (!exists || SPIFFS.rename(_FILE_NAME, _pinName(slot)));
+
+		_pinMoved[slot] = true;
+		_livePin = -1;
+	}
+	else
+	{
+		exists = false;
+	}
+
+	_unlockPins();
+
+	if (keepData && exists && moved && !SPIFFS.rename(_pendingName(), _FILE_NAME))
+	{
+		// Taking the data back from the version, the snapshots lose it
+		SPIFFS.rename(_pinName(slot), _FILE_NAME);
+		moved = false;
+	}
+
+	if (SPIFFS.exists(_pendingName()))
+	{
+		SPIFFS.remove(_pendingName());
+	}
+
+	if (!moved)
+	{
+		_print("Version of snapshots lost");
+		file = keepData ? _acquire(false) : File();
+		return FAILURE;
+	}
+
+	if (keepData)
+	{
+		file = _acquire(false);
+	}
+
+#if !defined(THREAD_SAFE)
+	_file = file;
+#endif
+
+	return SUCCESS;
+}
+
+
+
+
+void SPIFFS_Memory::_deactivate(File& file, int keyIndex)
+{
+	int idx = keyIndex;
+
+	_detachSnapshots(file, true);
+
+	file.seek(idx, SeekSet);
+	char currentChar = (char)file.read();
+
+	while (currentChar != '>')
+	{
+		file.seek(idx, SeekSet);
 
+		idx++;
+		currentChar = (char)file.read();
+	}
+
+	file.print("0");
+}
+
+
+
+
+int SPIFFS_Memory::_indexOfKey(File& file, const DbKey& key, bool includeExpired)
+{
+	Record record;
+
+	if (_directoryBuilt)
+	{
+		int idx = _directory.find(key);
+		record.key = key.c_str();
+
+		if ((idx == -1) || !file.seek(idx, SeekSet) || !_readKey(file, record))
+		{
+			return -1;
+		}
+
+		return (includeExpired || dbIsLive(record)) ? record.offset : -1;
+	}
+
+	file.seek(0, SeekSet);
+
+	while (_readKey(file, record))
+	{
+		if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && key.equals(record.key))
+		{
+			if (includeExpired || dbIsLive(record))
+			{
+				_print("(inside indexOfKey) Key found at: " + String(record.offset));
+				return record.offset;
+			}
+		}
+
+		_readValue(file, NULL);
+	}
+
+	return -1;
+}
+
+
+
+
+uint32_t SPIFFS_Memory::_capacity(uint32_t fileSize)
+{
+#if defined(ESP32)
+	uint32_t totalBytes = SPIFFS.totalBytes();
+	uint32_t usedBytes = SPIFFS.usedBytes();
+	uint32_t pageSize = SPIFFS_PAGE_SIZE;
+#else
 	FSInfo fs_info;
 	SPIFFS.info(fs_info);
 
-	int totalAvailableBytes = (int)fs_info.totalBytes;
+	uint32_t totalBytes = fs_info.totalBytes;
+	uint32_t usedBytes = fs_info.usedBytes;
+	uint32_t pageSize = (fs_info.pageSize > 0) ? fs_info.pageSize : SPIFFS_PAGE_SIZE;
+#endif
+
+	// Pages of the file are not counted as used, they are what the file grows into or is rewritten in
+	uint32_t filePages = ((fileSize + pageSize - 1) / pageSize) * pageSize;
+	uint32_t otherBytes = (usedBytes > filePages) ? (usedBytes - filePages) : 0;
+
+	// Part of the file system is kept free, SPIFFS needs free blocks for its garbage collection
+	uint32_t usableBytes = (totalBytes / 100) * (100 - SPIFFS_RESERVE_PERCENT);
+	uint32_t capacity = (usableBytes > otherBytes) ? (usableBytes - otherBytes) : 0;
+
+	// Half of it, compaction writes the live records to the staging file before the file is removed
+	capacity = capacity / 2;
+
+	// Whole pages only, the last page of the file is not shared with other files
+	return capacity - (capacity % pageSize);
+}
+
+
+
 
-	// Only 80% space is usable
-	// totalAvailableBytes = (totalAvailableBytes * 0.8);
-	totalAvailableBytes = MAX_SPIFFS_SIZE;
+int8_t SPIFFS_Memory::_optimizeMemory(File& file, int spaceRequired, int fileSize, bool forceOptimize)
+{
+	_print("Inside Optimize Memory");
+
+	int totalAvailableBytes = (int)_capacity(fileSize);
 
 	_print("Space Required (in bytes): " + String(spaceRequired));
 	_print("Current used space (in bytes): " + String(fileSize));
@@ -142,8 +390,6 @@ int8_t SPIFFS_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forc
 			_print("Space not available...performing optimization");
 		}
 
-		File file = SPIFFS.open(_FILE_NAME, "r");
-
 		if (!file)
 		{
 			_print("Optimization operation failed");
@@ -151,340 +397,475 @@ int8_t SPIFFS_Memory::_optimizeMemory(int spaceRequired, int fileSize, bool forc
 		}
 		else 
 		{
-			// Removing un-indexed data that is not required
-			String newData = "";
-			String temp = "";
-			char thisChar;
+			// Streaming the live records to the staging file, only the directory of the keys is kept in RAM
+			String stagingName = _stagingName();
+			File staging = SPIFFS.open(stagingName, "w");
+			bool copied = (bool)staging;
+			Record record;
 
-			for (int i = 0 ; i < file.size() ; i++)
+			if (copied && (_directoryBuilt || _buildDirectory(file)))
 			{
-				thisChar = (char)file.read();
+				// Written sorted by key with front coded keys, a full key every KEY_RESTART_INTERVAL records
+				String previousKey = "";
+				int written = 0;
 
-				if (thisChar != '\n')
+				for (int pos = 0 ; copied && (pos < _directory.size()) ; pos++)
 				{
-					temp = temp + String(thisChar);
+					const String& key = _directory.keyAt(pos);
+					record.key = key.c_str();
+
+					if (!file.seek(_directory.offsetAt(pos), SeekSet) || !_readKey(file, record) || !dbIsLive(record))
+					{
+						continue;
+					}
+
+					int end = _recordEnd(file);
+
+					if (end != -1)
+					{
+						String stored = ((written % KEY_RESTART_INTERVAL) == 0) ? key : dbEncodeKey(previousKey, key);
+						copied = _copyRecord(file, staging, stored, record.flagOffset - 1, end);
+						previousKey = key;
+						written++;
+					}
 				}
-				else
+			}
+			else if (copied)
+			{
+				// Not enough memory for sorting, keeping the file order with full keys
+				file.seek(0, SeekSet);
+
+				while (copied && _readKey(file, record))
 				{
-					int indexOfSep = temp.indexOf(">");
+					int end = _recordEnd(file);
 
-					if((char)temp[indexOfSep + 1] == '1')
+					if ((end != -1) && dbIsLive(record))
 					{
-						newData = newData + temp + "\n";
+						copied = _copyRecord(file, staging, record.key, record.flagOffset - 1, end);
 					}
-
-					temp = "";
 				}
 			}
 
+			staging.close();
 			file.close();
-			// _print("New File Data:- \n" + newData);
 
-			// Writing new data to the file
-			file = SPIFFS.open(_FILE_NAME, "w");
+			// Records are moved, directory will be re-built on next scan
+			_directory.clear();
+			_directoryBuilt = false;
 
-			if (!file)
+			if (!copied || !_replaceFile(stagingName))
 			{
+				// The file is only replaced once all the records are written, a failed write leaves it as it was
+				SPIFFS.remove(stagingName);
+				file = _acquire(false);
+
 				_print("Optimization operation failed");
 				return FAILURE;
 			}
-			else 
+
+			file = _acquire(false);
+
+			if (!file)
 			{
-				file.print(newData);
+				_print("Optimization operation failed");
+				return FAILURE;
 			}
 
 			// Checking if space availabe after optimization is sufficient or not
 			fileSize = file.size();
+			totalAvailableBytes = (int)_capacity(fileSize);
 
 			if (((spaceRequired + fileSize) > totalAvailableBytes))
 			{
-				file.close();
 				_print("Memory full, please delete some data");
 				return MEM_FULL;
 			}
 
-			file.close();
-
 			return SUCCESS;
 		}
 	}
 	
 }
 
-// ************************************************************
 
 
 
-// ****************** PUBLIC METHODS **************************
-bool SPIFFS_Memory::begin()
+String SPIFFS_Memory::_stagingName()
 {
-	_print("Initializing the system");
+	// Same length as the name of the file, so it is valid for any valid name
+	return _FILE_NAME.substring(0, _FILE_NAME.length() - 4) + ".imp";
+}
 
-	if (SPIFFS.begin())
-	{
-		_isInitiated = true;
 
-		return SUCCESS;
-	}
-	else
-	{
-		_isInitiated = false;
 
-		return FAILURE;
-	}
+
+String SPIFFS_Memory::_journalName()
+{
+	// Same length as the name of the file, so it is valid for any valid name
+	return _FILE_NAME.substring(0, _FILE_NAME.length() - 4) + ".jnl";
 }
 
 
 
 
-bool SPIFFS_Memory::format()
+String SPIFFS_Memory::_failedJournalName()
 {
-	_print("Formatting the system");
+	// Same length as the name of the file, so it is valid for any valid name
+	return _FILE_NAME.substring(0, _FILE_NAME.length() - 4) + ".jfl";
+}
 
-	if (_isInitiated)
+
+
+
+bool SPIFFS_Memory::_replaceFile(const String& stagingName)
+{
+	_file.close();
+	_detachSnapshots(_file, false);
+	_sweepIdx = 0;
+
+	// Rename does not replace an existing file on all the boards, the staging file becomes the pending copy first
+	// so that begin restores it if reset after the file is removed
+	if (!SPIFFS.rename(stagingName, _pendingName()))
 	{
-		if (SPIFFS.format())
-		{
-			return SUCCESS;
-		}
-		else
-		{
-			return FAILURE;
-		}
+		return FAILURE;
 	}
-	else
+
+	if (SPIFFS.exists(_FILE_NAME) && !SPIFFS.remove(_FILE_NAME))
 	{
-		_print("System not initiated");
+		SPIFFS.remove(_pendingName());
+		return FAILURE;
 	}
 
-	return FAILURE;
+	return SPIFFS.rename(_pendingName(), _FILE_NAME) ? SUCCESS : FAILURE;
 }
 
 
 
 
-int8_t SPIFFS_Memory::optimize()
+bool SPIFFS_Memory::_readKey(File& file, Record& record)
 {
-	return _optimizeMemory(0, 0, true);
-}
+	int currentChar = file.read();
 
+	// Skipping the separators left between records
+	while ((currentChar == '\n') || (currentChar == '\0'))
+	{
+		currentChar = file.read();
+	}
 
+	if (currentChar == -1)
+	{
+		return false;
+	}
 
+	record.offset = file.position() - 1;
 
-String SPIFFS_Memory::get(const String& key, const String& defaultValue)
-{
-	if (_isInitiated)
+	if (currentChar == KEY_SHARED_MARKER)
 	{
-		// Opening and reading the file contents
-		File file = SPIFFS.open(_FILE_NAME, "r");
-
-		_print("Size: " + String(file.size()));
+		// Front coded key, record.key holds the key of the previous record
+		int shared = dbHexValue((char)file.read()) << 4;
+		shared = shared | dbHexValue((char)file.read());
+		record.key = record.key.substring(0, shared);
+		currentChar = file.read();
+	}
+	else
+	{
+		record.key = "";
+	}
 
-		if (!file)
+	while (currentChar != '>')
+	{
+		if ((currentChar == '\n') || (currentChar == -1))
 		{
-			_print("Get operation failed");
-			return defaultValue;
+			// Malformed record, no active flag present
+			return false;
 		}
-		else 
-		{
-			int keyIndex = _indexOfKey(key);
 
-			if (keyIndex == -1)
-			{
-				return defaultValue;
-			}
-			else
-			{
-				String data = "";
-				file.seek(keyIndex, SeekSet);
-				char currentChar = (char)file.read();
+		record.key = record.key + String((char)currentChar);
+		currentChar = file.read();
+	}
 
-				while (currentChar != '\n') 
-				{
-					data = data + currentChar;
+	record.flagOffset = file.position();
+	record.flag = (char)file.read();
+	record.expiry = 0;
 
-					currentChar = (char)file.read();
-				}
+	if (dbFlagBits(record.flag) & RECORD_EXPIRES)
+	{
+		for (int i = 0 ; i < 8 ; i++)
+		{
+			record.expiry = (record.expiry << 4) | dbHexValue((char)file.read());
+		}
+	}
 
-				_print(data);
+	return true;
+}
 
-				// int activeSepIdx = data.indexOf('>');
 
-				// TODO: Structure to pass key and value maybe
-				// Obtaining value from the key
-				int seperatorIndex = data.indexOf(':');
 
-				data = data.substring(++seperatorIndex);
 
-				file.close();
-				_print("Get operation successfull");
+void SPIFFS_Memory::_readValue(File& file, ValueDecoder* decoder)
+{
+	char buffer[READ_CHUNK_SIZE];
+	bool isValue = false;
 
-				return data;
+	// Reading a chunk at a time and searching the separators in the whole chunk
+	while (true)
+	{
+		int position = file.position();
+		int count = file.read((uint8_t*)buffer, READ_CHUNK_SIZE);
+
+		if (count <= 0)
+		{
+			return;
+		}
+
+		int end = dbFindByte(buffer, count, '\n');
+		int used = (end == -1) ? count : end;
+		int i = 0;
+
+		if (!isValue)
+		{
+			int sep = dbFindByte(buffer, used, ':');
+
+			isValue = (sep != -1);
+			i = isValue ? (sep + 1) : used;
+		}
+
+		if (decoder != NULL)
+		{
+			for ( ; i < used ; i++)
+			{
+				decoder->feed(buffer[i]);
 			}
 		}
+
+		if (end != -1)
+		{
+			// Moving back to the start of the next record
+			file.seek(position + end + 1, SeekSet);
+			return;
+		}
 	}
-	else
+}
+
+
+
+
+int SPIFFS_Memory::_recordEnd(File& file)
+{
+	_readValue(file, NULL);
+
+	int end = file.position();
+
+	// Incomplete last record, the file ends before its new line
+	if ((end == 0) || !file.seek(end - 1, SeekSet) || (file.read() != '\n'))
 	{
-		_print("System not initiated");
+		return -1;
 	}
-	
-	_print("GET CALLED");
-	return defaultValue;
+
+	return end;
 }
 
 
 
 
-String SPIFFS_Memory::getAll()
+bool SPIFFS_Memory::_copyRecord(File& file, File& staging, const String& key, int start, int end)
 {
-	if (_isInitiated)
+	char buffer[READ_CHUNK_SIZE];
+
+	if (staging.print(key) != key.length())
 	{
-		File file = SPIFFS.open(_FILE_NAME, "r");
+		return false;
+	}
 
-		if (!file) 
+	file.seek(start, SeekSet);
+
+	while (start < end)
+	{
+		int wanted = ((end - start) < READ_CHUNK_SIZE) ? (end - start) : READ_CHUNK_SIZE;
+		int count = file.read((uint8_t*)buffer, wanted);
+
+		if ((count <= 0) || (staging.write((uint8_t*)buffer, count) != (size_t)count))
 		{
-			_print("GETALL operation failed");
-			return "";
+			return false;
 		}
-		else
-		{
-			// Reading data from file
-			String data = "";
 
-			for (int i = 0 ; i < file.size() ; i++)
+		start = start + count;
+	}
+
+	return true;
+}
+
+
+
+
+bool SPIFFS_Memory::_buildDirectory(File& file)
+{
+	_print("Building key directory");
+
+	_directory.clear();
+
+	if (file)
+	{
+		Record record;
+		file.seek(0, SeekSet);
+
+		while (_readKey(file, record))
+		{
+			// Expired records are kept in the directory until removed, so that inserts can replace them
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && (_directory.find(record.key) == -1))
 			{
-				data = data + String((char)file.read());
+				if (!_directory.put(record.key, record.offset))
+				{
+					_print("Memory not available for directory");
+					_directory.clear();
+					return false;
+				}
 			}
 
-			file.close();
-			return data;
+			_readValue(file, NULL);
 		}
-		
-	}
-	else
-	{
-		_print("System not initiated");
 	}
 
-	return "";
+	_directoryBuilt = true;
+
+	return true;
 }
 
 
 
 
-int8_t SPIFFS_Memory::insert(const String& key, const String& value)
+int SPIFFS_Memory::_scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context)
 {
-	_print("INSERT CALLED");
-	
-	if (_isInitiated) 
+	int visited = 0;
+	File file = _acquire(false);
+
+	if (!file)
 	{
-		// Opening/creating the file and writing the key, value pair into the file
-		if (!SPIFFS.exists(_FILE_NAME))
-		{
-			// Create the File
-			File file = SPIFFS.open(_FILE_NAME, "w");
-			file.close();
-		}
+		return visited;
+	}
+
+	if (!_directoryBuilt && !_buildDirectory(file))
+	{
+		_release(file);
+		return visited;
+	}
 
-		File file = SPIFFS.open(_FILE_NAME, "r+");
+	Record record;
+	String value = "";
 
-		if (!file) 
+	// Binary search for the first key, then reading the records in sorted order
+	for (int pos = _directory.lowerBound(low) ; pos < _directory.size() ; pos++)
+	{
+		const String& key = _directory.keyAt(pos);
+
+		if (isPrefix ? !key.startsWith(low) : (key.compareTo(high) >= 0))
 		{
-			_print("Insert operation failed");
-			return FAILURE;
+			break;
 		}
-		else 
-		{
-			String data = key + ">1:" + value + "\n";
-
-			// Finding the kye index if key already exists
-			int keyIndex = _indexOfKey(key);
 
-			_print("Key index: " + String(keyIndex));
+		file.seek(_directory.offsetAt(pos), SeekSet);
+		record.key = key.c_str();
 
-			if (keyIndex != -1) 
-			{
-				// Key already exists, remove that key
-				remove(key);
-				file.seek(keyIndex, SeekSet);
-			}
+		if (!_readKey(file, record))
+		{
+			break;
+		}
 
-			// Before writing to file performing optimizations if required
-			int optimize_res = _optimizeMemory(data.length(), file.size(), false);
+		if (!dbIsLive(record))
+		{
+			continue;
+		}
 
-			if (optimize_res == FAILURE)
-				return FAILURE;
-			else if (optimize_res == MEM_FULL)
-				return MEM_FULL;
-			
-			// Adding key value pair
-			file.seek(0, SeekEnd);
-			file.print(data);
-			file.close();
+		value = "";
+		ValueDecoder decoder(&value, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+		_readValue(file, &decoder);
+		visited++;
 
-			_print("Insert operation successfull");
-			return SUCCESS;
+		if (!callback(key, value, context))
+		{
+			break;
 		}
 	}
-	else
-	{
-		_print("System not initiated");
-	}
 
-	return FAILURE;
+	_release(file);
+
+	return visited;
 }
 
+// ************************************************************
 
 
 
-bool SPIFFS_Memory::remove(const String& key)
+// ****************** PUBLIC METHODS **************************
+bool SPIFFS_Memory::begin()
 {
-	if (_isInitiated)
+	_print("Initializing the system");
+
+	if (SPIFFS.begin())
 	{
-		File file = SPIFFS.open(_FILE_NAME, "r+");
+		_isInitiated = true;
 
-		if (!file) 
+#if defined(THREAD_SAFE)
+		if (_pinLock == NULL)
 		{
-			_print("REMOVE operation failed");
-			return FAILURE;
+			_pinLock = xSemaphoreCreateMutex();
 		}
-		else 
-		{
-			// Finding the kye index if key already exists
-			int keyIndex = _indexOfKey(key);
-
-			_print(String(keyIndex));
+#endif
 
-			if (keyIndex == -1) 
+		// A reset between moving the file to its version and renaming its copy to it
+		if (SPIFFS.exists(_pendingName()))
+		{
+			if (!SPIFFS.exists(_FILE_NAME))
 			{
-				// Key does not exists
-				_print("Key not found");
-				return FAILURE;
+				_print("Restoring the file from " + _pendingName());
+				SPIFFS.rename(_pendingName(), _FILE_NAME);
 			}
 			else
 			{
-				// Key exists
-				// Writing empty/space characters at that key
-				int idx = keyIndex;
-				file.seek(idx, SeekSet);
-				char currentChar = (char)file.read();
+				SPIFFS.remove(_pendingName());
+			}
+		}
 
-				while (currentChar != '>') 
-				{
-					file.seek(idx, SeekSet);
+		// Versions left by snapshots of a previous run, the data is never kept only in them
+		for (int i = 0 ; i < SNAPSHOT_MAX_VERSIONS ; i++)
+		{
+			if ((_pinRefs[i] == 0) && SPIFFS.exists(_pinName(i)))
+			{
+				SPIFFS.remove(_pinName(i));
+			}
+		}
 
-					idx++;
-					currentChar = (char)file.read();
-				}
+		return SUCCESS;
+	}
+	else
+	{
+		_isInitiated = false;
 
-				file.print("0");
+		return FAILURE;
+	}
+}
 
-				file.close();
 
-				_print("REMOVE operation successfull");
 
-				return SUCCESS;
-			}
+
+bool SPIFFS_Memory::format()
+{
+	_print("Formatting the system");
+
+	if (_isInitiated)
+	{
+		_file.close();
+		_detachSnapshots(_file, false);
+		_directory.clear();
+		_directoryBuilt = false;
+
+		if (SPIFFS.format())
+		{
+			return SUCCESS;
+		}
+		else
+		{
+			return FAILURE;
 		}
 	}
 	else
@@ -492,23 +873,24 @@ bool SPIFFS_Memory::remove(const String& key)
 		_print("System not initiated");
 	}
 
-	_print("REMOVE CALLED");
-
 	return FAILURE;
 }
 
 
 
 
-bool SPIFFS_Memory::exists(const String& key)
+bool SPIFFS_Memory::clear()
 {
-	_print("EXISTS CALLED");
-	
+	_print("Clearing " + _FILE_NAME);
+
 	if (_isInitiated)
 	{
-		int idx = _indexOfKey(key);
+		_file.close();
+		_detachSnapshots(_file, false);
+		_directory.clear();
+		_directoryBuilt = false;
 
-		if (idx != -1) 
+		if (!SPIFFS.exists(_FILE_NAME) || SPIFFS.remove(_FILE_NAME))
 		{
 			return SUCCESS;
 		}
@@ -516,7 +898,6 @@ bool SPIFFS_Memory::exists(const String& key)
 		{
 			return FAILURE;
 		}
-		
 	}
 	else
 	{
@@ -526,6 +907,1436 @@ bool SPIFFS_Memory::exists(const String& key)
 	return FAILURE;
 }
 
+
+
+
+int8_t SPIFFS_Memory::optimize()
+{
+	// The file is created by the first write, there is nothing to compact before that
+	if (_isInitiated && !SPIFFS.exists(_FILE_NAME))
+	{
+		return SUCCESS;
+	}
+
+	File file = _acquire(false);
+	int8_t result = _optimizeMemory(file, 0, 0, true);
+
+	_release(file);
+
+	return result;
+}
+
+
+
+
+void SPIFFS_Memory::setCompression(uint16_t minSize)
+{
+	_compressMinSize = minSize;
+}
+
+
+
+
+String SPIFFS_Memory::get(const DbKey& key, const String& defaultValue)
+{
+	bool found;
+
+	return get(key, defaultValue, found);
+}
+
+
+
+
+String SPIFFS_Memory::get(const DbKey& key, const String& defaultValue, bool& found)
+{
+	found = false;
+
+	if (_isInitiated)
+	{
+		// Opening and reading the file contents
+		File file = _acquire(false);
+
+		_print("Size: " + String(file.size()));
+
+		if (!file)
+		{
+			_print("Get operation failed");
+			return defaultValue;
+		}
+		else 
+		{
+			int keyIndex = _indexOfKey(file, key, false);
+
+			if (keyIndex == -1)
+			{
+				_release(file);
+				return defaultValue;
+			}
+			else
+			{
+				found = true;
+
+				String data = "";
+				Record record;
+				record.key = key.c_str();
+				file.seek(keyIndex, SeekSet);
+
+				if (_readKey(file, record))
+				{
+					ValueDecoder decoder(&data, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+					_readValue(file, &decoder);
+				}
+
+				_release(file);
+				_print("Get operation successfull");
+
+				return data;
+			}
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+	
+	_print("GET CALLED");
+	return defaultValue;
+}
+
+
+
+
+int SPIFFS_Memory::get(const DbKey& key, char* buffer, size_t bufferSize)
+{
+	_print("GET CALLED");
+
+	if ((buffer == NULL) || (bufferSize == 0))
+	{
+		return -1;
+	}
+
+	buffer[0] = '\0';
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+		Record record;
+
+		if (!file)
+		{
+			_print("Get operation failed");
+			return -1;
+		}
+
+		int keyIndex = _indexOfKey(file, key, false);
+
+		if (keyIndex == -1)
+		{
+			_release(file);
+			return -1;
+		}
+
+		file.seek(keyIndex, SeekSet);
+		record.key = key.c_str();
+
+		if (!_readKey(file, record))
+		{
+			_release(file);
+			return -1;
+		}
+
+		// Leaving space for the null character
+		ValueDecoder decoder(buffer, bufferSize - 1, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+		int currentChar = file.read();
+
+		while ((currentChar != ':') && (currentChar != -1))
+		{
+			currentChar = file.read();
+		}
+
+		currentChar = file.read();
+
+		while ((currentChar != '\n') && (currentChar != -1) && !decoder.isFull())
+		{
+			decoder.feed((char)currentChar);
+			currentChar = file.read();
+		}
+
+		_release(file);
+
+		buffer[decoder.length()] = '\0';
+
+		return decoder.length();
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return -1;
+}
+
+
+
+
+String SPIFFS_Memory::getAll()
+{
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file) 
+		{
+			_print("GETALL operation failed");
+			return "";
+		}
+		else
+		{
+			// Reading data from file
+			String data = "";
+
+			for (size_t i = 0 ; i < file.size() ; i++)
+			{
+				data = data + String((char)file.read());
+			}
+
+			_release(file);
+			return dbDecodeRecords(data);
+		}
+		
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return "";
+}
+
+
+
+
+int SPIFFS_Memory::getMany(const String keys[], String values[], int count, const String& defaultValue)
+{
+	_print("GETMANY CALLED");
+
+	int found = 0;
+
+	for (int i = 0 ; i < count ; i++)
+	{
+		values[i] = defaultValue;
+	}
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			_print("GETMANY operation failed");
+			return found;
+		}
+
+		KeyLookup lookup(keys, count);
+		int distinct = lookup.distinctCount();
+		Record record;
+
+		// Single pass over the file, stopping early once all keys are found
+		while ((found < distinct) && _readKey(file, record))
+		{
+			int keyIdx = dbIsLive(record) ? lookup.find(record.key) : -1;
+
+			if (keyIdx != -1)
+			{
+				values[keyIdx] = "";
+				ValueDecoder decoder(&values[keyIdx], dbFlagBits(record.flag) & RECORD_COMPRESSED);
+				_readValue(file, &decoder);
+				found++;
+			}
+			else
+			{
+				_readValue(file, NULL);
+			}
+		}
+
+		_release(file);
+
+		// Copying values for the keys requested more than once
+		for (int i = 0 ; i < count ; i++)
+		{
+			int keyIdx = lookup.find(keys[i]);
+
+			if (keyIdx != i)
+			{
+				values[i] = values[keyIdx];
+			}
+		}
+
+		_print("Keys found: " + String(found));
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return found;
+}
+
+
+
+
+int8_t SPIFFS_Memory::insert(const DbKey& key, const String& value)
+{
+	return insert(key, value, 0);
+}
+
+
+
+
+int8_t SPIFFS_Memory::insert(const DbKey& key, const String& value, uint32_t ttlSeconds)
+{
+	return insertAt(key, value, (ttlSeconds > 0) ? (dbNow() + ttlSeconds) : 0);
+}
+
+
+
+
+int8_t SPIFFS_Memory::insertAt(const DbKey& key, const String& value, uint32_t expiry)
+{
+	_print("INSERT CALLED");
+	
+	if (_isInitiated) 
+	{
+		// Opening/creating the file and writing the key, value pair into the file
+		File file = _acquire(true);
+
+		if (!file) 
+		{
+			_print("Insert operation failed");
+			return FAILURE;
+		}
+		else 
+		{
+			String data = dbEncodeRecordAt(key, value, expiry, _compressMinSize);
+
+			// Finding the kye index if key already exists, expired records are replaced as well
+			int keyIndex = _indexOfKey(file, key, true);
+
+			_print("Key index: " + String(keyIndex));
+
+			if (keyIndex != -1) 
+			{
+				// Key already exists, remove that key
+				_deactivate(file, keyIndex);
+
+				if (_directoryBuilt)
+				{
+					_directory.erase(key);
+				}
+			}
+
+			// Before writing to file performing optimizations if required
+			int optimize_res = _optimizeMemory(file, data.length(), file.size(), false);
+
+			if (optimize_res != SUCCESS)
+			{
+				_release(file);
+				return optimize_res;
+			}
+			
+			// Adding key value pair
+			file.seek(0, SeekEnd);
+
+			if (_directoryBuilt)
+			{
+				_directory.put(key.c_str(), file.position());
+			}
+
+			file.print(data);
+			_release(file);
+
+			_print("Insert operation successfull");
+			return SUCCESS;
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+int8_t SPIFFS_Memory::putMany(const String keys[], const String values[], int count)
+{
+	return putMany(keys, values, NULL, NULL, count);
+}
+
+
+
+
+int8_t SPIFFS_Memory::putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count)
+{
+	if (ttlSeconds == NULL)
+	{
+		return putManyAt(keys, values, NULL, removed, count);
+	}
+
+	uint32_t* expiries = new uint32_t[count];
+	dbExpiryTimes(ttlSeconds, expiries, count);
+
+	int8_t result = putManyAt(keys, values, expiries, removed, count);
+
+	delete[] expiries;
+
+	return result;
+}
+
+
+
+
+int8_t SPIFFS_Memory::putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count)
+{
+	_print("PUTMANY CALLED");
+
+	if (_isInitiated)
+	{
+		File file = _acquire(true);
+
+		if (!file)
+		{
+			_print("PUTMANY operation failed");
+			return FAILURE;
+		}
+
+		KeyLookup lookup(keys, count);
+		Record record;
+		String data = "";
+		int* offsets = new int[count];
+
+		for (int i = 0 ; i < count ; i++)
+		{
+			// Only the last value of a repeated key is stored, offsets are relative to the start of data
+			if ((lookup.find(keys[i]) == i) && !((removed != NULL) && removed[i]))
+			{
+				offsets[i] = data.length();
+				data = data + dbEncodeRecordAt(keys[i], values[i], (expiries != NULL) ? expiries[i] : 0, _compressMinSize);
+			}
+		}
+
+		// Before changing any record performing optimizations if required, so nothing is changed if the values do not fit
+		int optimize_res = _optimizeMemory(file, data.length(), file.size(), false);
+
+		if (optimize_res != SUCCESS)
+		{
+			delete[] offsets;
+			_release(file);
+			return optimize_res;
+		}
+
+		// Single pass over the file, de-activating the existing records of all the keys
+		file.seek(0, SeekSet);
+
+		while (_readKey(file, record))
+		{
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && (lookup.find(record.key) != -1))
+			{
+				_detachSnapshots(file, true);
+				file.seek(record.flagOffset, SeekSet);
+				file.print("0");
+			}
+
+			_readValue(file, NULL);
+		}
+
+		// Single append for all the key value pairs
+		file.seek(0, SeekEnd);
+
+		if (_directoryBuilt)
+		{
+			for (int i = 0 ; i < count ; i++)
+			{
+				if (lookup.find(keys[i]) != i)
+				{
+					continue;
+				}
+
+				if ((removed != NULL) && removed[i])
+				{
+					_directory.erase(keys[i]);
+				}
+				else
+				{
+					_directory.put(keys[i], file.size() + offsets[i]);
+				}
+			}
+		}
+
+		delete[] offsets;
+
+		file.print(data);
+		_release(file);
+
+		_print("PUTMANY operation successfull");
+		return SUCCESS;
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+bool SPIFFS_Memory::remove(const DbKey& key)
+{
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file) 
+		{
+			_print("REMOVE operation failed");
+			return FAILURE;
+		}
+		else 
+		{
+			// Finding the kye index if key already exists, expired records are de-activated as well
+			int keyIndex = _indexOfKey(file, key, true);
+			Record record;
+			record.key = key.c_str();
+
+			// An expired key was not found for the caller
+			bool isLive = (keyIndex != -1) && file.seek(keyIndex, SeekSet) && _readKey(file, record) && dbIsLive(record);
+
+			_print(String(keyIndex));
+
+			if (keyIndex == -1) 
+			{
+				// Key does not exists
+				_print("Key not found");
+				_release(file);
+				return FAILURE;
+			}
+			else
+			{
+				// Key exists
+				_deactivate(file, keyIndex);
+				_release(file);
+
+				if (_directoryBuilt)
+				{
+					_directory.erase(key);
+				}
+
+				_print("REMOVE operation successfull");
+
+				return isLive ? SUCCESS : FAILURE;
+			}
+		}
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	_print("REMOVE CALLED");
+
+	return FAILURE;
+}
+
+
+
+
+bool SPIFFS_Memory::exists(const DbKey& key)
+{
+	_print("EXISTS CALLED");
+	
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			return FAILURE;
+		}
+
+		int idx = _indexOfKey(file, key, false);
+		_release(file);
+
+		if (idx != -1) 
+		{
+			return SUCCESS;
+		}
+		else
+		{
+			return FAILURE;
+		}
+		
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return FAILURE;
+}
+
+
+
+
+uint32_t SPIFFS_Memory::expiresAt(const DbKey& key)
+{
+	_print("EXPIRESAT CALLED");
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+		Record record;
+		record.key = key.c_str();
+
+		if (!file)
+		{
+			_print("EXPIRESAT operation failed");
+			return 0;
+		}
+
+		int idx = _indexOfKey(file, key, false);
+
+		if ((idx == -1) || !file.seek(idx, SeekSet) || !_readKey(file, record))
+		{
+			record.expiry = 0;
+		}
+
+		_release(file);
+
+		return record.expiry;
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int SPIFFS_Memory::sweep(int maxRecords)
+{
+	_print("SWEEP CALLED");
+
+	int removed = 0;
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			_print("SWEEP operation failed");
+			return removed;
+		}
+
+		Record record;
+		record.key = "";
+
+		if (_sweepIdx < file.size())
+		{
+			file.seek(_sweepIdx, SeekSet);
+			record.key = _sweepKey;
+		}
+		bool reachedEnd = false;
+
+		for (int i = 0 ; i < maxRecords ; i++)
+		{
+			if (!_readKey(file, record))
+			{
+				reachedEnd = true;
+				break;
+			}
+
+			if ((dbFlagBits(record.flag) & RECORD_ACTIVE) && !dbIsLive(record))
+			{
+				int position = file.position();
+
+				_detachSnapshots(file, true);
+				file.seek(record.flagOffset, SeekSet);
+				file.print("0");
+				file.seek(position, SeekSet);
+				removed++;
+
+				if (_directoryBuilt)
+				{
+					_directory.erase(record.key);
+				}
+			}
+
+			_readValue(file, NULL);
+		}
+
+		// At the end of file, next sweep starts from the beginning
+		_sweepIdx = reachedEnd ? 0 : file.position();
+		_sweepKey = record.key;
+
+		_release(file);
+
+		_print("Expired records removed: " + String(removed));
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return removed;
+}
+
+
+
+
+DbUsage SPIFFS_Memory::getUsage()
+{
+	DbUsage usage;
+
+	usage.capacity = 0;
+	usage.usedBytes = 0;
+	usage.liveBytes = 0;
+	usage.deadBytes = 0;
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			return usage;
+		}
+
+		usage.capacity = _capacity(file.size());
+
+		Record record;
+		record.key = "";
+
+		while (_readKey(file, record))
+		{
+			_readValue(file, NULL);
+
+			int length = file.position() - record.offset;
+
+			if (dbIsLive(record))
+			{
+				usage.liveBytes = usage.liveBytes + length;
+			}
+			else
+			{
+				usage.deadBytes = usage.deadBytes + length;
+			}
+		}
+
+		usage.usedBytes = file.size();
+
+		_release(file);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return usage;
+}
+
+
+
+
+uint32_t SPIFFS_Memory::capacity()
+{
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return 0;
+	}
+
+	File file = _acquire(false);
+	uint32_t fileSize = file ? file.size() : 0;
+
+	if (file)
+	{
+		_release(file);
+	}
+
+	return _capacity(fileSize);
+}
+
+
+
+
+uint32_t SPIFFS_Memory::freeSpace()
+{
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return 0;
+	}
+
+	File file = _acquire(false);
+	uint32_t fileSize = file ? file.size() : 0;
+
+	if (file)
+	{
+		_release(file);
+	}
+
+	uint32_t capacity = _capacity(fileSize);
+
+	return (capacity > fileSize) ? (capacity - fileSize) : 0;
+}
+
+
+
+
+bool SPIFFS_Memory::buildDirectory()
+{
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	if (_directoryBuilt)
+	{
+		return SUCCESS;
+	}
+
+	File file = _acquire(false);
+
+	if (!file)
+	{
+		return FAILURE;
+	}
+
+	bool res = _buildDirectory(file);
+	_release(file);
+
+	return res;
+}
+
+
+
+
+int SPIFFS_Memory::scanPrefix(const String& prefix, ScanCallback callback, void* context)
+{
+	_print("SCANPREFIX CALLED");
+
+	if (_isInitiated)
+	{
+		return _scan(prefix, "", true, callback, context);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int SPIFFS_Memory::scanRange(const String& low, const String& high, ScanCallback callback, void* context)
+{
+	_print("SCANRANGE CALLED");
+
+	if (_isInitiated)
+	{
+		return _scan(low, high, false, callback, context);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return 0;
+}
+
+
+
+
+int SPIFFS_Memory::scanKeys(ScanCallback callback, void* context)
+{
+	_print("SCANKEYS CALLED");
+
+	int visited = 0;
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			return visited;
+		}
+
+		Record record;
+		String value = "";
+		file.seek(0, SeekSet);
+
+		// Single pass over the file, the values are skipped and no key is kept in memory
+		while (_readKey(file, record))
+		{
+			_readValue(file, NULL);
+
+			if (dbIsLive(record))
+			{
+				visited++;
+
+				if (!callback(record.key, value, context))
+				{
+					break;
+				}
+			}
+		}
+
+		_release(file);
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return visited;
+}
+
+
+
+
+int SPIFFS_Memory::exportTo(BackupWriter& writer)
+{
+	_print("EXPORT CALLED");
+
+	int exported = 0;
+
+	if (_isInitiated)
+	{
+		File file = _acquire(false);
+
+		if (!file)
+		{
+			// No file yet, nothing to export
+			return exported;
+		}
+
+		Record record;
+		record.key = "";
+		String value = "";
+
+		// Single pass over the file, only one value is held in RAM at a time
+		while (_readKey(file, record))
+		{
+			if (!dbIsLive(record))
+			{
+				_readValue(file, NULL);
+				continue;
+			}
+
+			value = "";
+			ValueDecoder decoder(&value, dbFlagBits(record.flag) & RECORD_COMPRESSED);
+			_readValue(file, &decoder);
+
+			writer.add(record.key, value, record.expiry);
+			exported++;
+		}
+
+		_release(file);
+
+		_print("Records exported: " + String(exported));
+	}
+	else
+	{
+		_print("System not initiated");
+	}
+
+	return exported;
+}
+
+
+
+
+int8_t SPIFFS_Memory::importFrom(Stream& in)
+{
+	_print("IMPORT CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	// The staging file replaces the file, so its size is limited by the capacity left by the other files
+	int limit = (int)capacity();
+	String stagingName = _stagingName();
+	File staging = SPIFFS.open(stagingName, "w");
+
+	if (!staging)
+	{
+		_print("Import operation failed");
+		return FAILURE;
+	}
+
+	BackupReader reader(in);
+	String key;
+	String value;
+	uint32_t expiry;
+	uint32_t now = dbNow();
+	int size = 0;
+	int8_t result = SUCCESS;
+
+	// Single sequential write of the records, the file is replaced only once the whole backup is checked
+	while (reader.next(key, value, expiry))
+	{
+		if ((result != SUCCESS) || ((expiry != 0) && (expiry <= now)))
+		{
+			continue;
+		}
+
+		String data = dbEncodeRecordAt(key, value, expiry, _compressMinSize);
+		size = size + data.length();
+
+		if (size >= limit)
+		{
+			// Reading the rest anyway, so that a corrupted backup is still reported as such
+			_print("Memory full, backup does not fit");
+			result = MEM_FULL;
+		}
+		else if (staging.print(data) != data.length())
+		{
+			_print("Write operation failed");
+			result = FAILURE;
+		}
+	}
+
+	staging.close();
+
+	if (!reader.isValid())
+	{
+		_print("Backup incomplete or corrupted");
+		result = FAILURE;
+	}
+
+	if (result != SUCCESS)
+	{
+		SPIFFS.remove(stagingName);
+		return result;
+	}
+
+	_directory.clear();
+	_directoryBuilt = false;
+
+	if (!_replaceFile(stagingName))
+	{
+		_print("Import operation failed");
+		return FAILURE;
+	}
+
+	_print("Import operation successful");
+	return SUCCESS;
+}
+
+
+
+
+int8_t SPIFFS_Memory::load(BulkLoader& loader)
+{
+	_print("LOAD CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	if (!loader.rewind())
+	{
+		return FAILURE;
+	}
+
+	int limit = (int)capacity();
+	String stagingName = _stagingName();
+	File staging = SPIFFS.open(stagingName, "w");
+
+	if (!staging)
+	{
+		_print("Load operation failed");
+		return FAILURE;
+	}
+
+	String key;
+	String value;
+	String previousKey = "";
+	int written = 0;
+	int size = 0;
+	bool indexed = true;
+	int8_t result = SUCCESS;
+
+	_directory.clear();
+	_directoryBuilt = false;
+
+	// Pairs come sorted and without repeated keys, so the records are written as compaction writes them
+	// and every key is appended to the end of the directory
+	while ((result == SUCCESS) && loader.next(key, value))
+	{
+		String record = dbEncodeRecord(key, value, 0, _compressMinSize);
+		String data = ((written % KEY_RESTART_INTERVAL) == 0) ? key : dbEncodeKey(previousKey, key);
+		data += record.substring(key.length());
+
+		if (indexed && !_directory.put(key, size))
+		{
+			_print("Memory not available for directory");
+			_directory.clear();
+			indexed = false;
+		}
+
+		size = size + data.length();
+		previousKey = key;
+		written++;
+
+		if (size >= limit)
+		{
+			_print("Memory full, pairs do not fit");
+			result = MEM_FULL;
+		}
+		else if (staging.print(data) != data.length())
+		{
+			_print("Write operation failed");
+			result = FAILURE;
+		}
+	}
+
+	staging.close();
+
+	if ((result == SUCCESS) && !loader.isValid())
+	{
+		result = FAILURE;
+	}
+
+	if ((result != SUCCESS) || !_replaceFile(stagingName))
+	{
+		SPIFFS.remove(stagingName);
+		_directory.clear();
+
+		return (result != SUCCESS) ? result : FAILURE;
+	}
+
+	_directoryBuilt = indexed;
+
+	_print("Pairs loaded: " + String(written));
+
+	return SUCCESS;
+}
+
+
+
+
+int8_t SPIFFS_Memory::pinSnapshot(uint32_t& size)
+{
+	_print("PINSNAPSHOT CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return -1;
+	}
+
+	_lockPins();
+
+	// Snapshots taken while the file is not modified in place share its version
+	int8_t slot = _livePin;
+
+	for (int i = 0 ; (slot == -1) && (i < SNAPSHOT_MAX_VERSIONS) ; i++)
+	{
+		if (_pinRefs[i] == 0)
+		{
+			slot = i;
+			_pinMoved[i] = false;
+			_livePin = i;
+		}
+	}
+
+	if (slot != -1)
+	{
+		_pinRefs[slot]++;
+	}
+
+	_unlockPins();
+
+	if (slot == -1)
+	{
+		_print("No free version for the snapshot");
+		return -1;
+	}
+
+	File file = _acquire(false);
+	size = file ? file.size() : 0;
+
+	if (file)
+	{
+		_release(file);
+	}
+
+	return slot;
+}
+
+
+
+
+File SPIFFS_Memory::openSnapshot(int8_t slot)
+{
+	File file;
+
+	_lockPins();
+
+	String name = _pinMoved[slot] ? _pinName(slot) : _FILE_NAME;
+
+	if (SPIFFS.exists(name))
+	{
+		file = SPIFFS.open(name, "r");
+	}
+
+	_unlockPins();
+
+	return file;
+}
+
+
+
+
+void SPIFFS_Memory::unpinSnapshot(int8_t slot)
+{
+	_lockPins();
+
+	if (_pinRefs[slot] > 0)
+	{
+		_pinRefs[slot]--;
+
+		if (_pinRefs[slot] == 0)
+		{
+			if (_livePin == slot)
+			{
+				_livePin = -1;
+			}
+			else if (SPIFFS.exists(_pinName(slot)))
+			{
+				// Deferred until the last snapshot of the version is released
+				SPIFFS.remove(_pinName(slot));
+			}
+		}
+	}
+
+	_unlockPins();
+}
+
+
+
+
+bool SPIFFS_Memory::writeJournal(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count)
+{
+	_print("WRITEJOURNAL CALLED");
+
+	File journal = SPIFFS.open(_journalName(), "w");
+
+	if (!journal)
+	{
+		_print("Journal can not be created");
+		return FAILURE;
+	}
+
+	BackupWriter writer(journal);
+
+	// Times at which the keys expire, so a replay after a reset writes the same ones
+	for (int i = 0 ; i < count ; i++)
+	{
+		writer.add(keys[i], removed[i] ? "" : values[i], removed[i] ? JOURNAL_REMOVED : expiries[i]);
+	}
+
+	// Closing makes the size of the file durable, a journal cut short by a reset fails its CRC
+	bool written = writer.finish();
+	journal.close();
+
+	if (!written)
+	{
+		_print("Journal write failed");
+		SPIFFS.remove(_journalName());
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+
+
+
+int SPIFFS_Memory::readJournal(String keys[], String values[], uint32_t expiries[], bool removed[], int maxCount)
+{
+	if (!SPIFFS.exists(_journalName()))
+	{
+		return -1;
+	}
+
+	File journal = SPIFFS.open(_journalName(), "r");
+
+	if (!journal)
+	{
+		return -1;
+	}
+
+	BackupReader reader(journal);
+	uint32_t now = dbNow();
+	int count = 0;
+
+	while ((count < maxCount) && reader.next(keys[count], values[count], expiries[count]))
+	{
+		removed[count] = (expiries[count] != 0) && (expiries[count] <= now);
+		count++;
+	}
+
+	bool valid = reader.isValid();
+	journal.close();
+
+	if (!valid)
+	{
+		// Written only partly, the transaction was not committed
+		_print("Journal incomplete");
+		return -1;
+	}
+
+	return count;
+}
+
+
+
+
+void SPIFFS_Memory::clearJournal()
+{
+	if (SPIFFS.exists(_journalName()))
+	{
+		SPIFFS.remove(_journalName());
+	}
+}
+
+
+
+
+void SPIFFS_Memory::setAsideJournal()
+{
+	String name = _failedJournalName();
+
+	_print("Journal could not be replayed, moving it to " + name);
+
+	// Rename does not replace an existing file on all the boards
+	if (SPIFFS.exists(name))
+	{
+		SPIFFS.remove(name);
+	}
+
+	if (!SPIFFS.rename(_journalName(), name))
+	{
+		clearJournal();
+	}
+}
+
+
+
+
+int8_t SPIFFS_Memory::commitTransaction(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count)
+{
+	_print("COMMITTRANSACTION CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	// Expiry times are taken once, so the journal and the file hold the same ones
+	uint32_t* expiries = new uint32_t[count];
+	dbExpiryTimes(ttlSeconds, expiries, count);
+
+	if (!writeJournal(keys, values, expiries, removed, count))
+	{
+		delete[] expiries;
+		clearJournal();
+		return FAILURE;
+	}
+
+	int8_t result = putManyAt(keys, values, expiries, removed, count);
+
+	// Part of the changes may be written, writing them again gives the same result
+	if (result == FAILURE)
+	{
+		result = (putManyAt(keys, values, expiries, removed, count) == SUCCESS) ? SUCCESS : FAILURE;
+	}
+
+	delete[] expiries;
+
+	// Nothing was written if the changes do not fit, a failed transaction is never replayed by the next begin
+	if (result == FAILURE)
+	{
+		setAsideJournal();
+	}
+	else
+	{
+		clearJournal();
+	}
+
+	return result;
+}
+
+
+
+
+int8_t SPIFFS_Memory::replayJournal()
+{
+	_print("REPLAYJOURNAL CALLED");
+
+	String* keys = new String[TRANSACTION_MAX_KEYS];
+	String* values = new String[TRANSACTION_MAX_KEYS];
+	uint32_t* expiries = new uint32_t[TRANSACTION_MAX_KEYS];
+	bool* removed = new bool[TRANSACTION_MAX_KEYS];
+	int count = readJournal(keys, values, expiries, removed, TRANSACTION_MAX_KEYS);
+	int8_t result = SUCCESS;
+
+	if (count > 0)
+	{
+		_print("Replaying " + String(count) + " changes");
+
+		// Writing a change again gives the same result, so changes written before the reset do not matter
+		result = (putManyAt(keys, values, expiries, removed, count) == SUCCESS) ? SUCCESS : FAILURE;
+	}
+
+	if (result == SUCCESS)
+	{
+		clearJournal();
+	}
+	else
+	{
+		// Replaying it on every begin would fail the same way
+		setAsideJournal();
+	}
+
+	delete[] keys;
+	delete[] values;
+	delete[] expiries;
+	delete[] removed;
+
+	return result;
+}
+
 // ************************************************************
 
 // #ifdef ESP8266
@@ -10,7 +10,16 @@
 
 #include "Arduino.h"
 #include <FS.h>
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
 #include "Config.h"
+#include "DbUtils.h"
+#include "KeyDirectory.h"
+#include "Compression.h"
+#include "ScanKernel.h"
+#include "Backup.h"
+#include "BulkLoader.h"
 
 // Possible failure and success values
 // #define FAILURE false
@@ -19,25 +28,114 @@
 class SPIFFS_Memory 
 {
     private:
-        const char* _FILE_NAME;
+        String _FILE_NAME;
         bool _isInitiated;
 
+        KeyDirectory _directory;
+        bool _directoryBuilt;
+
+        size_t _sweepIdx;   // index from where the next sweep for expired records starts
+        String _sweepKey;   // key of the record before _sweepIdx, for decoding front coded keys
+        uint16_t _compressMinSize;  // values of at least this length are stored compressed, 0 for never
+
+        File _file;         // handle kept open across the operations, opening a file walks the whole lookup table of SPIFFS
+
+        // Versions of the file read by snapshots, a version is the file itself until it is about to be
+        // modified in place, then it is moved to a file of its own (copy on write)
+        uint8_t _pinRefs[SNAPSHOT_MAX_VERSIONS];    // snapshots reading the version, 0 if the slot is free
+        bool _pinMoved[SNAPSHOT_MAX_VERSIONS];      // version moved to its own file
+        int8_t _livePin;                            // slot of the version which is still the file, -1 if none
+#if defined(THREAD_SAFE)
+        SemaphoreHandle_t _pinLock;                 // protects the slots, snapshots are read without the lock of the database
+#endif
+
         /**
          * This function will just print the message to the Serial if DEBUG is 1
          * @param msg The message to print in Serial
          */
         void _print(const String& msg);
 
+        /**
+         * This will return the handle of the file positioned at its first byte, opening it only if not open yet.
+         * With THREAD_SAFE defined a new handle is opened every time, as readers of different tasks run together
+         * @param create set to true for creating the file if it does not exist
+         * @return the handle, false if the file does not exist or can not be opened
+         */
+        File _acquire(bool create);
+
+        /**
+         * This will flush the writes made through the handle, closing it if it is not kept open
+         * @param file handle returned by _acquire
+         */
+        void _release(File& file);
+
+        /**
+         * This will take the lock of the snapshot slots, does nothing if THREAD_SAFE is not defined
+         * @param null
+         */
+        void _lockPins();
+
+        /**
+         * This will release the lock of the snapshot slots
+         * @param null
+         */
+        void _unlockPins();
+
+        /**
+         * This will return the name of the file holding a moved version
+         * @param slot slot of the version
+         * @return name of the file
+         */
+        String _pinName(int8_t slot);
+
+        /**
+         * This will return the name of the complete copy of the file which is renamed to the file,
+         * begin finishes the rename if a reset interrupted it
+         * @param null
+         * @return name of the file
+         */
+        String _pendingName();
+
+        /**
+         * This will copy a file, replacing the destination
+         * @param from name of the file to copy
+         * @param to name of the copy
+         * @return SUCCESS if copied
+         * @return FAILURE otherwise, the copy is removed then
+         */
+        bool _copyFile(const String& from, const String& to);
+
+        /**
+         * This will move the file to the file of its version if snapshots are reading it, so it is not modified
+         * under them. Must be called before any byte of the file is overwritten, appends do not need it
+         * If keepData is true the data is copied before the file is moved, so a reset never leaves it only in the version
+         * @param file handle of the file, closed and replaced by a handle of the new file if keepData is true
+         * @param keepData set to true for copying the data to the new file, as it is, so the offsets stay valid
+         * @return SUCCESS if the file is not read by snapshots or was moved
+         * @return FAILURE if the data could not be copied, the snapshots lose their version then
+         */
+        bool _detachSnapshots(File& file, bool keepData);
+
+        /**
+         * This will mark the record starting at the index as removed
+         * @param file handle of the file
+         * @param keyIndex index of the first byte of the record
+         */
+        void _deactivate(File& file, int keyIndex);
+
         /**
          * This will return the index at which key is available
+         * @param file handle of the file
          * @param key the key whose index is to be searched
+         * @param includeExpired set to true for finding the key even if its record has expired
          * @return index of key if found
          * @return -1 if key index not found
          */
-        int _indexOfKey(const String& key);
+        int _indexOfKey(File& file, const DbKey& key, bool includeExpired);
 
          /**
          * This method will perform memory optimization if required by checking the space needed for new data
+         * @param file handle of the file, replaced by a new handle if the file is rewritten
          * @param spaceRequired variable containing required empty memory required, if that much memory is 
          *                      not available optimization will be performed (in bytes)
          * @param fileSize current total size used by file (in bytes)
@@ -45,7 +143,99 @@ class SPIFFS_Memory
          * @return SUCCESS, if optimization task successful and space is available for new data
          * @return FAILURE, if optimization failed or space for new data is not available
          */
-        int8_t _optimizeMemory(int spaceRequired, int fileSize, bool forceOptimize);
+        int8_t _optimizeMemory(File& file, int spaceRequired, int fileSize, bool forceOptimize);
+
+        /**
+         * This will return the name of the file in which new data is written before it replaces the data
+         * @param null
+         * @return name of the file
+         */
+        String _stagingName();
+
+        /**
+         * This will compute the bytes the file can grow to from the size of the file system (FSInfo), leaving
+         * SPIFFS_RESERVE_PERCENT of it free and the space used by other files, and half of the rest in whole pages
+         * @param fileSize current size of the file, its pages are counted as available
+         * @return capacity of the file (in bytes)
+         */
+        uint32_t _capacity(uint32_t fileSize);
+
+        /**
+         * This will return the name of the file holding the redo journal of a transaction
+         * @param null
+         * @return name of the file
+         */
+        String _journalName();
+
+        /**
+         * This will return the name of the file holding a redo journal which could not be replayed
+         * @param null
+         * @return name of the file
+         */
+        String _failedJournalName();
+
+        /**
+         * This will replace the file of this database with the staging file, the directory is not changed
+         * @param stagingName name of the file holding the new data
+         * @return SUCCESS if replaced
+         * @return FAILURE otherwise
+         */
+        bool _replaceFile(const String& stagingName);
+
+        /**
+         * This will read the key and active flag of the next record in the file
+         * @param file file to read from, positioned just after the active flag of the record on return
+         * @param record Record to hold the details of the record read, for reading front coded keys
+         *               its key must hold the key of the previous record or the key expected at this index
+         * @return true if a record was read
+         * @return false if no more records are available
+         */
+        bool _readKey(File& file, Record& record);
+
+        /**
+         * This will read the value of the record whose key was just read using _readKey
+         * @param file file to read from, positioned at the start of the next record on return
+         * @param decoder decoder writing the value, pass NULL for skipping the value
+         */
+        void _readValue(File& file, ValueDecoder* decoder);
+
+        /**
+         * This will find the end of the record whose key was just read using _readKey
+         * @param file file to read from, positioned at the start of the next record on return
+         * @return offset just after the new line of the record, -1 if it is an incomplete last record
+         */
+        int _recordEnd(File& file);
+
+        /**
+         * This will write a record to the staging file, with the given key and the bytes of the record from its '>'
+         * @param file file to read from
+         * @param staging file to write to
+         * @param key key written for the record, full or front coded
+         * @param start offset of the '>' of the record
+         * @param end offset just after the new line of the record
+         * @return true if written
+         * @return false if the write failed
+         */
+        bool _copyRecord(File& file, File& staging, const String& key, int start, int end);
+
+        /**
+         * This will build the sorted directory of the active keys using a single scan of the file
+         * @param file handle of the file
+         * @return true if directory built successfully
+         * @return false if memory for the directory is not available
+         */
+        bool _buildDirectory(File& file);
+
+        /**
+         * This will call callback for the keys in the directory starting from low, in sorted order
+         * @param low the first key to visit, or the prefix of the keys to visit
+         * @param high the keys not less than high are not visited, not used for prefix scan
+         * @param isPrefix set to true to visit only the keys starting with low
+         * @param callback function called for every key value pair
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int _scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context);
 
 
     public:
@@ -56,6 +246,14 @@ class SPIFFS_Memory
          */
         SPIFFS_Memory();
 
+        /**
+         * Constructor for initializing class object for using a separate file of SPIFFS memory,
+         * multiple objects with separate names can share the SPIFFS memory
+         * @param name name of the namespace, data is stored in file /<name>.txt (max 26 characters)
+         * @return null
+         */
+        SPIFFS_Memory(const char* name);
+
         /**
          * This method will handle the initialization of the library
          * Note- Must be called within setup only once
@@ -71,6 +269,13 @@ class SPIFFS_Memory
          */
         bool format();
 
+        /**
+         * This method will remove all the data stored in the file of this object only
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
         /**
          * Call this method to optimize the database forcefully
          * @param null
@@ -79,6 +284,13 @@ class SPIFFS_Memory
          */
         int8_t optimize();
 
+        /**
+         * This method will enable compression of values for the following inserts, values
+         * which do not get smaller are stored as it is. Existing values are read either way
+         * @param minSize values of at least this length (in bytes) are compressed, 0 to disable
+         */
+        void setCompression(uint16_t minSize);
+
         /**
          * This method will return the value associated with key
          * @param key key for which value is required
@@ -86,7 +298,28 @@ class SPIFFS_Memory
          * @return value associated with key if found
          * @return defaultValue otherwise
          */
-        String get(const String& key, const String& defaultValue);
+        String get(const DbKey& key, const String& defaultValue);
+
+        /**
+         * This method will return the value associated with key, telling a missing key apart from a value equal to defaultValue
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @param found set to true if the key was found, false otherwise
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const DbKey& key, const String& defaultValue, bool& found);
+
+        /**
+         * This method will copy the value associated with key into buffer, decompressing it on the fly
+         * without building the whole value in memory. Values longer than the buffer are truncated
+         * @param key key for which value is required
+         * @param buffer buffer to hold the value, always null terminated
+         * @param bufferSize size of buffer (in bytes)
+         * @return length of the value copied into buffer
+         * @return -1 if key not found
+         */
+        int get(const DbKey& key, char* buffer, size_t bufferSize);
 
         /**
          * This method will return all the stored key value pairs
@@ -95,6 +328,16 @@ class SPIFFS_Memory
          */
         String getAll();
 
+        /**
+         * This method will return the values associated with multiple keys using a single scan of the file
+         * @param keys array of keys for which values are required
+         * @param values array to hold the values, must have space for count values
+         * @param count number of keys
+         * @param defaultValue default value to store for keys not found
+         * @return number of keys found
+         */
+        int getMany(const String keys[], String values[], int count, const String& defaultValue);
+
         /**
          * This method will insert the data into the database
          * @param key unique key for the value
@@ -102,15 +345,73 @@ class SPIFFS_Memory
          * @return SUCCESS if value inserted successfully
          * @return FAILURE is value insertion failed
          */
-        int8_t insert(const String& key, const String& value);
+        int8_t insert(const DbKey& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         */
+        int8_t insert(const DbKey& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will insert the data into the database, which expires at the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param expiry time at which the key expires (as returned by dbNow), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if space for the value is not available
+         */
+        int8_t insertAt(const DbKey& key, const String& value, uint32_t expiry);
+
+        /**
+         * This method will insert multiple key value pairs using a single scan of the file and a single append
+         * @param keys array of unique keys, for repeated keys the last value is kept
+         * @param values array of values associated with the keys
+         * @param count number of key value pairs
+         * @return SUCCESS if values inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putMany(const String keys[], const String values[], int count);
+
+        /**
+         * This method will insert and remove multiple keys using a single scan of the file and a single append, as a group of changes
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count);
+
+        /**
+         * This method will insert and remove multiple keys as putMany does, with the times at which the keys expire
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param expiries array of times at which the keys expire (as returned by dbNow, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed
+         * @return MEM_FULL if space for the values is not available
+         */
+        int8_t putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count);
 
         /**
          * This method will remove the key and associated value from db
          * @param key key to be removed
-         * @return FAILURE if fails or key not found
+         * @return FAILURE if fails or key not found, an expired key is not found but its data is removed
          * @return SUCCESS if key removed successfully
          */
-        bool remove(const String& key);
+        bool remove(const DbKey& key);
 
         /**
          * This method will tell weather the key exists or not in the database
@@ -118,7 +419,198 @@ class SPIFFS_Memory
          * @return SUCCESS if key found
          * @return FAILURE is key not found
          */
-        bool exists(const String& key);
+        bool exists(const DbKey& key);
+
+        /**
+         * This method will return the time at which the key expires
+         * @param key key to search for
+         * @return expiry time in seconds
+         * @return 0 if the key never expires or is not found
+         */
+        uint32_t expiresAt(const DbKey& key);
+
+        /**
+         * This method will remove the expired records, checking at most maxRecords records per call.
+         * Every call continues from where the previous one stopped
+         * @param maxRecords maximum number of records to check
+         * @return number of expired records removed
+         */
+        int sweep(int maxRecords);
+
+        /**
+         * This method will count the bytes used by live records and by removed or expired records, with a single scan
+         * @param null
+         * @return usage of the file
+         */
+        DbUsage getUsage();
+
+        /**
+         * This method will return the bytes the file can grow to, found from the size of the file system and the space
+         * used by other files. Inserts compact the file when it would grow past this
+         * @param null
+         * @return capacity (in bytes)
+         */
+        uint32_t capacity();
+
+        /**
+         * This method will return the bytes that can still be appended before the file has to be compacted
+         * @param null
+         * @return free space (in bytes)
+         */
+        uint32_t freeSpace();
+
+        /**
+         * This method will build the sorted directory of the active keys used by the scans, if not already built
+         * Note- Scans build it on first use, building it beforehand lets scans run without modifying the object
+         * @param null
+         * @return true if the directory is built
+         * @return false if memory for the directory is not available
+         */
+        bool buildDirectory();
+
+        /**
+         * This method will call callback for every key starting with prefix, in sorted order of keys
+         * Note- The callback must not modify the database
+         * @param prefix prefix of the keys to visit
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanPrefix(const String& prefix, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will call callback for every key from low (inclusive) to high (exclusive), in sorted order of keys
+         * Note- The callback must not modify the database
+         * @param low the first key of the range
+         * @param high the end of the range, this key is not visited
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanRange(const String& low, const String& high, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will call callback for every live key in the order of the file, without building the directory
+         * of keys, the value passed to callback is always empty
+         * Note- The callback must not modify the database
+         * @param callback function called for every key, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of keys visited
+         */
+        int scanKeys(ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will add the live records to a backup (see Backup.h), one record at a time
+         * @param writer backup to add the records to, finish it after all the records are added
+         * @return number of key value pairs added
+         */
+        int exportTo(BackupWriter& writer);
+
+        /**
+         * This method will replace all the data of this database with the records of a backup written by exportTo.
+         * The records are written sequentially to a new file which replaces the file only once the whole backup
+         * is checked, the data is not touched if the backup is corrupted or does not fit. Expired records of the
+         * backup are dropped. Keys must be unique, as written by exportTo
+         * @param in where the backup is read from
+         * @return SUCCESS if the backup was loaded
+         * @return FAILURE if the backup is incomplete or corrupted
+         * @return MEM_FULL if the records do not fit in the capacity
+         */
+        int8_t importFrom(Stream& in);
+
+        /**
+         * This method will replace all the data of this database with the pairs of a bulk loader. The records are
+         * written sorted with front coded keys in a single sequential write, and the key directory is built while
+         * writing. The data is not touched if the pairs do not fit
+         * @param loader loader holding the pairs
+         * @return SUCCESS if the pairs were loaded
+         * @return FAILURE if the pairs of the loader could not be read
+         * @return MEM_FULL if the pairs do not fit in the capacity
+         */
+        int8_t load(BulkLoader& loader);
+
+        /**
+         * This method will write the changes of a transaction to the redo journal /<name>.jnl, replayed by replayJournal
+         * if the changes are not completely written (see Backup.h for the format, removed keys expire at time 1)
+         * @param keys array of keys
+         * @param values array of values associated with the keys
+         * @param expiries array of times at which the keys expire (as returned by dbNow, 0 for never)
+         * @param removed array telling which keys are removed
+         * @param count number of keys
+         * @return SUCCESS if the journal was written
+         * @return FAILURE otherwise
+         */
+        bool writeJournal(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count);
+
+        /**
+         * This method will read the changes of the redo journal, only if it was completely written
+         * @param keys array to hold the keys, must have space for maxCount keys
+         * @param values array to hold the values
+         * @param expiries array to hold the times at which the keys expire (as returned by dbNow, 0 for never)
+         * @param removed array to hold which keys are removed, keys expired since the journal was written are removed as well
+         * @param maxCount number of keys the arrays can hold
+         * @return number of keys read
+         * @return -1 if there is no complete journal
+         */
+        int readJournal(String keys[], String values[], uint32_t expiries[], bool removed[], int maxCount);
+
+        /**
+         * This method will remove the redo journal, once its changes are written
+         * @param null
+         */
+        void clearJournal();
+
+        /**
+         * This method will move the redo journal to /<name>.jfl once its changes could not be written, so it is not replayed again
+         * @param null
+         */
+        void setAsideJournal();
+
+        /**
+         * This method will write a group of changes so that either all or none of them are kept after a reset.
+         * The changes are written to the redo journal first, then with a single scan and a single append
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never)
+         * @param removed array telling which keys are removed instead of inserted
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed even when retried, the journal is set aside then and not replayed
+         * @return MEM_FULL if space for the values is not available, no change is written then
+         */
+        int8_t commitTransaction(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count);
+
+        /**
+         * This method will write the changes of a transaction interrupted by a reset again, if its journal is complete.
+         * Call it after begin, before the data is used
+         * @param null
+         * @return SUCCESS if there was nothing to replay or the changes were written
+         * @return FAILURE if the changes could not be written, the journal is set aside then (see setAsideJournal)
+         */
+        int8_t replayJournal();
+
+        /**
+         * This method will keep the current version of the file for a snapshot until unpinSnapshot. Bytes appended
+         * later are not part of the version, and the version is moved to its own file before the file is modified
+         * in place, so taking a snapshot copies nothing
+         * @param size to hold the number of bytes of the version
+         * @return slot of the version
+         * @return -1 if SNAPSHOT_MAX_VERSIONS versions are already kept
+         */
+        int8_t pinSnapshot(uint32_t& size);
+
+        /**
+         * This method will open the file of a version kept by pinSnapshot for reading, it may be called from any task
+         * @param slot slot of the version
+         * @return handle of the file, false if the version was lost
+         */
+        File openSnapshot(int8_t slot);
+
+        /**
+         * This method will release a version kept by pinSnapshot, removing its file once no snapshot reads it
+         * @param slot slot of the version
+         */
+        void unpinSnapshot(int8_t slot);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+/*
+    ScanKernel.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Config.h"
+#include "ScanKernel.h"
+
+// Host builds use vector instructions, unless DB_SCAN_SWAR asks for the word at a time code of the boards
+#if !defined(DB_SCAN_SWAR) && defined(__AVX2__)
+#define SCAN_AVX2
+#elif !defined(DB_SCAN_SWAR) && defined(__SSE2__)
+#define SCAN_SSE2
+#endif
+
+#if defined(SCAN_AVX2) || defined(SCAN_SSE2)
+#include <immintrin.h>
+#endif
+
+// Word processed in one step, loaded only from aligned addresses as ESP8266 does not allow unaligned loads
+typedef uintptr_t ScanWord;
+
+#define WORD_SIZE sizeof(ScanWord)
+#define ONES ((ScanWord)-1 / 0xFF)     // 0x01 in every byte
+#define HIGHS (ONES * 0x80)            // 0x80 in every byte
+
+/**
+ * This will return a word with the high bit set in the bytes which are zero. Bits above the
+ * first zero byte may be set wrongly, so only the lowest set bit can be used
+ */
+static inline ScanWord _zeroBytes(ScanWord value)
+{
+	return (value - ONES) & ~value & HIGHS;
+}
+
+
+
+
+/**
+ * This will return the index of the lowest non zero byte of the mask, words are little endian
+ */
+static inline int _firstByte(ScanWord mask)
+{
+	if (sizeof(ScanWord) > 4)
+	{
+		return __builtin_ctzll((unsigned long long)mask) / 8;
+	}
+
+	return __builtin_ctz((unsigned int)mask) / 8;
+}
+
+
+
+
+/**
+ * This will load a word from an address which may not be aligned
+ */
+static inline ScanWord _load(const char* data)
+{
+	ScanWord value;
+	memcpy(&value, data, WORD_SIZE);
+	return value;
+}
+
+
+
+
+int dbFindByte(const char* data, int length, char target)
+{
+	int i = 0;
+
+#if defined(SCAN_AVX2)
+	__m256i wide = _mm256_set1_epi8(target);
+
+	for ( ; (i + 32) <= length ; i += 32)
+	{
+		int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i)), wide));
+
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(SCAN_SSE2)
+	__m128i wide = _mm_set1_epi8(target);
+
+	for ( ; (i + 16) <= length ; i += 16)
+	{
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), wide));
+
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#else
+	// Bytes before the first aligned word
+	while ((i < length) && (((uintptr_t)(data + i)) % WORD_SIZE) != 0)
+	{
+		if (data[i] == target)
+		{
+			return i;
+		}
+
+		i++;
+	}
+
+	ScanWord pattern = ONES * (uint8_t)target;
+
+	for ( ; (i + (int)WORD_SIZE) <= length ; i += WORD_SIZE)
+	{
+		ScanWord mask = _zeroBytes(*(const ScanWord*)(data + i) ^ pattern);
+
+		if (mask != 0)
+		{
+			return i + _firstByte(mask);
+		}
+	}
+#endif
+
+	// Remaining bytes after the last full word
+	for ( ; i < length ; i++)
+	{
+		if (data[i] == target)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+
+int dbFindRun(const char* data, int length, char target, int count)
+{
+	int i = 0;
+
+	while (i < length)
+	{
+		int found = dbFindByte(data + i, length - i, target);
+
+		if (found == -1)
+		{
+			return -1;
+		}
+
+		i = i + found;
+
+		int run = 1;
+
+		while ((run < count) && ((i + run) < length) && (data[i + run] == target))
+		{
+			run++;
+		}
+
+		if (run == count)
+		{
+			return i;
+		}
+
+		// The byte breaking the run can not be part of a run
+		i = i + run + 1;
+	}
+
+	return -1;
+}
+
+
+
+
+int dbMismatch(const char* a, const char* b, int length)
+{
+	int i = 0;
+
+#if defined(SCAN_AVX2)
+	for ( ; (i + 32) <= length ; i += 32)
+	{
+		__m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(equal);
+
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(SCAN_SSE2)
+	for ( ; (i + 16) <= length ; i += 16)
+	{
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+		int mask = _mm_movemask_epi8(equal) ^ 0xFFFF;
+
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#else
+	// Bytes before the first aligned word of a, b is loaded byte wise if not aligned the same way
+	while ((i < length) && (((uintptr_t)(a + i)) % WORD_SIZE) != 0)
+	{
+		if (a[i] != b[i])
+		{
+			return i;
+		}
+
+		i++;
+	}
+
+	bool aligned = (((uintptr_t)(b + i)) % WORD_SIZE) == 0;
+
+	for ( ; (i + (int)WORD_SIZE) <= length ; i += WORD_SIZE)
+	{
+		ScanWord diff = *(const ScanWord*)(a + i) ^ (aligned ? *(const ScanWord*)(b + i) : _load(b + i));
+
+		if (diff != 0)
+		{
+			// Lowest non zero byte of the difference
+			return i + _firstByte(diff);
+		}
+	}
+#endif
+
+	for ( ; i < length ; i++)
+	{
+		if (a[i] != b[i])
+		{
+			return i;
+		}
+	}
+
+	return i;
+}
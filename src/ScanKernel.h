@@ -0,0 +1,49 @@
+/*
+    ScanKernel.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef ScanKernel_h
+#define ScanKernel_h
+
+#include "Arduino.h"
+
+/*
+ * Scanning of the stored records a machine word at a time (4 bytes on ESP8266), instead of
+ * one byte at a time. Host builds (tests, tools and benchmarks) use SSE2 or AVX2 when available,
+ * unless DB_SCAN_SWAR is defined
+ */
+
+/**
+ * This will return the index of the first occurrence of the byte
+ * @param data bytes to search
+ * @param length number of bytes to search
+ * @param target byte to search for
+ * @return index of the byte
+ * @return -1 if the byte is not found
+ */
+int dbFindByte(const char* data, int length, char target);
+
+/**
+ * This will return the index of the first run of count consecutive occurrences of the byte
+ * @param data bytes to search
+ * @param length number of bytes to search
+ * @param target byte to search for
+ * @param count length of the run
+ * @return index of the first byte of the run
+ * @return -1 if no such run is found
+ */
+int dbFindRun(const char* data, int length, char target, int count);
+
+/**
+ * This will return the number of leading bytes equal in both the byte arrays
+ * @param a first byte array
+ * @param b second byte array
+ * @param length number of bytes to compare
+ * @return index of the first different byte, length if all the bytes are equal
+ */
+int dbMismatch(const char* a, const char* b, int length);
+
+#endif
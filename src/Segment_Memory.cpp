@@ -0,0 +1,620 @@
+/*
+    Segment_Memory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers using sorted segment files of SPIFFS memory
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Segment_Memory.h"
+
+#define SEGMENT_MAGIC 0x31474553    // "SEG1"
+
+/**
+ * This will write the number as 4 bytes, least significant byte first
+ */
+static bool _writeUint32(File& file, uint32_t value)
+{
+	uint8_t buffer[4];
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+
+	return file.write(buffer, 4) == 4;
+}
+
+
+
+
+/**
+ * This will read a number stored as 4 bytes, least significant byte first
+ */
+static uint32_t _readUint32(File& file)
+{
+	uint8_t buffer[4];
+	uint32_t value = 0;
+
+	if (file.read(buffer, 4) != 4)
+	{
+		return 0;
+	}
+
+	for (int i = 0 ; i < 4 ; i++)
+	{
+		value = value | ((uint32_t)buffer[i] << (8 * i));
+	}
+
+	return value;
+}
+
+
+
+
+// Constructors
+
+Segment_Memory::Segment_Memory(const char* name)
+{
+	_SEGMENT_NAME = String("/") + name + ".seg";
+	_LOG_NAME = String("/") + name + ".log";
+	_STAGING_NAME = String("/") + name + ".new";
+	_isInitiated = false;
+
+	memset(&_footer, 0, sizeof(_footer));
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void Segment_Memory::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[Segment]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+void Segment_Memory::_openSegment()
+{
+	_segment.close();
+	memset(&_footer, 0, sizeof(_footer));
+
+	if (!SPIFFS.exists(_SEGMENT_NAME))
+	{
+		return;
+	}
+
+	_segment = SPIFFS.open(_SEGMENT_NAME, "r");
+
+	if (!_segment || (_segment.size() < sizeof(SegmentFooter)))
+	{
+		_segment.close();
+		return;
+	}
+
+	_segment.seek(_segment.size() - sizeof(SegmentFooter), SeekSet);
+
+	SegmentFooter footer;
+	footer.magic = _readUint32(_segment);
+	footer.records = _readUint32(_segment);
+	footer.dataSize = _readUint32(_segment);
+	footer.blocks = _readUint32(_segment);
+
+	if ((footer.magic != SEGMENT_MAGIC) ||
+		((footer.dataSize + (4 * footer.blocks) + sizeof(SegmentFooter)) != _segment.size()))
+	{
+		_print("Segment corrupted, ignoring it");
+		_segment.close();
+		return;
+	}
+
+	_footer = footer;
+}
+
+
+
+
+uint32_t Segment_Memory::_blockOffset(int block)
+{
+	_segment.seek(_footer.dataSize + (4 * block), SeekSet);
+
+	return _readUint32(_segment);
+}
+
+
+
+
+bool Segment_Memory::_readSegmentLine(String& key, String& line)
+{
+	if (!_segment || (_segment.position() >= _footer.dataSize))
+	{
+		return false;
+	}
+
+	line = _segment.readStringUntil('\n');
+	int sepIdx = line.indexOf('>');
+
+	if (sepIdx == -1)
+	{
+		return false;
+	}
+
+	if ((line[0] == KEY_SHARED_MARKER) && (sepIdx >= 3))
+	{
+		int shared = (dbHexValue(line[1]) << 4) | dbHexValue(line[2]);
+		key = key.substring(0, shared) + line.substring(3, sepIdx);
+	}
+	else
+	{
+		key = line.substring(0, sepIdx);
+	}
+
+	return true;
+}
+
+
+
+
+bool Segment_Memory::_findInLog(const String& key, String& line)
+{
+	bool found = false;
+	String current;
+
+	_log.seek(0, SeekSet);
+
+	// The log is not sorted and may hold several records of a key, the last one is the current one
+	while (_log.available() > 0)
+	{
+		current = _log.readStringUntil('\n');
+		int sepIdx = current.indexOf('>');
+
+		if ((sepIdx == (int)key.length()) && current.startsWith(key))
+		{
+			line = current;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+
+
+
+bool Segment_Memory::_findInSegment(const String& key, String& line)
+{
+	if (!_segment || (_footer.blocks == 0))
+	{
+		return false;
+	}
+
+	// Binary search for the last block whose first key is not greater than key,
+	// first keys of the blocks are stored in full
+	int low = 0;
+	int high = _footer.blocks - 1;
+	int block = -1;
+
+	while (low <= high)
+	{
+		int mid = (low + high) / 2;
+
+		_segment.seek(_blockOffset(mid), SeekSet);
+		String first = _segment.readStringUntil('>');
+
+		if (first.compareTo(key) <= 0)
+		{
+			block = mid;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	if (block == -1)
+	{
+		return false;
+	}
+
+	_segment.seek(_blockOffset(block), SeekSet);
+	String current = "";
+
+	for (int i = 0 ; (i < SEGMENT_BLOCK_RECORDS) && _readSegmentLine(current, line) ; i++)
+	{
+		int order = current.compareTo(key);
+
+		if (order == 0)
+		{
+			return true;
+		}
+		else if (order > 0)
+		{
+			break;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+bool Segment_Memory::_find(const String& key, String& line)
+{
+	if (!_findInLog(key, line) && !_findInSegment(key, line))
+	{
+		return false;
+	}
+
+	// Removed and expired records of the log hide the records of the segment
+	return dbIsLiveLine(line.substring(line.indexOf('>')));
+}
+
+
+
+
+int8_t Segment_Memory::_append(const String& data, bool isRemoval)
+{
+	if ((_log.size() + data.length()) > SEGMENT_LOG_SIZE)
+	{
+		if (compact() != SUCCESS)
+		{
+			return FAILURE;
+		}
+	}
+
+	// The next merge writes the new segment while the segment and the log are still stored, so both copies must fit.
+	// A removal is not longer than the record it hides, so it never makes the merge larger
+	if (!isRemoval && ((2 * (_footer.dataSize + _log.size() + data.length())) > MAX_SPIFFS_SIZE))
+	{
+		_print("Memory full, please delete some data");
+		return MEM_FULL;
+	}
+
+	if (_log.print(data) != data.length())
+	{
+		_print("Write operation failed");
+		return FAILURE;
+	}
+
+	_log.flush();
+
+	return SUCCESS;
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+bool Segment_Memory::begin()
+{
+	_print("Initializing the system");
+
+	if (!SPIFFS.begin())
+	{
+		_isInitiated = false;
+		return FAILURE;
+	}
+
+	// A merge interrupted before the rename leaves the old segment and the log in place
+	SPIFFS.remove(_STAGING_NAME);
+
+	_openSegment();
+	_log = SPIFFS.open(_LOG_NAME, "a+");
+	_isInitiated = _log ? true : false;
+
+	return _isInitiated ? SUCCESS : FAILURE;
+}
+
+
+
+
+bool Segment_Memory::clear()
+{
+	_print("Clearing " + _SEGMENT_NAME);
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	_segment.close();
+	_log.close();
+	memset(&_footer, 0, sizeof(_footer));
+
+	SPIFFS.remove(_SEGMENT_NAME);
+	SPIFFS.remove(_LOG_NAME);
+
+	_log = SPIFFS.open(_LOG_NAME, "a+");
+
+	return _log ? SUCCESS : FAILURE;
+}
+
+
+
+
+int8_t Segment_Memory::compact()
+{
+	_print("Merging the log into the segment");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	if (_log.size() == 0)
+	{
+		return SUCCESS;
+	}
+
+	// Offset of the newest record of every key of the log, sorted by key
+	KeyDirectory pending;
+	_log.seek(0, SeekSet);
+
+	while (_log.available() > 0)
+	{
+		int offset = _log.position();
+		String line = _log.readStringUntil('\n');
+		int sepIdx = line.indexOf('>');
+
+		if ((sepIdx > 0) && !pending.put(line.substring(0, sepIdx), offset))
+		{
+			_print("Memory not available for merging");
+			return FAILURE;
+		}
+	}
+
+	File output = SPIFFS.open(_STAGING_NAME, "w");
+
+	if (!output)
+	{
+		_print("Merge operation failed");
+		return FAILURE;
+	}
+
+	SegmentFooter footer;
+	footer.magic = SEGMENT_MAGIC;
+	footer.records = 0;
+	footer.dataSize = 0;
+	footer.blocks = 0;
+
+	uint32_t* blocks = NULL;
+	uint32_t capacity = 0;
+	bool written = true;
+
+	String previousKey = "";
+	String segmentKey = "";
+	String segmentLine;
+	String key;
+	String line;
+	int pos = 0;
+
+	if (_segment)
+	{
+		_segment.seek(0, SeekSet);
+	}
+
+	bool hasSegment = _readSegmentLine(segmentKey, segmentLine);
+
+	// Both the segment and the keys of the log are sorted, a single pass merges them
+	while (written && (hasSegment || (pos < pending.size())))
+	{
+		int order = (pos == pending.size()) ? 1 : (hasSegment ? pending.keyAt(pos).compareTo(segmentKey) : -1);
+
+		if (order <= 0)
+		{
+			// The log is newer than the segment
+			key = pending.keyAt(pos);
+			_log.seek(pending.offsetAt(pos), SeekSet);
+			line = _log.readStringUntil('\n');
+			pos++;
+
+			if (order == 0)
+			{
+				hasSegment = _readSegmentLine(segmentKey, segmentLine);
+			}
+		}
+		else
+		{
+			key = segmentKey;
+			line = segmentLine;
+			hasSegment = _readSegmentLine(segmentKey, segmentLine);
+		}
+
+		int sepIdx = line.indexOf('>');
+		String tail = line.substring(sepIdx);
+
+		// Dropping removed and expired records
+		if (!dbIsLiveLine(tail))
+		{
+			continue;
+		}
+
+		String stored;
+
+		if ((footer.records % SEGMENT_BLOCK_RECORDS) == 0)
+		{
+			// A new block starts with a full key
+			if (footer.blocks == capacity)
+			{
+				capacity = (capacity == 0) ? 8 : (capacity * 2);
+				uint32_t* grown = new uint32_t[capacity];
+
+				if (grown == NULL)
+				{
+					_print("Memory not available for merging");
+					delete[] blocks;
+					output.close();
+					SPIFFS.remove(_STAGING_NAME);
+					return FAILURE;
+				}
+
+				if (blocks != NULL)
+				{
+					memcpy(grown, blocks, footer.blocks * sizeof(uint32_t));
+					delete[] blocks;
+				}
+
+				blocks = grown;
+			}
+
+			blocks[footer.blocks] = footer.dataSize;
+			footer.blocks++;
+			stored = key;
+		}
+		else
+		{
+			stored = dbEncodeKey(previousKey, key);
+		}
+
+		stored += tail + "\n";
+		written = output.print(stored) == stored.length();
+
+		footer.dataSize = footer.dataSize + stored.length();
+		footer.records++;
+		previousKey = key;
+	}
+
+	// Sparse index of the blocks and the footer
+	for (uint32_t i = 0 ; written && (i < footer.blocks) ; i++)
+	{
+		written = _writeUint32(output, blocks[i]);
+	}
+
+	delete[] blocks;
+
+	written = written && _writeUint32(output, footer.magic) && _writeUint32(output, footer.records) &&
+		_writeUint32(output, footer.dataSize) && _writeUint32(output, footer.blocks);
+
+	output.close();
+
+	if (!written)
+	{
+		_print("Merge operation failed");
+		SPIFFS.remove(_STAGING_NAME);
+		return FAILURE;
+	}
+
+	// Replacing the segment, the log is dropped only once the new segment is in place
+	_segment.close();
+
+	if ((SPIFFS.exists(_SEGMENT_NAME) && !SPIFFS.remove(_SEGMENT_NAME)) || !SPIFFS.rename(_STAGING_NAME, _SEGMENT_NAME))
+	{
+		_print("Merge operation failed");
+		_openSegment();
+		return FAILURE;
+	}
+
+	_openSegment();
+
+	_log.close();
+	SPIFFS.remove(_LOG_NAME);
+	_log = SPIFFS.open(_LOG_NAME, "a+");
+
+	_print("Records in the segment: " + String(_footer.records));
+
+	return _log ? SUCCESS : FAILURE;
+}
+
+
+
+
+String Segment_Memory::get(const String& key, const String& defaultValue)
+{
+	_print("GET CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return defaultValue;
+	}
+
+	String line;
+
+	if (!_find(key, line))
+	{
+		return defaultValue;
+	}
+
+	int sepIdx = line.indexOf('>');
+	uint8_t bits = dbFlagBits(line[sepIdx + 1]);
+	int valueIdx = sepIdx + ((bits & RECORD_EXPIRES) ? 11 : 3);
+
+	if (bits & RECORD_COMPRESSED)
+	{
+		return dbDecompress(line.substring(valueIdx));
+	}
+
+	return line.substring(valueIdx);
+}
+
+
+
+
+int8_t Segment_Memory::insert(const String& key, const String& value)
+{
+	return insert(key, value, 0);
+}
+
+
+
+
+int8_t Segment_Memory::insert(const String& key, const String& value, uint32_t ttlSeconds)
+{
+	_print("INSERT CALLED");
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	// The newest record of the key hides the older ones, nothing is searched or rewritten
+	return _append(dbEncodeRecord(key, value, ttlSeconds, 0));
+}
+
+
+
+
+bool Segment_Memory::remove(const String& key)
+{
+	_print("REMOVE CALLED");
+
+	String line;
+
+	if (!_isInitiated || !_find(key, line))
+	{
+		return FAILURE;
+	}
+
+	// Removed record, hiding the record of the segment until the next merge drops both
+	return (_append(key + ">0:\n", true) == SUCCESS) ? SUCCESS : FAILURE;
+}
+
+
+
+
+bool Segment_Memory::exists(const String& key)
+{
+	String line;
+
+	return (_isInitiated && _find(key, line)) ? SUCCESS : FAILURE;
+}
+
+
+
+
+int Segment_Memory::segmentRecords()
+{
+	return _footer.records;
+}
@@ -0,0 +1,199 @@
+/*
+    Segment_Memory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using sorted segment files of SPIFFS memory
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Segment_Memory_h
+#define Segment_Memory_h
+
+#include "Arduino.h"
+#include <FS.h>
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+#include "Config.h"
+#include "DbUtils.h"
+#include "KeyDirectory.h"
+#include "Compression.h"
+
+/**
+ * Footer stored at the end of the segment file
+ */
+struct SegmentFooter
+{
+    uint32_t magic;
+    uint32_t records;       // number of records
+    uint32_t dataSize;      // bytes of the records, the block index starts here
+    uint32_t blocks;        // number of blocks, the index holds the offset of the first record of every block
+};
+
+/**
+ * SPIFFS database whose data is kept in an immutable segment file sorted by key, plus a small append log
+ * of the latest writes. The segment is split in blocks of SEGMENT_BLOCK_RECORDS records, the first key of a
+ * block is stored in full and the rest are front coded. A sparse index of the block offsets and a footer
+ * follow the records, so a lookup binary searches the blocks in the file and reads a single block,
+ * without keeping any index in RAM. Once the log grows past SEGMENT_LOG_SIZE it is merged with the
+ * segment into a new segment, in a single sequential pass
+ */
+class Segment_Memory
+{
+    private:
+        String _SEGMENT_NAME;
+        String _LOG_NAME;
+        String _STAGING_NAME;
+        bool _isInitiated;
+
+        SegmentFooter _footer;
+        File _segment;      // handles kept open, opening a file walks the whole lookup table of SPIFFS
+        File _log;
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will open the segment and read its footer, an invalid segment is treated as empty
+         * @param null
+         */
+        void _openSegment();
+
+        /**
+         * This will return the offset of the first record of a block, read from the index of the segment
+         * @param block index of the block
+         * @return offset of the block
+         */
+        uint32_t _blockOffset(int block);
+
+        /**
+         * This will read the next record of the segment, stopping at the end of the records
+         * @param key key of the previous record, replaced by the key of this record
+         * @param line to hold the record as stored, without the new line
+         * @return true if a record was read
+         */
+        bool _readSegmentLine(String& key, String& line);
+
+        /**
+         * This will find the newest record of key in the log, including removed and expired records
+         * @param key key to search for
+         * @param line to hold the record as stored, without the new line
+         * @return true if the log has a record of the key
+         */
+        bool _findInLog(const String& key, String& line);
+
+        /**
+         * This will find the record of key in the segment using binary search over the blocks
+         * @param key key to search for
+         * @param line to hold the record as stored, without the new line
+         * @return true if the segment has a record of the key
+         */
+        bool _findInSegment(const String& key, String& line);
+
+        /**
+         * This will find the current record of key, the log is checked before the segment
+         * @param key key to search for
+         * @param line to hold the record as stored, without the new line
+         * @return true if a live record of the key was found
+         */
+        bool _find(const String& key, String& line);
+
+        /**
+         * This will append a record to the log, merging the log first if it is full
+         * @param data record as stored, including the new line
+         * @param isRemoval true for the record of a removed key, which the next merge drops with the record it hides
+         * @return SUCCESS if appended
+         * @return FAILURE if the write failed
+         * @return MEM_FULL if there is no space for the record
+         */
+        int8_t _append(const String& data, bool isRemoval = false);
+
+    public:
+        /**
+         * Constructor for initializing class object for using a separate namespace of SPIFFS memory
+         * @param name name of the namespace, data is stored in files /<name>.seg and /<name>.log (max 26 characters)
+         * @return null
+         */
+        Segment_Memory(const char* name);
+
+        /**
+         * This method will initialize SPIFFS memory and open the segment and the log
+         * Note- Must be called within setup only once
+         * @return FAILURE is initialization fails
+         * @return SUCCESS is initialization successful
+         */
+        bool begin();
+
+        /**
+         * This method will remove all the data of this database
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
+        /**
+         * This method will merge the log into a new segment, dropping removed and expired records. Inserts
+         * do it when the log is full, call it when the device is idle to keep the inserts fast
+         * @param null
+         * @return SUCCESS if merged or the log is empty
+         * @return FAILURE if the merge failed, the data is not changed then
+         */
+        int8_t compact();
+
+        /**
+         * This method will return the value associated with key
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const String& key, const String& defaultValue);
+
+        /**
+         * This method will insert the data into the database
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const String& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const String& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will remove the key and associated value from db
+         * @param key key to be removed
+         * @return FAILURE if fails or key not found
+         * @return SUCCESS if key removed successfully
+         */
+        bool remove(const String& key);
+
+        /**
+         * This method will tell weather the key exists or not in the database
+         * @param key key to search for
+         * @return SUCCESS if key found
+         * @return FAILURE is key not found
+         */
+        bool exists(const String& key);
+
+        /**
+         * This method will return the number of records in the segment, keys written since the last merge are not counted
+         * @param null
+         * @return number of records in the segment
+         */
+        int segmentRecords();
+};
+
+#endif
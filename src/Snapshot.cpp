@@ -0,0 +1,386 @@
+/*
+    Snapshot.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Snapshot.h"
+#include "ArduinoDb.h"
+#include "ScanKernel.h"
+
+// Number of bytes read from the file at a time while scanning
+#define READ_CHUNK_SIZE 32
+
+/**
+ * Position of a scan over the records of a snapshot
+ */
+struct SnapshotCursor
+{
+    int hotIdx;                     // index of the next record of the EEPROM records
+    bool fileOpened;
+    File file;                      // version of the SPIFFS file, opened once the EEPROM records are read
+    uint32_t fileIdx;               // bytes of the file read so far
+    char buffer[READ_CHUNK_SIZE];
+    int count;                      // bytes in buffer
+    int pos;                        // index of the next byte of buffer
+};
+
+// Constructors
+
+DbSnapshot::DbSnapshot()
+{
+	_db = NULL;
+	_isValid = false;
+	_hotData = "";
+	_slot = -1;
+	_size = 0;
+	_time = 0;
+}
+
+
+
+
+DbSnapshot::~DbSnapshot()
+{
+	release();
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void DbSnapshot::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[Snapshot]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+bool DbSnapshot::_next(SnapshotCursor& cursor, String& key, String& line)
+{
+	while (true)
+	{
+		String raw = "";
+
+		if (cursor.hotIdx < (int)_hotData.length())
+		{
+			int end = _hotData.indexOf('\n', cursor.hotIdx);
+
+			if (end == -1)
+			{
+				// Incomplete last record
+				cursor.hotIdx = _hotData.length();
+				continue;
+			}
+
+			raw = _hotData.substring(cursor.hotIdx, end);
+			cursor.hotIdx = end + 1;
+		}
+		else
+		{
+			if (!cursor.fileOpened)
+			{
+				cursor.fileOpened = true;
+				key = "";
+
+				if (_slot != -1)
+				{
+					cursor.file = _db->_openSnapshot(_slot);
+				}
+			}
+
+			if (!cursor.file)
+			{
+				return false;
+			}
+
+			bool complete = false;
+
+			// Reading a chunk at a time, only up to the last byte of the version
+			while (!complete)
+			{
+				if (cursor.pos == cursor.count)
+				{
+					uint32_t remaining = _size - cursor.fileIdx;
+					int wanted = (remaining < READ_CHUNK_SIZE) ? remaining : READ_CHUNK_SIZE;
+
+					cursor.pos = 0;
+					cursor.count = (wanted > 0) ? cursor.file.read((uint8_t*)cursor.buffer, wanted) : 0;
+
+					if (cursor.count <= 0)
+					{
+						// Incomplete last record, it was being written when the snapshot was taken
+						cursor.count = 0;
+						return false;
+					}
+
+					cursor.fileIdx = cursor.fileIdx + cursor.count;
+				}
+
+				int end = dbFindByte(cursor.buffer + cursor.pos, cursor.count - cursor.pos, '\n');
+				int used = (end == -1) ? (cursor.count - cursor.pos) : end;
+
+				for (int i = 0 ; i < used ; i++)
+				{
+					raw += cursor.buffer[cursor.pos + i];
+				}
+
+				cursor.pos = cursor.pos + used;
+
+				if (end != -1)
+				{
+					cursor.pos++;
+					complete = true;
+				}
+			}
+		}
+
+		// Skipping the separators left between records
+		int start = 0;
+
+		while ((start < (int)raw.length()) && (raw[start] == '\0'))
+		{
+			start++;
+		}
+
+		int sepIdx = raw.indexOf('>', start);
+
+		if (sepIdx == -1)
+		{
+			continue;
+		}
+
+		if ((raw[start] == KEY_SHARED_MARKER) && ((start + 3) <= sepIdx))
+		{
+			int shared = (dbHexValue(raw[start + 1]) << 4) | dbHexValue(raw[start + 2]);
+			key = key.substring(0, shared) + raw.substring(start + 3, sepIdx);
+		}
+		else
+		{
+			key = raw.substring(start, sepIdx);
+		}
+
+		line = raw.substring(sepIdx + 1);
+
+		return true;
+	}
+}
+
+
+
+
+bool DbSnapshot::_isLive(const String& line)
+{
+	uint8_t bits = (line.length() > 0) ? dbFlagBits(line[0]) : 0;
+
+	if (!(bits & RECORD_ACTIVE))
+	{
+		return false;
+	}
+
+	if (!(bits & RECORD_EXPIRES))
+	{
+		return true;
+	}
+
+	uint32_t expiry = 0;
+
+	for (int i = 1 ; (i <= 8) && (i < (int)line.length()) ; i++)
+	{
+		expiry = (expiry << 4) | dbHexValue(line[i]);
+	}
+
+	return expiry > _time;
+}
+
+
+
+
+String DbSnapshot::_valueOf(const String& line)
+{
+	String value = "";
+	int sepIdx = line.indexOf(':');
+
+	if (sepIdx == -1)
+	{
+		return value;
+	}
+
+	ValueDecoder decoder(&value, dbFlagBits(line[0]) & RECORD_COMPRESSED);
+
+	value.reserve(line.length() - sepIdx - 1);
+
+	for (int i = sepIdx + 1 ; i < (int)line.length() ; i++)
+	{
+		decoder.feed(line[i]);
+	}
+
+	return value;
+}
+
+
+
+
+bool DbSnapshot::_find(const DbKey& key, String& line)
+{
+	if (!_isValid)
+	{
+		_print("Snapshot not taken");
+		return false;
+	}
+
+	SnapshotCursor cursor;
+	String current = "";
+
+	cursor.hotIdx = 0;
+	cursor.fileOpened = false;
+	cursor.fileIdx = 0;
+	cursor.count = 0;
+	cursor.pos = 0;
+
+	// A key has a single active record in the snapshot, removed records of it are skipped
+	while (_next(cursor, current, line))
+	{
+		if (key.equals(current) && _isLive(line))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+void DbSnapshot::release()
+{
+	if (_isValid && (_slot != -1))
+	{
+		_db->_unpinSnapshot(_slot);
+	}
+
+	_db = NULL;
+	_isValid = false;
+	_hotData = "";
+	_slot = -1;
+	_size = 0;
+}
+
+
+
+
+bool DbSnapshot::isValid()
+{
+	return _isValid ? SUCCESS : FAILURE;
+}
+
+
+
+
+String DbSnapshot::get(const DbKey& key, const String& defaultValue)
+{
+	_print("GET CALLED");
+
+	String line;
+
+	return _find(key, line) ? _valueOf(line) : defaultValue;
+}
+
+
+
+
+bool DbSnapshot::exists(const DbKey& key)
+{
+	String line;
+
+	return _find(key, line) ? SUCCESS : FAILURE;
+}
+
+
+
+
+String DbSnapshot::getAll()
+{
+	_print("GETALL CALLED");
+
+	if (!_isValid)
+	{
+		_print("Snapshot not taken");
+		return "";
+	}
+
+	String data = "";
+
+	if (_slot != -1)
+	{
+		File file = _db->_openSnapshot(_slot);
+
+		data.reserve(_size);
+
+		for (uint32_t i = 0 ; file && (i < _size) ; i++)
+		{
+			int value = file.read();
+
+			if (value == -1)
+			{
+				break;
+			}
+
+			data += (char)value;
+		}
+	}
+
+	// Front coded keys of the tiers are decoded separately, each tier starts with a full key
+	return dbDecodeRecords(_hotData) + dbDecodeRecords(data);
+}
+
+
+
+
+int DbSnapshot::scan(ScanCallback callback, void* context)
+{
+	_print("SCAN CALLED");
+
+	int visited = 0;
+
+	if (!_isValid)
+	{
+		_print("Snapshot not taken");
+		return visited;
+	}
+
+	SnapshotCursor cursor;
+	String key = "";
+	String line;
+
+	cursor.hotIdx = 0;
+	cursor.fileOpened = false;
+	cursor.fileIdx = 0;
+	cursor.count = 0;
+	cursor.pos = 0;
+
+	while (_next(cursor, key, line))
+	{
+		if (_isLive(line))
+		{
+			visited++;
+
+			if (!callback(key, _valueOf(line), context))
+			{
+				break;
+			}
+		}
+	}
+
+	return visited;
+}
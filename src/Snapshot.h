@@ -0,0 +1,140 @@
+/*
+    Snapshot.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Snapshot_h
+#define Snapshot_h
+
+#include "Arduino.h"
+#include <FS.h>
+#include "Config.h"
+#include "DbUtils.h"
+#include "KeyDirectory.h"
+#include "Compression.h"
+
+class ArduinoDb;
+struct SnapshotCursor;
+
+/**
+ * Read only view of a database as it was when the snapshot was taken (see ArduinoDb::snapshot). Inserts,
+ * removes and optimize of the database go on while the snapshot is read and are not seen by it.
+ * EEPROM records are copied when the snapshot is taken. SPIFFS records are not copied, the snapshot keeps
+ * the version of the file and reads only its bytes written before the snapshot. Before the file is modified
+ * in place the version is moved to a file of its own, which is removed once the last snapshot of the version
+ * is released. Reading a snapshot does not take the lock of the database, so with THREAD_SAFE defined
+ * it does not wait for writes or optimize, and they do not wait for it.
+ * Note- A snapshot must be released before its database object is destroyed
+ */
+class DbSnapshot
+{
+    private:
+        ArduinoDb* _db;
+        bool _isValid;
+        String _hotData;    // EEPROM records, copied when the snapshot was taken
+        int8_t _slot;       // version of the SPIFFS file, -1 if none
+        uint32_t _size;     // bytes of the version, bytes appended later are not part of the snapshot
+        uint32_t _time;     // clock when the snapshot was taken, expiry is checked against it
+
+        DbSnapshot(const DbSnapshot&);
+        DbSnapshot& operator=(const DbSnapshot&);
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will read the next record of the snapshot, the EEPROM records first and then the SPIFFS records
+         * @param cursor position of the scan, moved past the record
+         * @param key key of the previous record, replaced by the key of this record
+         * @param line to hold the rest of the record as stored, from the active flag up to the new line
+         * @return true if a record was read
+         */
+        bool _next(SnapshotCursor& cursor, String& key, String& line);
+
+        /**
+         * This will tell weather the record was live when the snapshot was taken
+         * @param line record as returned by _next
+         * @return true if the record is live
+         */
+        bool _isLive(const String& line);
+
+        /**
+         * This will decode the value of a record
+         * @param line record as returned by _next
+         * @return value of the record
+         */
+        String _valueOf(const String& line);
+
+        /**
+         * This will find the live record of key
+         * @param key key to search for
+         * @param line to hold the record as returned by _next
+         * @return true if found
+         */
+        bool _find(const DbKey& key, String& line);
+
+        friend class ArduinoDb;
+
+    public:
+        /**
+         * Constructor for an empty snapshot, fill it with ArduinoDb::snapshot
+         * @param null
+         * @return null
+         */
+        DbSnapshot();
+
+        ~DbSnapshot();
+
+        /**
+         * This method will release the version of the data kept for the snapshot, the snapshot is empty after that
+         * @param null
+         */
+        void release();
+
+        /**
+         * This method will tell weather the snapshot holds the data of a database
+         * @param null
+         * @return SUCCESS if taken and not released
+         * @return FAILURE otherwise
+         */
+        bool isValid();
+
+        /**
+         * This method will return the value associated with key when the snapshot was taken
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const DbKey& key, const String& defaultValue);
+
+        /**
+         * This method will tell weather the key existed when the snapshot was taken
+         * @param key key to search for
+         * @return SUCCESS if key found
+         * @return FAILURE is key not found
+         */
+        bool exists(const DbKey& key);
+
+        /**
+         * This method will return all the key value pairs stored when the snapshot was taken, as returned by ArduinoDb::getAll
+         * @param null
+         * @return String of all key value pairs
+         */
+        String getAll();
+
+        /**
+         * This method will call callback for every live key of the snapshot, in the order they are stored
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scan(ScanCallback callback, void* context = NULL);
+};
+
+#endif
@@ -0,0 +1,1168 @@
+/*
+    Tiered_Memory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers using EEPROM and SPIFFS memory together
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "Tiered_Memory.h"
+
+// State of a running scan, passed as the context of the scans of both tiers
+struct TieredScan
+{
+	String* keys;
+	String* values;
+	int count;
+	int pos;
+	int visited;
+	bool stopped;
+	ScanCallback callback;
+	void* context;
+};
+
+// State of the search for the least read key of the hot tier
+struct VictimSearch
+{
+	const String* tracked;
+	const uint8_t* hits;
+	String key;
+	int reads;
+};
+
+/**
+ * Scan callback counting the matching keys of the hot tier
+ */
+static bool _countHot(const String& key, const String& value, void* context)
+{
+	((TieredScan*)context)->count++;
+	return true;
+}
+
+
+
+
+/**
+ * Scan callback collecting the matching key value pairs of the hot tier
+ */
+static bool _collectHot(const String& key, const String& value, void* context)
+{
+	TieredScan* scan = (TieredScan*)context;
+
+	scan->keys[scan->pos] = key;
+	scan->values[scan->pos] = value;
+	scan->pos++;
+
+	return scan->pos < scan->count;
+}
+
+
+
+
+/**
+ * This will pass the key value pair to the callback of the caller
+ */
+static bool _visit(TieredScan* scan, const String& key, const String& value)
+{
+	scan->visited++;
+	scan->stopped = !scan->callback(key, value, scan->context);
+
+	return !scan->stopped;
+}
+
+
+
+
+/**
+ * Scan callback of the cold tier, visiting the smaller keys of the hot tier first
+ */
+static bool _mergeCold(const String& key, const String& value, void* context)
+{
+	TieredScan* scan = (TieredScan*)context;
+
+	while ((scan->pos < scan->count) && (scan->keys[scan->pos].compareTo(key) < 0))
+	{
+		scan->pos++;
+
+		if (!_visit(scan, scan->keys[scan->pos - 1], scan->values[scan->pos - 1]))
+		{
+			return false;
+		}
+	}
+
+	return _visit(scan, key, value);
+}
+
+
+
+
+/**
+ * Scan callback of the hot tier keeping the key with the least reads
+ */
+static bool _findVictim(const String& key, const String& value, void* context)
+{
+	VictimSearch* search = (VictimSearch*)context;
+	int reads = 0;
+
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		if (key.equals(search->tracked[i]))
+		{
+			reads = search->hits[i];
+		}
+	}
+
+	if ((search->reads == -1) || (reads < search->reads))
+	{
+		search->reads = reads;
+		search->key = key;
+	}
+
+	// No key can be read less than an unread key
+	return search->reads > 0;
+}
+
+
+
+
+/**
+ * This will return the bit of a key in the filter of the cold tier, one for each half of its hash
+ */
+static uint16_t _filterBit(uint32_t hash, bool high)
+{
+	return (uint16_t)((high ? (hash >> 16) : (hash & 0xFFFF)) % (TIER_COLD_FILTER_BYTES * 8));
+}
+
+
+
+
+/**
+ * This will set the bits of a key in the filter of the cold tier
+ */
+static void _setFilterBits(uint8_t* filter, uint32_t hash)
+{
+	uint16_t low = _filterBit(hash, false);
+	uint16_t high = _filterBit(hash, true);
+
+	filter[low / 8] |= (uint8_t)(1 << (low % 8));
+	filter[high / 8] |= (uint8_t)(1 << (high % 8));
+}
+
+
+
+
+/**
+ * Scan callback adding the keys of the cold tier to the filter passed as context
+ */
+static bool _markColdKey(const String& key, const String& value, void* context)
+{
+	_setFilterBits((uint8_t*)context, dbHash(key.c_str(), key.length()));
+	return true;
+}
+
+
+
+
+/**
+ * Constructor of the class using the whole EEPROM memory and default file of SPIFFS memory
+ */
+Tiered_Memory::Tiered_Memory()
+{
+	_hot = EEPROM_Memory(MAX_EEPROM_SIZE);
+	_cold = SPIFFS_Memory();
+	_reads = 0;
+
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		_trackedHashes[i] = 0;
+		_hits[i] = 0;
+	}
+
+	// Any key may be cold until the filter is loaded by begin
+	memset(_coldFilter, 0xFF, TIER_COLD_FILTER_BYTES);
+}
+
+
+
+
+/**
+ * Constructor of the class for using EEPROM and SPIFFS memory together
+ */
+Tiered_Memory::Tiered_Memory(int EEPROMSize, const char* name)
+{
+	_hot = EEPROM_Memory(EEPROMSize);
+	_cold = SPIFFS_Memory(name);
+	_reads = 0;
+
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		_trackedHashes[i] = 0;
+		_hits[i] = 0;
+	}
+
+	// Any key may be cold until the filter is loaded by begin
+	memset(_coldFilter, 0xFF, TIER_COLD_FILTER_BYTES);
+}
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void Tiered_Memory::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[TIERED]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+uint8_t Tiered_Memory::_hitsOf(const DbKey& key)
+{
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		if ((_trackedHashes[i] == key.hash()) && key.equals(_trackedKeys[i]))
+		{
+			return _hits[i];
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+uint8_t Tiered_Memory::_touch(const DbKey& key)
+{
+	_reads++;
+
+	// Halving the counts from time to time, so that keys no longer read can be demoted
+	if (_reads >= TIER_AGING_INTERVAL)
+	{
+		for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+		{
+			_hits[i] = _hits[i] / 2;
+		}
+
+		_reads = 0;
+	}
+
+	int slot = -1;
+	int least = 0;
+
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		if ((_trackedHashes[i] == key.hash()) && key.equals(_trackedKeys[i]))
+		{
+			slot = i;
+			break;
+		}
+
+		if (_hits[i] < _hits[least])
+		{
+			least = i;
+		}
+	}
+
+	if (slot == -1)
+	{
+		// Replacing the least read key
+		slot = least;
+		_trackedKeys[slot] = key.c_str();
+		_trackedHashes[slot] = key.hash();
+		_hits[slot] = 0;
+	}
+
+	if (_hits[slot] < 0xFF)
+	{
+		_hits[slot]++;
+	}
+
+	return _hits[slot];
+}
+
+
+
+
+void Tiered_Memory::_forget(const DbKey& key)
+{
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		if ((_trackedHashes[i] == key.hash()) && key.equals(_trackedKeys[i]))
+		{
+			_trackedKeys[i] = "";
+			_trackedHashes[i] = 0;
+			_hits[i] = 0;
+		}
+	}
+}
+
+
+
+
+void Tiered_Memory::_markCold(const DbKey& key)
+{
+	_setFilterBits(_coldFilter, key.hash());
+}
+
+
+
+
+bool Tiered_Memory::_mayBeCold(const DbKey& key)
+{
+	uint16_t low = _filterBit(key.hash(), false);
+	uint16_t high = _filterBit(key.hash(), true);
+
+	return (_coldFilter[low / 8] & (1 << (low % 8))) && (_coldFilter[high / 8] & (1 << (high % 8)));
+}
+
+
+
+
+void Tiered_Memory::_loadColdFilter()
+{
+	memset(_coldFilter, 0, TIER_COLD_FILTER_BYTES);
+
+	// Streaming the keys of the cold file, its directory is not built and kept in memory for the filter
+	// Nothing is visited if the file cannot be read, any key may be cold then
+	if ((_cold.scanKeys(_markColdKey, _coldFilter) == 0) && (_cold.getUsage().liveBytes > 0))
+	{
+		memset(_coldFilter, 0xFF, TIER_COLD_FILTER_BYTES);
+	}
+}
+
+
+
+
+int Tiered_Memory::_leastRead(String& victim)
+{
+	VictimSearch search;
+	search.tracked = _trackedKeys;
+	search.hits = _hits;
+	search.key = "";
+	search.reads = -1;
+
+	_hot.scanPrefix("", _findVictim, &search);
+
+	victim = search.key;
+
+	return search.reads;
+}
+
+
+
+
+int8_t Tiered_Memory::_insertHot(const DbKey& key, const String& value, uint32_t expiry)
+{
+	int8_t res = _hot.insertAt(key, value, expiry);
+
+	if (res == MEM_FULL)
+	{
+		String victim;
+		int victimReads = _leastRead(victim);
+
+		if ((victimReads != -1) && (victimReads < _hitsOf(key)) && (_demote(victim) == SUCCESS))
+		{
+			_print("Demoted key: " + victim);
+			res = _hot.insertAt(key, value, expiry);
+		}
+	}
+
+	return res;
+}
+
+
+
+
+void Tiered_Memory::_promote(const DbKey& key, const String& value)
+{
+	uint32_t expiry = _cold.expiresAt(key);
+
+	if ((expiry != 0) && (expiry <= dbNow()))
+	{
+		return;
+	}
+
+	// The absolute expiry is copied, so the key expires at the same time in the hot tier
+	if (_insertHot(key, value, expiry) == SUCCESS)
+	{
+		_print(String("Promoted key: ") + key.c_str());
+		_cold.remove(key);
+	}
+}
+
+
+
+
+bool Tiered_Memory::_demote(const String& key)
+{
+	if (!_hot.exists(key))
+	{
+		return FAILURE;
+	}
+
+	String value = _hot.get(key, "");
+	uint32_t expiry = _hot.expiresAt(key);
+
+	if ((expiry != 0) && (expiry <= dbNow()))
+	{
+		// Dropping the expired record makes space as well, remove reports the key as not found
+		_hot.remove(key);
+		return SUCCESS;
+	}
+
+	_markCold(key);
+
+	if (_cold.insertAt(key, value, expiry) != SUCCESS)
+	{
+		return FAILURE;
+	}
+
+	return _hot.remove(key);
+}
+
+
+
+
+bool Tiered_Memory::_clearHot()
+{
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		_trackedKeys[i] = "";
+		_trackedHashes[i] = 0;
+		_hits[i] = 0;
+	}
+
+	return _hot.clear();
+}
+
+
+
+
+int Tiered_Memory::_scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context)
+{
+	TieredScan scan;
+	scan.keys = NULL;
+	scan.values = NULL;
+	scan.count = 0;
+	scan.pos = 0;
+	scan.visited = 0;
+	scan.stopped = false;
+	scan.callback = callback;
+	scan.context = context;
+
+	// Matching keys of the hot tier are held in memory, the hot tier is small
+	if (isPrefix)
+	{
+		_hot.scanPrefix(low, _countHot, &scan);
+	}
+	else
+	{
+		_hot.scanRange(low, high, _countHot, &scan);
+	}
+
+	if (scan.count > 0)
+	{
+		scan.keys = new String[scan.count];
+		scan.values = new String[scan.count];
+
+		if (isPrefix)
+		{
+			_hot.scanPrefix(low, _collectHot, &scan);
+		}
+		else
+		{
+			_hot.scanRange(low, high, _collectHot, &scan);
+		}
+
+		scan.count = scan.pos;
+		scan.pos = 0;
+	}
+
+	if (isPrefix)
+	{
+		_cold.scanPrefix(low, _mergeCold, &scan);
+	}
+	else
+	{
+		_cold.scanRange(low, high, _mergeCold, &scan);
+	}
+
+	// Keys of the hot tier greater than the last key of the cold tier
+	while (!scan.stopped && (scan.pos < scan.count))
+	{
+		scan.pos++;
+		_visit(&scan, scan.keys[scan.pos - 1], scan.values[scan.pos - 1]);
+	}
+
+	delete[] scan.keys;
+	delete[] scan.values;
+
+	return scan.visited;
+}
+
+// ************************************************************
+
+
+
+// ****************** PUBLIC METHODS **************************
+bool Tiered_Memory::begin()
+{
+	_print("Initializing the system");
+
+	bool hotRes = _hot.begin();
+	bool coldRes = _cold.begin();
+
+	if (coldRes == SUCCESS)
+	{
+		_loadColdFilter();
+	}
+
+	return ((hotRes == SUCCESS) && (coldRes == SUCCESS)) ? SUCCESS : FAILURE;
+}
+
+
+
+
+bool Tiered_Memory::format()
+{
+	_print("Formatting the system");
+
+	bool hotRes = _hot.format();
+	bool coldRes = _cold.format();
+
+	if (coldRes == SUCCESS)
+	{
+		memset(_coldFilter, 0, TIER_COLD_FILTER_BYTES);
+	}
+
+	return ((hotRes == SUCCESS) && (coldRes == SUCCESS)) ? SUCCESS : FAILURE;
+}
+
+
+
+
+bool Tiered_Memory::clear()
+{
+	_print("Clearing both the tiers");
+
+	for (int i = 0 ; i < TIER_TRACKED_KEYS ; i++)
+	{
+		_trackedKeys[i] = "";
+		_trackedHashes[i] = 0;
+		_hits[i] = 0;
+	}
+
+	bool hotRes = _hot.clear();
+	bool coldRes = _cold.clear();
+
+	if (coldRes == SUCCESS)
+	{
+		memset(_coldFilter, 0, TIER_COLD_FILTER_BYTES);
+	}
+
+	return ((hotRes == SUCCESS) && (coldRes == SUCCESS)) ? SUCCESS : FAILURE;
+}
+
+
+
+
+int8_t Tiered_Memory::optimize()
+{
+	int8_t hotRes = _hot.optimize();
+	int8_t coldRes = _cold.optimize();
+
+	// Dropping the bits of the keys compacted away
+	if (coldRes == SUCCESS)
+	{
+		_loadColdFilter();
+	}
+
+	return (hotRes != SUCCESS) ? hotRes : coldRes;
+}
+
+
+
+
+void Tiered_Memory::setCompression(uint16_t minSize)
+{
+	_hot.setCompression(minSize);
+	_cold.setCompression(minSize);
+}
+
+
+
+
+void Tiered_Memory::setDeferredCommit(bool defer)
+{
+	_hot.setDeferredCommit(defer);
+}
+
+
+
+
+bool Tiered_Memory::commit()
+{
+	return _hot.commit();
+}
+
+
+
+
+String Tiered_Memory::get(const DbKey& key, const String& defaultValue)
+{
+	_print("GET CALLED");
+
+	bool found;
+	String value = _hot.get(key, defaultValue, found);
+
+	if (found)
+	{
+		_touch(key);
+		return value;
+	}
+
+	if (!_mayBeCold(key))
+	{
+		return defaultValue;
+	}
+
+	value = _cold.get(key, defaultValue, found);
+
+	if (!found)
+	{
+		return defaultValue;
+	}
+
+	// Moving the key only once when it reaches the count, not on every read after that
+	if ((_touch(key) == TIER_PROMOTE_HITS) && (value.length() <= TIER_HOT_MAX_VALUE))
+	{
+		_promote(key, value);
+	}
+
+	return value;
+}
+
+
+
+
+int Tiered_Memory::get(const DbKey& key, char* buffer, size_t bufferSize)
+{
+	int length = _hot.get(key, buffer, bufferSize);
+
+	if ((length != -1) || !_mayBeCold(key))
+	{
+		return length;
+	}
+
+	return _cold.get(key, buffer, bufferSize);
+}
+
+
+
+
+bool Tiered_Memory::getView(const DbKey& key, const char*& value, size_t& length)
+{
+	return _hot.getView(key, value, length);
+}
+
+
+
+
+String Tiered_Memory::getAll()
+{
+	return _hot.getAll() + _cold.getAll();
+}
+
+
+
+
+int Tiered_Memory::getMany(const String keys[], String values[], int count, const String& defaultValue)
+{
+	_print("GETMANY CALLED");
+
+	bool* hotFound = new bool[count];
+	int found = _hot.getMany(keys, values, count, defaultValue, hotFound);
+	int coldCount = 0;
+
+	if (found == count)
+	{
+		delete[] hotFound;
+		return found;
+	}
+
+	// Requesting the keys not found by the hot pass from the cold tier
+	String* coldKeys = new String[count];
+	int* coldIdx = new int[count];
+
+	for (int i = 0 ; i < count ; i++)
+	{
+		if (!hotFound[i] && _mayBeCold(keys[i]))
+		{
+			coldKeys[coldCount] = keys[i];
+			coldIdx[coldCount] = i;
+			coldCount++;
+		}
+	}
+
+	String* coldValues = new String[coldCount];
+
+	// The cold file is not read if none of the keys can be stored in it
+	if (coldCount > 0)
+	{
+		found += _cold.getMany(coldKeys, coldValues, coldCount, defaultValue);
+	}
+
+	for (int i = 0 ; i < coldCount ; i++)
+	{
+		values[coldIdx[i]] = coldValues[i];
+	}
+
+	delete[] hotFound;
+	delete[] coldKeys;
+	delete[] coldIdx;
+	delete[] coldValues;
+
+	return found;
+}
+
+
+
+
+int8_t Tiered_Memory::insert(const DbKey& key, const String& value)
+{
+	return insert(key, value, 0);
+}
+
+
+
+
+int8_t Tiered_Memory::insert(const DbKey& key, const String& value, uint32_t ttlSeconds)
+{
+	_print("INSERT CALLED");
+
+	// Reading the clock once, the key expires at the same time in whichever tier stores it
+	uint32_t expiry = (ttlSeconds > 0) ? (dbNow() + ttlSeconds) : 0;
+
+	if (value.length() <= TIER_HOT_MAX_VALUE)
+	{
+		int8_t res = _insertHot(key, value, expiry);
+
+		if (res == SUCCESS)
+		{
+			if (_mayBeCold(key))
+			{
+				_cold.remove(key);
+			}
+
+			return SUCCESS;
+		}
+		else if (res == FAILURE)
+		{
+			return FAILURE;
+		}
+	}
+
+	// Large values and values not fitting in the hot tier
+	_hot.remove(key);
+	_markCold(key);
+
+	return _cold.insertAt(key, value, expiry);
+}
+
+
+
+
+int8_t Tiered_Memory::putMany(const String keys[], const String values[], int count)
+{
+	return putMany(keys, values, NULL, NULL, count);
+}
+
+
+
+
+int8_t Tiered_Memory::putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count)
+{
+	if (ttlSeconds == NULL)
+	{
+		return putManyAt(keys, values, NULL, removed, count);
+	}
+
+	uint32_t* expiries = new uint32_t[count];
+	dbExpiryTimes(ttlSeconds, expiries, count);
+
+	int8_t result = putManyAt(keys, values, expiries, removed, count);
+
+	delete[] expiries;
+
+	return result;
+}
+
+
+
+
+int8_t Tiered_Memory::putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count)
+{
+	_print("PUTMANY CALLED");
+
+	KeyLookup lookup(keys, count);
+	String* uniqueKeys = new String[count];
+	String* uniqueValues = new String[count];
+	uint32_t* times = new uint32_t[count];
+	bool* hotRemoved = new bool[count];
+	bool* coldRemoved = new bool[count];
+	int uniqueCount = 0;
+	uint32_t hotBytes = 0;
+
+	// Every key is written to one tier and removed from the other, removed keys are removed from both
+	for (int i = 0 ; i < count ; i++)
+	{
+		if (lookup.find(keys[i]) != i)
+		{
+			continue;
+		}
+
+		bool isRemoved = (removed != NULL) && removed[i];
+		bool isHot = !isRemoved && (values[i].length() <= TIER_HOT_MAX_VALUE);
+
+		uniqueKeys[uniqueCount] = keys[i];
+		uniqueValues[uniqueCount] = values[i];
+		times[uniqueCount] = (expiries != NULL) ? expiries[i] : 0;
+		hotRemoved[uniqueCount] = !isHot;
+		coldRemoved[uniqueCount] = isHot || isRemoved;
+
+		if (isHot)
+		{
+			hotBytes = hotBytes + keys[i].length() + values[i].length() + RECORD_MAX_OVERHEAD;
+		}
+
+		uniqueCount++;
+	}
+
+	// Splitting the keys before anything is written, if the hot values would not fit even after compacting
+	// the hot tier all the values go to the cold tier
+	DbUsage hotUsage = _hot.getUsage();
+
+	if ((hotBytes > 0) && ((hotUsage.liveBytes + hotBytes) > hotUsage.capacity))
+	{
+		for (int i = 0 ; i < uniqueCount ; i++)
+		{
+			if (!hotRemoved[i])
+			{
+				hotRemoved[i] = true;
+				coldRemoved[i] = false;
+			}
+		}
+	}
+
+	// Cold tier first, nothing is changed if its values do not fit
+	int8_t res = _cold.putManyAt(uniqueKeys, uniqueValues, times, coldRemoved, uniqueCount);
+
+	if (res != MEM_FULL)
+	{
+		// Some records of the cold tier may be written even if it failed, so they are added to the filter
+		for (int i = 0 ; i < uniqueCount ; i++)
+		{
+			if (!coldRemoved[i])
+			{
+				_markCold(uniqueKeys[i]);
+			}
+		}
+	}
+
+	if (res == SUCCESS)
+	{
+		// Cold tier is already changed, so a hot tier which is full is a failure and not MEM_FULL
+		res = (_hot.putManyAt(uniqueKeys, uniqueValues, times, hotRemoved, uniqueCount) == SUCCESS) ? SUCCESS : FAILURE;
+	}
+
+	if (res == SUCCESS)
+	{
+		for (int i = 0 ; i < uniqueCount ; i++)
+		{
+			if (hotRemoved[i] && coldRemoved[i])
+			{
+				_forget(uniqueKeys[i]);
+			}
+		}
+	}
+
+	delete[] uniqueKeys;
+	delete[] uniqueValues;
+	delete[] times;
+	delete[] hotRemoved;
+	delete[] coldRemoved;
+
+	return res;
+}
+
+
+
+
+bool Tiered_Memory::remove(const DbKey& key)
+{
+	_print("REMOVE CALLED");
+
+	_forget(key);
+
+	if (_hot.remove(key) == SUCCESS)
+	{
+		return SUCCESS;
+	}
+
+	return _mayBeCold(key) && _cold.remove(key);
+}
+
+
+
+
+bool Tiered_Memory::exists(const DbKey& key)
+{
+	if (_hot.exists(key))
+	{
+		return SUCCESS;
+	}
+
+	return _mayBeCold(key) && _cold.exists(key);
+}
+
+
+
+
+int Tiered_Memory::sweep(int maxRecords)
+{
+	return _hot.sweep(maxRecords) + _cold.sweep(maxRecords);
+}
+
+
+
+
+DbUsage Tiered_Memory::getUsage()
+{
+	DbUsage hotUsage = _hot.getUsage();
+	DbUsage coldUsage = _cold.getUsage();
+	DbUsage usage;
+
+	usage.capacity = hotUsage.capacity + coldUsage.capacity;
+	usage.usedBytes = hotUsage.usedBytes + coldUsage.usedBytes;
+	usage.liveBytes = hotUsage.liveBytes + coldUsage.liveBytes;
+	usage.deadBytes = hotUsage.deadBytes + coldUsage.deadBytes;
+
+	return usage;
+}
+
+
+
+
+uint32_t Tiered_Memory::capacity()
+{
+	return _hot.capacity() + _cold.capacity();
+}
+
+
+
+
+uint32_t Tiered_Memory::freeSpace()
+{
+	return _hot.freeSpace() + _cold.freeSpace();
+}
+
+
+
+
+bool Tiered_Memory::buildDirectory()
+{
+	bool hotRes = _hot.buildDirectory();
+	bool coldRes = _cold.buildDirectory();
+
+	return hotRes && coldRes;
+}
+
+
+
+
+int Tiered_Memory::scanPrefix(const String& prefix, ScanCallback callback, void* context)
+{
+	_print("SCANPREFIX CALLED");
+
+	return _scan(prefix, "", true, callback, context);
+}
+
+
+
+
+int Tiered_Memory::scanRange(const String& low, const String& high, ScanCallback callback, void* context)
+{
+	_print("SCANRANGE CALLED");
+
+	return _scan(low, high, false, callback, context);
+}
+
+
+
+
+int Tiered_Memory::exportTo(BackupWriter& writer)
+{
+	_print("EXPORT CALLED");
+
+	// Every key is stored in exactly one tier, so no key is written twice
+	return _hot.exportTo(writer) + _cold.exportTo(writer);
+}
+
+
+
+
+int8_t Tiered_Memory::importFrom(Stream& in)
+{
+	_print("IMPORT CALLED");
+
+	int8_t result = _cold.importFrom(in);
+
+	if (result == SUCCESS)
+	{
+		_loadColdFilter();
+	}
+
+	return (result == SUCCESS) ? _clearHot() : result;
+}
+
+
+
+
+int8_t Tiered_Memory::load(BulkLoader& loader)
+{
+	_print("LOAD CALLED");
+
+	int8_t result = _cold.load(loader);
+
+	if (result == SUCCESS)
+	{
+		_loadColdFilter();
+	}
+
+	return (result == SUCCESS) ? _clearHot() : result;
+}
+
+
+
+
+int8_t Tiered_Memory::pinSnapshot(String& hotData, uint32_t& size)
+{
+	_print("PINSNAPSHOT CALLED");
+
+	int8_t slot = _cold.pinSnapshot(size);
+
+	if (slot != -1)
+	{
+		hotData = _hot.getAll();
+	}
+
+	return slot;
+}
+
+
+
+
+File Tiered_Memory::openSnapshot(int8_t slot)
+{
+	return _cold.openSnapshot(slot);
+}
+
+
+
+
+void Tiered_Memory::unpinSnapshot(int8_t slot)
+{
+	_cold.unpinSnapshot(slot);
+}
+
+
+
+
+int8_t Tiered_Memory::commitTransaction(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count)
+{
+	_print("COMMITTRANSACTION CALLED");
+
+	// The journal of both tiers is kept in the cold tier, expiry times are taken once so the journal and the tiers hold the same ones
+	uint32_t* expiries = new uint32_t[count];
+	dbExpiryTimes(ttlSeconds, expiries, count);
+
+	if (!_cold.writeJournal(keys, values, expiries, removed, count))
+	{
+		delete[] expiries;
+		_cold.clearJournal();
+		return FAILURE;
+	}
+
+	int8_t result = putManyAt(keys, values, expiries, removed, count);
+
+	// Part of the changes may be written, writing them again gives the same result
+	if (result == FAILURE)
+	{
+		result = (putManyAt(keys, values, expiries, removed, count) == SUCCESS) ? SUCCESS : FAILURE;
+	}
+
+	delete[] expiries;
+
+	// Hot writes may be deferred, they are committed before the journal is removed
+	if ((result == SUCCESS) && !_hot.commit())
+	{
+		result = FAILURE;
+	}
+
+	// Nothing was written if the changes do not fit, a failed transaction is never replayed by the next begin
+	if (result == FAILURE)
+	{
+		_cold.setAsideJournal();
+	}
+	else
+	{
+		_cold.clearJournal();
+	}
+
+	return result;
+}
+
+
+
+
+int8_t Tiered_Memory::replayJournal()
+{
+	_print("REPLAYJOURNAL CALLED");
+
+	String* keys = new String[TRANSACTION_MAX_KEYS];
+	String* values = new String[TRANSACTION_MAX_KEYS];
+	uint32_t* expiries = new uint32_t[TRANSACTION_MAX_KEYS];
+	bool* removed = new bool[TRANSACTION_MAX_KEYS];
+	int count = _cold.readJournal(keys, values, expiries, removed, TRANSACTION_MAX_KEYS);
+	int8_t result = SUCCESS;
+
+	if (count > 0)
+	{
+		_print("Replaying " + String(count) + " changes");
+
+		result = ((putManyAt(keys, values, expiries, removed, count) == SUCCESS) && _hot.commit()) ? SUCCESS : FAILURE;
+	}
+
+	if (result == SUCCESS)
+	{
+		_cold.clearJournal();
+	}
+	else
+	{
+		// Replaying it on every begin would fail the same way
+		_cold.setAsideJournal();
+	}
+
+	delete[] keys;
+	delete[] values;
+	delete[] expiries;
+	delete[] removed;
+
+	return result;
+}
+
+// ************************************************************
@@ -0,0 +1,458 @@
+/*
+    Tiered_Memory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using EEPROM and SPIFFS memory together
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef Tiered_Memory_h
+#define Tiered_Memory_h
+
+#include "Arduino.h"
+#include "Config.h"
+#include "DbUtils.h"
+#include "KeyDirectory.h"
+#include "EEPROM_Memory.h"
+#include "SPIFFS_Memory.h"
+
+/**
+ * Single keyspace over two tiers, small and frequently read keys are kept in EEPROM (hot tier)
+ * and large or rarely read keys in SPIFFS (cold tier). Every key is stored in exactly one tier
+ */
+class Tiered_Memory
+{
+    private:
+        EEPROM_Memory _hot = EEPROM_Memory(0);
+        SPIFFS_Memory _cold = SPIFFS_Memory();
+
+        // Read counts of the recently read keys, used for promoting and demoting keys
+        String _trackedKeys[TIER_TRACKED_KEYS];
+        uint32_t _trackedHashes[TIER_TRACKED_KEYS];     // hashes of the tracked keys, 0 for an empty slot
+        uint8_t _hits[TIER_TRACKED_KEYS];
+        uint16_t _reads;
+
+        // Bloom filter of the keys stored in the cold tier, a key whose bits are not all set is not stored there
+        uint8_t _coldFilter[TIER_COLD_FILTER_BYTES];
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will return the read count of the key
+         * @param key key to search for
+         * @return number of reads, 0 if the key is not tracked
+         */
+        uint8_t _hitsOf(const DbKey& key);
+
+        /**
+         * This will count a read of the key, replacing the least read key if the key is not tracked
+         * @param key key which was read
+         * @return number of reads of the key
+         */
+        uint8_t _touch(const DbKey& key);
+
+        /**
+         * This will stop tracking the reads of the key
+         * @param key key to forget
+         */
+        void _forget(const DbKey& key);
+
+        /**
+         * This will note that the key may be stored in the cold tier
+         * @param key key written to the cold tier
+         */
+        void _markCold(const DbKey& key);
+
+        /**
+         * This will tell weather the key may be stored in the cold tier, without reading it
+         * @param key key to search for
+         * @return false if the key is not stored in the cold tier
+         * @return true if it may be
+         */
+        bool _mayBeCold(const DbKey& key);
+
+        /**
+         * This will rebuild the filter of the cold tier from its keys, marking all keys if they can not be read
+         * @param null
+         */
+        void _loadColdFilter();
+
+        /**
+         * This will find the least read key of the hot tier
+         * @param victim String to hold the key
+         * @return number of reads of the key
+         * @return -1 if the hot tier is empty
+         */
+        int _leastRead(String& victim);
+
+        /**
+         * This will insert the key into the hot tier, demoting the least read key to the cold tier
+         * if the hot tier is full and that key is read less than this key
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param expiry time at which the key expires (as returned by dbNow), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if the hot tier has no space for the value
+         */
+        int8_t _insertHot(const DbKey& key, const String& value, uint32_t expiry);
+
+        /**
+         * This will move the key from the cold tier to the hot tier, keeping its expiry
+         * @param key key to move
+         * @param value value associated with the key
+         */
+        void _promote(const DbKey& key, const String& value);
+
+        /**
+         * This will move the key from the hot tier to the cold tier, keeping its expiry
+         * @param key key to move
+         * @return SUCCESS if key moved successfully
+         * @return FAILURE otherwise
+         */
+        bool _demote(const String& key);
+
+        /**
+         * This will remove all the keys of the hot tier and forget the read counts, after the cold tier
+         * was replaced with new data
+         * @param null
+         * @return SUCCESS if cleared
+         * @return FAILURE otherwise
+         */
+        bool _clearHot();
+
+        /**
+         * This will call callback for the keys of both the tiers, merging them in sorted order
+         * @param low the first key to visit, or the prefix of the keys to visit
+         * @param high the keys not less than high are not visited, not used for prefix scan
+         * @param isPrefix set to true to visit only the keys starting with low
+         * @param callback function called for every key value pair
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int _scan(const String& low, const String& high, bool isPrefix, ScanCallback callback, void* context);
+
+    public:
+        /**
+         * Constructor for initializing class object, using the whole EEPROM memory and default file of SPIFFS memory
+         * @param null
+         * @return null
+         */
+        Tiered_Memory();
+
+        /**
+         * Constructor for initializing class object for using EEPROM and SPIFFS memory together
+         * @param EEPROMSize size of EEPROM memory used for the hot tier (in bytes), starting at the first byte
+         * @param name name of the SPIFFS namespace used for the cold tier, data is stored in file /<name>.txt
+         * @return null
+         */
+        Tiered_Memory(int EEPROMSize, const char* name);
+
+        /**
+         * This method will handle the initialization of both the tiers
+         * Note- Must be called within setup only once
+         * @return FAILURE is initialization fails
+         * @return SUCCESS is initialization successful
+         */
+        bool begin();
+
+        /**
+         * This method will format both the tiers
+         * @return FAILURE is format fails
+         * @return SUCCESS is format successful
+         */
+        bool format();
+
+        /**
+         * This method will remove all the data stored in both the tiers
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
+        /**
+         * Call this method to optimize both the tiers forcefully
+         * @param null
+         * @return SUCCESS, if optimization task successful and space is available for new data
+         * @return FAILURE, if optimization failed or space for new data is not available
+         */
+        int8_t optimize();
+
+        /**
+         * This method will enable compression of values for the following inserts in both the tiers
+         * @param minSize values of at least this length (in bytes) are compressed, 0 to disable
+         */
+        void setCompression(uint16_t minSize);
+
+        /**
+         * This method will defer the commits of the hot tier until commit is called
+         * @param defer set to true to defer the commits, false to commit on every operation again
+         */
+        void setDeferredCommit(bool defer);
+
+        /**
+         * This method will commit the writes of the hot tier whose commit was deferred
+         * @param null
+         * @return SUCCESS if committed or nothing to commit
+         * @return FAILURE otherwise
+         */
+        bool commit();
+
+        /**
+         * This method will return the value associated with key, counting the read
+         * Keys of the cold tier read often enough are moved to the hot tier
+         * @param key key for which value is required
+         * @param defaultValue default value to return if key not found
+         * @return value associated with key if found
+         * @return defaultValue otherwise
+         */
+        String get(const DbKey& key, const String& defaultValue);
+
+        /**
+         * This method will copy the value associated with key into buffer, the read is not counted
+         * @param key key for which value is required
+         * @param buffer buffer to hold the value, always null terminated
+         * @param bufferSize size of buffer (in bytes)
+         * @return length of the value copied into buffer
+         * @return -1 if key not found
+         */
+        int get(const DbKey& key, char* buffer, size_t bufferSize);
+
+        /**
+         * This method will return the value associated with key without copying it, for keys of the hot tier
+         * @param key key for which value is required
+         * @param value to hold the pointer to the first byte of the value
+         * @param length to hold the number of bytes of the value
+         * @return SUCCESS if key found in the hot tier
+         * @return FAILURE otherwise
+         */
+        bool getView(const DbKey& key, const char*& value, size_t& length);
+
+        /**
+         * This method will return all the stored key value pairs, of the hot tier followed by the cold tier
+         * @param null
+         * @return String of all key value pairs
+         */
+        String getAll();
+
+        /**
+         * This method will return the values associated with multiple keys using a single scan of every tier
+         * @param keys array of keys for which values are required
+         * @param values array to hold the values, must have space for count values
+         * @param count number of keys
+         * @param defaultValue default value to store for keys not found
+         * @return number of keys found
+         */
+        int getMany(const String keys[], String values[], int count, const String& defaultValue);
+
+        /**
+         * This method will insert the data into the database
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         */
+        int8_t insert(const DbKey& key, const String& value);
+
+        /**
+         * This method will insert the data into the database, which expires after the given time.
+         * Small values are stored in the hot tier while it has space, the rest in the cold tier
+         * @param key unique key for the value
+         * @param value value associated with the key
+         * @param ttlSeconds time after which the key expires (in seconds), 0 for never
+         * @return SUCCESS if value inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t insert(const DbKey& key, const String& value, uint32_t ttlSeconds);
+
+        /**
+         * This method will insert multiple key value pairs using a single write per tier
+         * @param keys array of unique keys, for repeated keys the last value is kept
+         * @param values array of values associated with the keys
+         * @param count number of key value pairs
+         * @return SUCCESS if values inserted successfully
+         * @return FAILURE is value insertion failed
+         * @return MEM_FULL if memory is full and their is no space for new data
+         */
+        int8_t putMany(const String keys[], const String values[], int count);
+
+        /**
+         * This method will insert and remove multiple keys using a single write per tier, as a group of changes
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed, part of the changes may be written then
+         * @return MEM_FULL if space for the values is not available, no change is written then
+         */
+        int8_t putMany(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count);
+
+        /**
+         * This method will insert and remove multiple keys as putMany does, with the times at which the keys expire
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param expiries array of times at which the keys expire (as returned by dbNow, 0 for never), NULL for never
+         * @param removed array telling which keys are removed instead of inserted, NULL if none is removed
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed, part of the changes may be written then
+         * @return MEM_FULL if space for the values is not available, no change is written then
+         */
+        int8_t putManyAt(const String keys[], const String values[], const uint32_t expiries[], const bool removed[], int count);
+
+        /**
+         * This method will remove the key and associated value from db
+         * @param key key to be removed
+         * @return FAILURE if fails or key not found
+         * @return SUCCESS if key removed successfully
+         */
+        bool remove(const DbKey& key);
+
+        /**
+         * This method will tell weather the key exists or not in the database
+         * @param key key to search for
+         * @return SUCCESS if key found
+         * @return FAILURE is key not found
+         */
+        bool exists(const DbKey& key);
+
+        /**
+         * This method will remove the expired records of both the tiers, checking at most maxRecords records of every tier
+         * @param maxRecords maximum number of records to check
+         * @return number of expired records removed
+         */
+        int sweep(int maxRecords);
+
+        /**
+         * This method will count the bytes used by live records and by removed or expired records of both the tiers
+         * @param null
+         * @return usage of both the tiers added together
+         */
+        DbUsage getUsage();
+
+        /**
+         * This method will return the bytes usable for records by both the tiers
+         * @param null
+         * @return capacity of both the tiers added together (in bytes)
+         */
+        uint32_t capacity();
+
+        /**
+         * This method will return the bytes that can still be appended to both the tiers before they have to be compacted
+         * @param null
+         * @return free space of both the tiers added together (in bytes)
+         */
+        uint32_t freeSpace();
+
+        /**
+         * This method will build the sorted directory of the active keys of both the tiers, if not already built
+         * Note- Scans build it on first use, building it beforehand lets scans run without modifying the object
+         * @param null
+         * @return true if the directory is built
+         * @return false if memory for the directory is not available
+         */
+        bool buildDirectory();
+
+        /**
+         * This method will call callback for every key starting with prefix, in sorted order of keys across both the tiers
+         * Note- The callback must not modify the database
+         * @param prefix prefix of the keys to visit
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanPrefix(const String& prefix, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will call callback for every key from low (inclusive) to high (exclusive), in sorted order of keys across both the tiers
+         * Note- The callback must not modify the database
+         * @param low the first key of the range
+         * @param high the end of the range, this key is not visited
+         * @param callback function called for every key value pair, return false from it to stop the scan
+         * @param context pointer passed to every call of callback
+         * @return number of key value pairs visited
+         */
+        int scanRange(const String& low, const String& high, ScanCallback callback, void* context = NULL);
+
+        /**
+         * This method will add the live records of both the tiers to a backup (see Backup.h)
+         * @param writer backup to add the records to, finish it after all the records are added
+         * @return number of key value pairs added
+         */
+        int exportTo(BackupWriter& writer);
+
+        /**
+         * This method will replace all the data with the records of a backup written by exportTo. The records
+         * are loaded into the cold tier, and moved to the hot tier once read often as for any other key.
+         * The data is not touched if the backup is corrupted or does not fit
+         * @param in where the backup is read from
+         * @return SUCCESS if the backup was loaded
+         * @return FAILURE if the backup is incomplete or corrupted
+         * @return MEM_FULL if the records do not fit in the cold tier
+         */
+        int8_t importFrom(Stream& in);
+
+        /**
+         * This method will replace all the data with the pairs of a bulk loader. The pairs are loaded into the
+         * cold tier, and moved to the hot tier once read often as for any other key
+         * @param loader loader holding the pairs
+         * @return SUCCESS if the pairs were loaded
+         * @return FAILURE if the pairs of the loader could not be read
+         * @return MEM_FULL if the pairs do not fit in the cold tier
+         */
+        int8_t load(BulkLoader& loader);
+
+        /**
+         * This method will take the data of both the tiers for a snapshot, the hot tier is copied
+         * and the current version of the cold tier is kept until unpinSnapshot (see SPIFFS_Memory)
+         * @param hotData to hold the records of the hot tier
+         * @param size to hold the number of bytes of the version of the cold tier
+         * @return slot of the version of the cold tier
+         * @return -1 if SNAPSHOT_MAX_VERSIONS versions are already kept
+         */
+        int8_t pinSnapshot(String& hotData, uint32_t& size);
+
+        /**
+         * This method will open the file of a version of the cold tier kept by pinSnapshot for reading
+         * @param slot slot of the version
+         * @return handle of the file, false if the version was lost
+         */
+        File openSnapshot(int8_t slot);
+
+        /**
+         * This method will release a version of the cold tier kept by pinSnapshot
+         * @param slot slot of the version
+         */
+        void unpinSnapshot(int8_t slot);
+
+        /**
+         * This method will write a group of changes so that either all or none of them are kept after a reset,
+         * using the redo journal of the cold tier (see SPIFFS_Memory::commitTransaction)
+         * @param keys array of keys, for repeated keys the last change is kept
+         * @param values array of values associated with the keys, not used for removed keys
+         * @param ttlSeconds array of times after which the keys expire (in seconds, 0 for never)
+         * @param removed array telling which keys are removed instead of inserted
+         * @param count number of keys
+         * @return SUCCESS if the changes were written
+         * @return FAILURE if writing failed even when retried, the journal is set aside then and not replayed
+         * @return MEM_FULL if space for the values is not available, no change is written then
+         */
+        int8_t commitTransaction(const String keys[], const String values[], const uint32_t ttlSeconds[], const bool removed[], int count);
+
+        /**
+         * This method will write the changes of a transaction interrupted by a reset again, if its journal is complete.
+         * Call it after begin, before the data is used
+         * @param null
+         * @return SUCCESS if there was nothing to replay or the changes were written
+         * @return FAILURE if the changes could not be written, the journal is set aside then (see SPIFFS_Memory::setAsideJournal)
+         */
+        int8_t replayJournal();
+};
+
+#endif
@@ -0,0 +1,472 @@
+/*
+    TimeSeries_Memory.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers using SPIFFS memory as a ring buffer of readings
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "TimeSeries_Memory.h"
+
+#define SERIES_MAGIC 0x31535444     // "DTS1"
+#define SERIES_MAX_PREFIX 6         // varint of 32 bits and the length byte
+
+/**
+ * This will write the number as a varint, 7 bits per byte with the high bit set on all but the last byte
+ */
+static uint8_t _putVarint(uint8_t* buffer, uint32_t value)
+{
+	uint8_t length = 0;
+
+	while (value >= 0x80)
+	{
+		buffer[length++] = (uint8_t)(value | 0x80);
+		value = value >> 7;
+	}
+
+	buffer[length++] = (uint8_t)value;
+
+	return length;
+}
+
+
+
+
+/**
+ * This will read a varint, returning the number of bytes used
+ */
+static uint8_t _getVarint(const uint8_t* buffer, uint32_t& value)
+{
+	uint8_t length = 0;
+	value = 0;
+
+	while ((length < 5) && (buffer[length] & 0x80))
+	{
+		value = value | ((uint32_t)(buffer[length] & 0x7F) << (7 * length));
+		length++;
+	}
+
+	value = value | ((uint32_t)buffer[length] << (7 * length));
+
+	return length + 1;
+}
+
+
+
+
+// Constructors
+
+TimeSeries_Memory::TimeSeries_Memory(const char* name, uint32_t capacity)
+{
+	_FILE_NAME = String("/") + name + ".ts";
+	_isInitiated = false;
+
+	memset(&_header, 0, sizeof(_header));
+	_header.magic = SERIES_MAGIC;
+	_header.capacity = capacity;
+}
+
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+void TimeSeries_Memory::_print(const String& msg)
+{
+#ifdef DEBUG
+	Serial.print("*ArduinoDb[TimeSeries]* ");
+	Serial.println(msg);
+#endif
+}
+
+
+
+
+void TimeSeries_Memory::_readAt(uint32_t offset, uint8_t* buffer, uint32_t length)
+{
+	offset = offset % _header.capacity;
+	uint32_t first = _header.capacity - offset;
+
+	if (first > length)
+	{
+		first = length;
+	}
+
+	_file.seek(sizeof(SeriesHeader) + offset, SeekSet);
+	_file.read(buffer, first);
+
+	if (first < length)
+	{
+		_file.seek(sizeof(SeriesHeader), SeekSet);
+		_file.read(buffer + first, length - first);
+	}
+}
+
+
+
+
+void TimeSeries_Memory::_writeAt(uint32_t offset, const uint8_t* buffer, uint32_t length)
+{
+	offset = offset % _header.capacity;
+	uint32_t first = _header.capacity - offset;
+
+	if (first > length)
+	{
+		first = length;
+	}
+
+	_file.seek(sizeof(SeriesHeader) + offset, SeekSet);
+	_file.write(buffer, first);
+
+	if (first < length)
+	{
+		_file.seek(sizeof(SeriesHeader), SeekSet);
+		_file.write(buffer + first, length - first);
+	}
+}
+
+
+
+
+bool TimeSeries_Memory::_writeHeader()
+{
+	_file.seek(0, SeekSet);
+
+	return _file.write((const uint8_t*)&_header, sizeof(SeriesHeader)) == sizeof(SeriesHeader);
+}
+
+
+
+
+uint8_t TimeSeries_Memory::_readPrefix(uint32_t offset, uint32_t& delta, uint8_t& length)
+{
+	uint8_t prefix[SERIES_MAX_PREFIX];
+
+	_readAt(offset, prefix, SERIES_MAX_PREFIX);
+
+	uint8_t used = _getVarint(prefix, delta);
+	length = prefix[used];
+
+	return used + 1;
+}
+
+
+
+
+void TimeSeries_Memory::_seekBack(uint32_t count, uint32_t& offset, uint32_t& timestamp)
+{
+	uint32_t capacity = _header.capacity;
+	uint32_t delta;
+	uint8_t length;
+	uint8_t size;
+
+	// The last byte of every reading is its total size
+	_readAt(_header.head + capacity - 1, &size, 1);
+	offset = (_header.head + capacity - size) % capacity;
+	timestamp = _header.lastTime;
+
+	for (uint32_t i = 0 ; i < count ; i++)
+	{
+		// Time of the previous reading is the time of this reading less its delta
+		_readPrefix(offset, delta, length);
+		timestamp = timestamp - delta;
+
+		_readAt(offset + capacity - 1, &size, 1);
+		offset = (offset + capacity - size) % capacity;
+	}
+}
+
+
+
+
+int TimeSeries_Memory::_visit(uint32_t offset, uint32_t timestamp, uint32_t count, SeriesCallback callback)
+{
+	char value[TS_MAX_VALUE];
+	uint32_t delta;
+	uint8_t length;
+
+	for (uint32_t i = 0 ; i < count ; i++)
+	{
+		uint8_t prefix = _readPrefix(offset, delta, length);
+
+		if (i > 0)
+		{
+			timestamp = timestamp + delta;
+		}
+
+		_readAt(offset + prefix, (uint8_t*)value, length);
+
+		if (!callback(timestamp, value, length))
+		{
+			return i + 1;
+		}
+
+		offset = (offset + prefix + length + 1) % _header.capacity;
+	}
+
+	return count;
+}
+
+
+
+
+// ****************** PUBLIC METHODS **************************
+
+bool TimeSeries_Memory::begin()
+{
+	_print("Initializing the series");
+
+	if (!SPIFFS.begin())
+	{
+		_isInitiated = false;
+		return FAILURE;
+	}
+
+	_isInitiated = true;
+
+	if (SPIFFS.exists(_FILE_NAME))
+	{
+		_file = SPIFFS.open(_FILE_NAME, "r+");
+
+		SeriesHeader stored;
+
+		if (_file && (_file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored)) &&
+			(stored.magic == SERIES_MAGIC) && (stored.capacity == _header.capacity) &&
+			(_file.size() == sizeof(SeriesHeader) + _header.capacity))
+		{
+			_header = stored;
+			return SUCCESS;
+		}
+
+		_print("Series stored with a different capacity, clearing it");
+		_file.close();
+	}
+
+	return clear();
+}
+
+
+
+
+bool TimeSeries_Memory::clear()
+{
+	_print("Clearing " + _FILE_NAME);
+
+	if (!_isInitiated)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	_file.close();
+	_file = SPIFFS.open(_FILE_NAME, "w+");
+
+	if (!_file)
+	{
+		return FAILURE;
+	}
+
+	uint32_t capacity = _header.capacity;
+	memset(&_header, 0, sizeof(_header));
+	_header.magic = SERIES_MAGIC;
+	_header.capacity = capacity;
+
+	if (!_writeHeader())
+	{
+		return FAILURE;
+	}
+
+	// Writing the whole ring once, so that readings can later be written in place
+	uint8_t zeros[32];
+	memset(zeros, 0, sizeof(zeros));
+
+	for (uint32_t i = 0 ; i < capacity ; i += sizeof(zeros))
+	{
+		uint32_t chunk = capacity - i;
+		_file.write(zeros, (chunk < sizeof(zeros)) ? chunk : sizeof(zeros));
+	}
+
+	_file.flush();
+
+	return _file.size() == (sizeof(SeriesHeader) + capacity);
+}
+
+
+
+
+bool TimeSeries_Memory::append(const String& value)
+{
+	return append(value.c_str(), value.length(), dbNow());
+}
+
+
+
+
+bool TimeSeries_Memory::append(const char* value, size_t length, uint32_t timestamp)
+{
+	if (!_isInitiated || !_file)
+	{
+		_print("System not initiated");
+		return FAILURE;
+	}
+
+	uint8_t prefix[SERIES_MAX_PREFIX];
+	uint32_t delta = 0;
+
+	if (_header.count > 0)
+	{
+		// Deltas are unsigned, readSince relies on the times never going back
+		if (timestamp < _header.lastTime)
+		{
+			_print("Reading older than the newest reading");
+			return FAILURE;
+		}
+
+		delta = timestamp - _header.lastTime;
+	}
+
+	uint8_t prefixLength = _putVarint(prefix, delta);
+	prefix[prefixLength++] = (uint8_t)length;
+	uint32_t size = prefixLength + length + 1;
+
+	if ((length > TS_MAX_VALUE) || (size > _header.capacity))
+	{
+		_print("Reading too long");
+		return FAILURE;
+	}
+
+	// Dropping the oldest readings until the new reading fits
+	bool evicted = false;
+
+	while ((_header.used + size) > _header.capacity)
+	{
+		uint32_t oldDelta;
+		uint8_t oldLength;
+		uint8_t oldPrefix = _readPrefix(_header.tail, oldDelta, oldLength);
+		uint32_t oldSize = oldPrefix + oldLength + 1;
+
+		_header.tail = (_header.tail + oldSize) % _header.capacity;
+		_header.used = _header.used - oldSize;
+		_header.count--;
+		evicted = true;
+
+		if (_header.count > 0)
+		{
+			// The next reading is the oldest now, its time is kept as an absolute time
+			_readPrefix(_header.tail, oldDelta, oldLength);
+			_header.baseTime = _header.baseTime + oldDelta;
+		}
+	}
+
+	// The header is updated before the oldest readings are overwritten, so it never points into a partial reading
+	if (evicted && !_writeHeader())
+	{
+		return FAILURE;
+	}
+
+	uint8_t trailer = (uint8_t)size;
+
+	_writeAt(_header.head, prefix, prefixLength);
+	_writeAt(_header.head + prefixLength, (const uint8_t*)value, length);
+	_writeAt(_header.head + prefixLength + length, &trailer, 1);
+
+	if (_header.count == 0)
+	{
+		_header.baseTime = timestamp;
+		_header.lastTime = timestamp;
+		_header.tail = _header.head;
+	}
+	else
+	{
+		_header.lastTime = _header.lastTime + delta;
+	}
+
+	_header.head = (_header.head + size) % _header.capacity;
+	_header.used = _header.used + size;
+	_header.count++;
+
+	bool written = _writeHeader();
+	_file.flush();
+
+	return written;
+}
+
+
+
+
+int TimeSeries_Memory::readLast(int count, SeriesCallback callback)
+{
+	if (!_isInitiated || (count <= 0) || (_header.count == 0))
+	{
+		return 0;
+	}
+
+	uint32_t visits = ((uint32_t)count < _header.count) ? count : _header.count;
+	uint32_t offset;
+	uint32_t timestamp;
+
+	_seekBack(visits - 1, offset, timestamp);
+
+	return _visit(offset, timestamp, visits, callback);
+}
+
+
+
+
+int TimeSeries_Memory::readSince(uint32_t since, SeriesCallback callback)
+{
+	if (!_isInitiated || (_header.count == 0) || (_header.lastTime < since))
+	{
+		return 0;
+	}
+
+	if (_header.baseTime >= since)
+	{
+		return _visit(_header.tail, _header.baseTime, _header.count, callback);
+	}
+
+	// Walking back from the newest reading while the readings are not older than since
+	uint32_t capacity = _header.capacity;
+	uint32_t offset;
+	uint32_t timestamp = _header.lastTime;
+	uint32_t visits = 1;
+	uint32_t delta;
+	uint8_t length;
+	uint8_t size;
+
+	_readAt(_header.head + capacity - 1, &size, 1);
+	offset = (_header.head + capacity - size) % capacity;
+
+	while (true)
+	{
+		_readPrefix(offset, delta, length);
+
+		if ((timestamp - delta) < since)
+		{
+			break;
+		}
+
+		timestamp = timestamp - delta;
+		_readAt(offset + capacity - 1, &size, 1);
+		offset = (offset + capacity - size) % capacity;
+		visits++;
+	}
+
+	return _visit(offset, timestamp, visits, callback);
+}
+
+
+
+
+int TimeSeries_Memory::count()
+{
+	return _header.count;
+}
+
+
+
+
+uint32_t TimeSeries_Memory::lastTimestamp()
+{
+	return (_header.count > 0) ? _header.lastTime : 0;
+}
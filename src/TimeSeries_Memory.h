@@ -0,0 +1,189 @@
+/*
+    TimeSeries_Memory.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers using SPIFFS memory as a ring buffer of readings
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef TimeSeries_Memory_h
+#define TimeSeries_Memory_h
+
+#include "Arduino.h"
+#include <FS.h>
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+#include "Config.h"
+#include "DbUtils.h"
+
+/**
+ * Function called for every reading visited by the time series reads, in the order of the readings
+ * @param timestamp time of the reading (in seconds)
+ * @param value bytes of the reading, not null terminated
+ * @param length number of bytes of the reading
+ * @return true to continue, false to stop the read
+ */
+typedef bool (*SeriesCallback)(uint32_t timestamp, const char* value, size_t length);
+
+/**
+ * Header stored at the start of the file, offsets are relative to the start of the ring
+ */
+struct SeriesHeader
+{
+    uint32_t magic;
+    uint32_t capacity;      // size of the ring (in bytes)
+    uint32_t head;          // offset where the next reading is written
+    uint32_t tail;          // offset of the oldest reading
+    uint32_t used;          // bytes used by the readings
+    uint32_t count;         // number of readings
+    uint32_t baseTime;      // time of the oldest reading
+    uint32_t lastTime;      // time of the newest reading
+};
+
+/**
+ * Append only collection of readings kept in a file of fixed size, used as a ring buffer. Appending
+ * a reading overwrites the oldest readings when the ring is full, without any scan or optimization.
+ * Every reading is stored as the time since the previous reading (varint), its length, its bytes
+ * and the total size of the reading, so the ring can be read in both directions
+ */
+class TimeSeries_Memory
+{
+    private:
+        String _FILE_NAME;
+        bool _isInitiated;
+
+        SeriesHeader _header;
+        File _file;         // kept open, readings are written in place
+
+        /**
+         * This function will just print the message to the Serial if DEBUG is 1
+         * @param msg The message to print in Serial
+         */
+        void _print(const String& msg);
+
+        /**
+         * This will read bytes of the ring, continuing from its start if the end is reached
+         * @param offset offset of the first byte within the ring
+         * @param buffer buffer to hold the bytes
+         * @param length number of bytes to read
+         */
+        void _readAt(uint32_t offset, uint8_t* buffer, uint32_t length);
+
+        /**
+         * This will write bytes to the ring, continuing from its start if the end is reached
+         * @param offset offset of the first byte within the ring
+         * @param buffer bytes to write
+         * @param length number of bytes to write
+         */
+        void _writeAt(uint32_t offset, const uint8_t* buffer, uint32_t length);
+
+        /**
+         * This will write the header to the file
+         * @param null
+         * @return SUCCESS if written
+         * @return FAILURE otherwise
+         */
+        bool _writeHeader();
+
+        /**
+         * This will read the time since the previous reading and the length of the reading at the offset
+         * @param offset offset of the reading within the ring
+         * @param delta to hold the time since the previous reading (in seconds)
+         * @param length to hold the number of bytes of the reading
+         * @return number of bytes before the bytes of the reading
+         */
+        uint8_t _readPrefix(uint32_t offset, uint32_t& delta, uint8_t& length);
+
+        /**
+         * This will find the reading count readings before the newest one
+         * @param count number of readings to move back, less than the number of readings
+         * @param offset to hold the offset of the reading found
+         * @param timestamp to hold the time of the reading found
+         */
+        void _seekBack(uint32_t count, uint32_t& offset, uint32_t& timestamp);
+
+        /**
+         * This will call callback for count readings starting from the offset, oldest first
+         * @param offset offset of the first reading to visit
+         * @param timestamp time of the first reading to visit
+         * @param count number of readings to visit
+         * @param callback function called for every reading
+         * @return number of readings visited
+         */
+        int _visit(uint32_t offset, uint32_t timestamp, uint32_t count, SeriesCallback callback);
+
+    public:
+        /**
+         * Constructor for initializing class object
+         * @param name name of the series, readings are stored in file /<name>.ts
+         * @param capacity size of the ring (in bytes), the file takes 32 bytes more
+         * @return null
+         */
+        TimeSeries_Memory(const char* name, uint32_t capacity);
+
+        /**
+         * This method will initialize SPIFFS memory and open the series, creating its file if required.
+         * A file created with a different capacity is cleared
+         * Note- Must be called within setup only once
+         * @return FAILURE is initialization fails
+         * @return SUCCESS is initialization successful
+         */
+        bool begin();
+
+        /**
+         * This method will remove all the readings
+         * @return FAILURE is clear fails
+         * @return SUCCESS is clear successful
+         */
+        bool clear();
+
+        /**
+         * This method will append a reading with the current time of the database clock
+         * @param value the reading, at most TS_MAX_VALUE bytes
+         * @return SUCCESS if appended
+         * @return FAILURE if the clock is behind the time of the newest reading, or writing failed
+         */
+        bool append(const String& value);
+
+        /**
+         * This method will append a reading, overwriting the oldest readings if the ring is full
+         * @param value bytes of the reading
+         * @param length number of bytes of the reading, at most TS_MAX_VALUE
+         * @param timestamp time of the reading (in seconds), not older than the newest reading
+         * @return SUCCESS if appended
+         * @return FAILURE if timestamp is older than the newest reading, or writing failed
+         */
+        bool append(const char* value, size_t length, uint32_t timestamp);
+
+        /**
+         * This method will call callback for the last count readings, oldest first
+         * @param count number of readings to read
+         * @param callback function called for every reading, return false from it to stop
+         * @return number of readings visited
+         */
+        int readLast(int count, SeriesCallback callback);
+
+        /**
+         * This method will call callback for the readings not older than the given time, oldest first
+         * @param since time of the oldest reading to read (in seconds)
+         * @param callback function called for every reading, return false from it to stop
+         * @return number of readings visited
+         */
+        int readSince(uint32_t since, SeriesCallback callback);
+
+        /**
+         * This method will return the number of readings stored
+         * @param null
+         * @return number of readings
+         */
+        int count();
+
+        /**
+         * This method will return the time of the newest reading
+         * @param null
+         * @return time of the newest reading, 0 if there are no readings
+         */
+        uint32_t lastTimestamp();
+};
+
+#endif
@@ -0,0 +1,361 @@
+/*
+    ValueIndex.cpp - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#include "Arduino.h"
+#include "ValueIndex.h"
+#include "DbUtils.h"
+
+/**
+ * Constructor of the index
+ */
+ValueIndex::ValueIndex()
+{
+	_prefixCount = 0;
+	_hashes = NULL;
+	_keys = NULL;
+	_byKey = NULL;
+	_size = 0;
+	_capacity = 0;
+}
+
+
+
+
+ValueIndex::ValueIndex(const ValueIndex& other)
+{
+	_prefixCount = 0;
+	_hashes = NULL;
+	_keys = NULL;
+	_byKey = NULL;
+	_size = 0;
+	_capacity = 0;
+
+	*this = other;
+}
+
+
+
+
+ValueIndex& ValueIndex::operator=(const ValueIndex& other)
+{
+	if (this != &other)
+	{
+		clear();
+
+		_prefixCount = other._prefixCount;
+
+		for (int i = 0 ; i < _prefixCount ; i++)
+		{
+			_prefixes[i] = other._prefixes[i];
+		}
+
+		for (int i = 0 ; i < other._size ; i++)
+		{
+			if ((_size == _capacity) && !_grow())
+			{
+				break;
+			}
+
+			_hashes[_size] = other._hashes[i];
+			_keys[_size] = other._keys[i];
+			_byKey[_size] = other._byKey[i];
+			_size++;
+		}
+	}
+
+	return *this;
+}
+
+
+
+
+ValueIndex::~ValueIndex()
+{
+	clear();
+}
+
+
+
+// ****************** PRIVATE METHODS *************************
+
+bool ValueIndex::_grow()
+{
+	int capacity = (_capacity == 0) ? 16 : (_capacity * 2);
+	uint32_t* hashes = new uint32_t[capacity];
+	String* keys = new String[capacity];
+	int* byKey = new int[capacity];
+
+	if ((hashes == NULL) || (keys == NULL) || (byKey == NULL))
+	{
+		delete[] hashes;
+		delete[] keys;
+		delete[] byKey;
+		return false;
+	}
+
+	for (int i = 0 ; i < _size ; i++)
+	{
+		hashes[i] = _hashes[i];
+		keys[i] = _keys[i];
+		byKey[i] = _byKey[i];
+	}
+
+	delete[] _hashes;
+	delete[] _keys;
+	delete[] _byKey;
+
+	_hashes = hashes;
+	_keys = keys;
+	_byKey = byKey;
+	_capacity = capacity;
+
+	return true;
+}
+
+
+
+
+int ValueIndex::_lowerBoundKey(const DbKey& key)
+{
+	int low = 0;
+	int high = _size;
+
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+
+		if (strcmp(_keys[_byKey[mid]].c_str(), key.c_str()) < 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+// ************************************************************
+
+
+
+// ****************** PUBLIC METHODS **************************
+bool ValueIndex::addPrefix(const String& prefix)
+{
+	for (int i = 0 ; i < _prefixCount ; i++)
+	{
+		if (_prefixes[i].equals(prefix))
+		{
+			return true;
+		}
+	}
+
+	if (_prefixCount == VALUE_INDEX_MAX_PREFIXES)
+	{
+		return false;
+	}
+
+	_prefixes[_prefixCount] = prefix;
+	_prefixCount++;
+
+	return true;
+}
+
+
+
+
+int ValueIndex::prefixCount()
+{
+	return _prefixCount;
+}
+
+
+
+
+const String& ValueIndex::prefixAt(int pos)
+{
+	return _prefixes[pos];
+}
+
+
+
+
+bool ValueIndex::covers(const DbKey& key)
+{
+	for (int i = 0 ; i < _prefixCount ; i++)
+	{
+		int length = _prefixes[i].length();
+
+		if ((key.length() >= length) && (memcmp(key.c_str(), _prefixes[i].c_str(), length) == 0))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+void ValueIndex::clear()
+{
+	delete[] _hashes;
+	delete[] _keys;
+	delete[] _byKey;
+
+	_hashes = NULL;
+	_keys = NULL;
+	_byKey = NULL;
+	_size = 0;
+	_capacity = 0;
+}
+
+
+
+
+int ValueIndex::size()
+{
+	return _size;
+}
+
+
+
+
+bool ValueIndex::put(const DbKey& key, const String& value)
+{
+	erase(key);
+
+	if ((_size == _capacity) && !_grow())
+	{
+		return false;
+	}
+
+	String stored = key.c_str();
+	uint32_t hash = dbHash(value.c_str(), value.length());
+	int pos = lowerBound(hash);
+
+	// Keys with the same hash are kept sorted, so the smallest matching key is found first
+	while ((pos < _size) && (_hashes[pos] == hash) && (_keys[pos].compareTo(stored) < 0))
+	{
+		pos++;
+	}
+
+	for (int i = _size ; i > pos ; i--)
+	{
+		_hashes[i] = _hashes[i - 1];
+		_keys[i] = _keys[i - 1];
+	}
+
+	_hashes[pos] = hash;
+	_keys[pos] = stored;
+
+	// Entries from pos moved forward by one, then adding pos among the positions sorted by key
+	for (int i = 0 ; i < _size ; i++)
+	{
+		if (_byKey[i] >= pos)
+		{
+			_byKey[i]++;
+		}
+	}
+
+	int place = _lowerBoundKey(key);
+
+	for (int i = _size ; i > place ; i--)
+	{
+		_byKey[i] = _byKey[i - 1];
+	}
+
+	_byKey[place] = pos;
+	_size++;
+
+	return true;
+}
+
+
+
+
+void ValueIndex::erase(const DbKey& key)
+{
+	// Entries are sorted by value, the key is searched for in the positions sorted by key
+	int place = _lowerBoundKey(key);
+
+	if ((place == _size) || !key.equals(_keys[_byKey[place]]))
+	{
+		return;
+	}
+
+	int pos = _byKey[place];
+
+	for (int i = place ; i < (_size - 1) ; i++)
+	{
+		_byKey[i] = _byKey[i + 1];
+	}
+
+	for (int i = pos ; i < (_size - 1) ; i++)
+	{
+		_hashes[i] = _hashes[i + 1];
+		_keys[i] = _keys[i + 1];
+	}
+
+	_size--;
+	_keys[_size] = "";
+
+	// Entries after pos moved back by one
+	for (int i = 0 ; i < _size ; i++)
+	{
+		if (_byKey[i] > pos)
+		{
+			_byKey[i]--;
+		}
+	}
+}
+
+
+
+
+int ValueIndex::lowerBound(uint32_t hash)
+{
+	int low = 0;
+	int high = _size;
+
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+
+		if (_hashes[mid] < hash)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+
+
+uint32_t ValueIndex::hashAt(int pos)
+{
+	return _hashes[pos];
+}
+
+
+
+
+const String& ValueIndex::keyAt(int pos)
+{
+	return _keys[pos];
+}
+
+// ************************************************************
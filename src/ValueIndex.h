@@ -0,0 +1,140 @@
+/*
+    ValueIndex.h - A simple key-value based database implementation
+                    for Arduino based microcontrollers
+    Created by Aman Khatri, Aug 7, 2020
+    Released into the public domain
+*/
+
+#ifndef ValueIndex_h
+#define ValueIndex_h
+
+#include "Arduino.h"
+#include "Config.h"
+#include "DbKey.h"
+
+/**
+ * In-RAM secondary index of the keys starting with the indexed prefixes, sorted by the hash of their value
+ * (and by key for equal hashes). Only the hash of the value is kept, so a match has to be checked against
+ * the stored value, which also skips entries of keys expired or removed without the index knowing
+ */
+class ValueIndex
+{
+    private:
+        String _prefixes[VALUE_INDEX_MAX_PREFIXES];
+        int _prefixCount;
+
+        uint32_t* _hashes;
+        String* _keys;
+        int* _byKey;        // positions of the entries sorted by key, for finding the entry of a key
+        int _size;
+        int _capacity;
+
+        /**
+         * This will increase the capacity of the index
+         * @param null
+         * @return true if capacity increased
+         * @return false if memory is not available
+         */
+        bool _grow();
+
+        /**
+         * This will return the first place in the positions sorted by key whose key is not less than key (binary search)
+         * @param key the key to search for
+         * @return place in the positions sorted by key, size() if all keys are less than key
+         */
+        int _lowerBoundKey(const DbKey& key);
+
+    public:
+        /**
+         * Constructor for initializing an index without prefixes
+         * @param null
+         * @return null
+         */
+        ValueIndex();
+
+        ValueIndex(const ValueIndex& other);
+
+        ValueIndex& operator=(const ValueIndex& other);
+
+        ~ValueIndex();
+
+        /**
+         * This will add a prefix whose keys are indexed, the entries of its keys have to be added by the caller
+         * @param prefix prefix of the keys, "" for all the keys
+         * @return true if added or already indexed
+         * @return false if VALUE_INDEX_MAX_PREFIXES prefixes are already indexed
+         */
+        bool addPrefix(const String& prefix);
+
+        /**
+         * This will return the number of indexed prefixes
+         * @param null
+         * @return number of prefixes
+         */
+        int prefixCount();
+
+        /**
+         * This will return the indexed prefix at the given position
+         * @param pos position of the prefix, must be less than prefixCount()
+         * @return the prefix
+         */
+        const String& prefixAt(int pos);
+
+        /**
+         * This will tell weather the key starts with one of the indexed prefixes
+         * @param key the key to check
+         * @return true if the key is indexed
+         */
+        bool covers(const DbKey& key);
+
+        /**
+         * This will remove all the entries and release their memory, the prefixes are kept
+         * @param null
+         */
+        void clear();
+
+        /**
+         * This will return the number of entries
+         * @param null
+         * @return number of entries
+         */
+        int size();
+
+        /**
+         * This will add the key with its value, replacing the entry of its previous value
+         * @param key the key to add
+         * @param value value associated with the key
+         * @return true if added successfully
+         * @return false if memory is not available
+         */
+        bool put(const DbKey& key, const String& value);
+
+        /**
+         * This will remove the entry of the key, found with binary search over the keys
+         * @param key the key to remove
+         */
+        void erase(const DbKey& key);
+
+        /**
+         * This will return the position of the first entry whose value has the given hash (binary search)
+         * @param hash hash of the value as returned by dbHash
+         * @return position of the entry, size() if all entries have a smaller hash
+         */
+        int lowerBound(uint32_t hash);
+
+        /**
+         * This will return the hash of the value of the entry at the given position
+         * @param pos position of the entry, must be less than size()
+         * @return hash of the value
+         */
+        uint32_t hashAt(int pos);
+
+        /**
+         * This will return the key of the entry at the given position
+         * @param pos position of the entry, must be less than size()
+         * @return key of the entry
+         */
+        const String& keyAt(int pos);
+};
+
+#endif